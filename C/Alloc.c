@@ -8,6 +8,13 @@
 #endif
 #include <stdlib.h>
 
+#if !defined(_WIN32) && defined(__linux__)
+#define _7ZIP_LARGE_PAGES_LINUX
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#endif
+
 #include "Alloc.h"
 
 /* #define _SZ_ALLOC_DEBUG */
@@ -133,6 +140,139 @@ void BigFree(void *address)
   VirtualFree(address, 0, MEM_RELEASE);
 }
 
+#elif defined(_7ZIP_LARGE_PAGES_LINUX)
+
+/*
+  Linux version of BigAlloc():
+  if SetLargePageSize() was called, big blocks are allocated with
+  mmap(MAP_HUGETLB) from the pool of explicit huge pages (vm.nr_hugepages).
+  If that pool is empty, we use normal mmap() aligned for huge page size
+  and we ask for transparent huge pages with madvise(MADV_HUGEPAGE).
+  Each block starts with (BIG_ALLOC_HEADER_SIZE) bytes header that stores
+  the size of mapping, or 0 for blocks allocated with malloc().
+*/
+
+#define BIG_ALLOC_HEADER_SIZE 64
+
+size_t g_LargePageSize = 0;
+
+void SetLargePageSize()
+{
+  size_t size = (size_t)1 << 21;
+  FILE *f = fopen("/proc/meminfo", "r");
+  if (f)
+  {
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+      unsigned long v;
+      if (sscanf(line, "Hugepagesize: %lu kB", &v) == 1)
+      {
+        size = (size_t)v << 10;
+        break;
+      }
+    }
+    fclose(f);
+  }
+  if (size == 0 || (size & (size - 1)) != 0)
+    return;
+  g_LargePageSize = size;
+}
+
+static void *BigAlloc_Map(size_t size)
+{
+  size_t ps = g_LargePageSize;
+  size_t size2;
+  Byte *p;
+  
+  ps--;
+  size2 = (size + BIG_ALLOC_HEADER_SIZE + ps) & ~ps;
+  if (size2 < size)
+    return NULL;
+  
+  #ifdef MAP_HUGETLB
+  p = (Byte *)mmap(NULL, size2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != (Byte *)MAP_FAILED)
+  {
+    *(size_t *)(void *)p = size2;
+    return p + BIG_ALLOC_HEADER_SIZE;
+  }
+  #endif
+
+  #ifdef MADV_HUGEPAGE
+  {
+    /* we reserve additional (ps) bytes to align the start of block for huge page */
+    size_t size3 = size2 + ps + 1;
+    size_t pre, post;
+    Byte *base;
+    if (size3 < size2)
+      return NULL;
+    base = (Byte *)mmap(NULL, size3, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == (Byte *)MAP_FAILED)
+      return NULL;
+    p = (Byte *)(((size_t)base + ps) & ~ps);
+    pre = (size_t)(p - base);
+    post = size3 - pre - size2;
+    if (pre != 0)
+      munmap(base, pre);
+    if (post != 0)
+      munmap(p + size2, post);
+    madvise(p, size2, MADV_HUGEPAGE);
+    *(size_t *)(void *)p = size2;
+    return p + BIG_ALLOC_HEADER_SIZE;
+  }
+  #else
+  return NULL;
+  #endif
+}
+
+void *BigAlloc(size_t size)
+{
+  Byte *p;
+  if (size == 0)
+    return NULL;
+  #ifdef _SZ_ALLOC_DEBUG
+  fprintf(stderr, "\nAlloc_Big %10u bytes;  count = %10d", size, g_allocCountBig++);
+  #endif
+
+  {
+    size_t ps = g_LargePageSize;
+    if (ps != 0 && ps <= ((size_t)1 << 30) && size > (ps / 2))
+    {
+      void *res = BigAlloc_Map(size);
+      if (res)
+        return res;
+    }
+  }
+
+  if (size + BIG_ALLOC_HEADER_SIZE < size)
+    return NULL;
+  p = (Byte *)malloc(size + BIG_ALLOC_HEADER_SIZE);
+  if (!p)
+    return NULL;
+  *(size_t *)(void *)p = 0;
+  return p + BIG_ALLOC_HEADER_SIZE;
+}
+
+void BigFree(void *address)
+{
+  Byte *p;
+  size_t size;
+  #ifdef _SZ_ALLOC_DEBUG
+  if (address)
+    fprintf(stderr, "\nFree_Big; count = %10d", --g_allocCountBig);
+  #endif
+  
+  if (!address)
+    return;
+  p = (Byte *)address - BIG_ALLOC_HEADER_SIZE;
+  size = *(const size_t *)(const void *)p;
+  if (size == 0)
+    free(p);
+  else
+    munmap(p, size);
+}
+
 #endif
 
 
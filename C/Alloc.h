@@ -24,11 +24,28 @@ void BigFree(void *address);
 
 #define MidAlloc(size) MyAlloc(size)
 #define MidFree(address) MyFree(address)
+
+#ifdef __linux__
+
+/* huge pages: mmap(MAP_HUGETLB) or transparent huge pages (MADV_HUGEPAGE) */
+
+extern size_t g_LargePageSize;
+
+void SetLargePageSize();
+
+void *BigAlloc(size_t size);
+void BigFree(void *address);
+
+#else
+
+#define SetLargePageSize()
 #define BigAlloc(size) MyAlloc(size)
 #define BigFree(address) MyFree(address)
 
 #endif
 
+#endif
+
 extern const ISzAlloc g_Alloc;
 extern const ISzAlloc g_BigAlloc;
 
@@ -11,7 +11,7 @@
 #define USE_ASM
 #endif
 
-#if !defined(USE_ASM) && _MSC_VER >= 1500
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #include <intrin.h>
 #endif
 
@@ -99,14 +99,18 @@ void MyCPUID(UInt32 function, UInt32 *a, UInt32 *b, UInt32 *c, UInt32 *d)
   #endif
       "=c" (*c) ,
       "=d" (*d)
-    : "0" (function)) ;
+    : "0" (function), "2" (0)) ;
 
   #endif
   
   #else
 
   int CPUInfo[4];
+  #if _MSC_VER >= 1600
+  __cpuidex(CPUInfo, function, 0);
+  #else
   __cpuid(CPUInfo, function);
+  #endif
   *a = CPUInfo[0];
   *b = CPUInfo[1];
   *c = CPUInfo[2];
@@ -197,4 +201,43 @@ Bool CPU_Is_Aes_Supported()
   return (p.c >> 25) & 1;
 }
 
+Bool CPU_IsSupported_SSE41()
+{
+  Cx86cpuid p;
+  CHECK_SYS_SSE_SUPPORT
+  if (!x86cpuid_CheckAndRead(&p))
+    return False;
+  return (p.c >> 19) & 1;
+}
+
+/* AVX2 also requires OS support for saving of YMM registers (XCR0 bits 1 and 2) */
+
+static UInt32 x86_xgetbv_0()
+{
+  #if defined(_MSC_VER) && (_MSC_FULL_VER >= 160040219)
+  return (UInt32)_xgetbv(0);
+  #elif defined(__GNUC__) || defined(__clang__)
+  UInt32 a, d;
+  __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (a), "=d" (d) : "c" (0));
+  return a;
+  #else
+  return 0;
+  #endif
+}
+
+Bool CPU_IsSupported_AVX2()
+{
+  Cx86cpuid p;
+  UInt32 a, b, c, d;
+  CHECK_SYS_SSE_SUPPORT
+  if (!x86cpuid_CheckAndRead(&p))
+    return False;
+  if (p.maxFunc < 7 || ((p.c >> 27) & 1) == 0) /* OSXSAVE */
+    return False;
+  if ((x86_xgetbv_0() & 6) != 6)
+    return False;
+  MyCPUID(7, &a, &b, &c, &d);
+  return (b >> 5) & 1;
+}
+
 #endif
@@ -327,6 +327,8 @@ int x86cpuid_GetFirm(const Cx86cpuid *p);
 
 Bool CPU_Is_InOrder();
 Bool CPU_Is_Aes_Supported();
+Bool CPU_IsSupported_SSE41();
+Bool CPU_IsSupported_AVX2();
 
 #endif
 
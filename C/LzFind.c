@@ -5,6 +5,7 @@
 
 #include <string.h>
 
+#include "CpuArch.h"
 #include "LzFind.h"
 #include "LzHash.h"
 
@@ -16,6 +17,70 @@
 
 #define kStartMaxLen 3
 
+/*
+  LZFIND_SATUR_SUB : SIMD code for MatchFinder_Normalize3().
+    (value <= subValue) ? kEmptyHashValue : (value - subValue)
+  is same as unsigned saturating subtraction, because (kEmptyHashValue == 0).
+  x86/x64 : SSE4.1 (max_epu32 + sub) and AVX2, selected at runtime.
+  ARM     : NEON (vqsubq_u32).
+*/
+
+#ifdef MY_CPU_X86_OR_AMD64
+  #if (defined(__clang__) && (__clang_major__ >= 4)) \
+      || (defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 5))
+    #define LZFIND_SATUR_SUB_SSE41
+    #define LZFIND_SATUR_SUB_AVX2
+    #define LZFIND_ATTRIB_SSE41 __attribute__((__target__("sse4.1")))
+    #define LZFIND_ATTRIB_AVX2  __attribute__((__target__("avx2")))
+  #elif defined(_MSC_VER)
+    #if (_MSC_VER >= 1600)
+      #define LZFIND_SATUR_SUB_SSE41
+    #endif
+    #if (_MSC_VER >= 1900)
+      #define LZFIND_SATUR_SUB_AVX2
+    #endif
+  #endif
+#elif defined(MY_CPU_ARM64) || (defined(MY_CPU_ARM) && defined(__ARM_NEON))
+  #if defined(__clang__) || defined(__GNUC__) || (defined(_MSC_VER) && (_MSC_VER >= 1910))
+    #define LZFIND_SATUR_SUB_NEON
+  #endif
+#endif
+
+#ifndef LZFIND_ATTRIB_SSE41
+  #define LZFIND_ATTRIB_SSE41
+#endif
+#ifndef LZFIND_ATTRIB_AVX2
+  #define LZFIND_ATTRIB_AVX2
+#endif
+
+#if defined(LZFIND_SATUR_SUB_SSE41) || defined(LZFIND_SATUR_SUB_AVX2) || defined(LZFIND_SATUR_SUB_NEON)
+  #define LZFIND_SATUR_SUB
+#endif
+
+#if defined(LZFIND_SATUR_SUB_SSE41) || defined(LZFIND_SATUR_SUB_AVX2)
+  #include <immintrin.h>
+#elif defined(LZFIND_SATUR_SUB_NEON)
+  #ifdef _MSC_VER
+    #include <arm64_neon.h>
+  #else
+    #include <arm_neon.h>
+  #endif
+#endif
+
+/*
+  LZFIND_PREFETCH : we prefetch the main hash bucket of the next position,
+  while the binary tree / hash chain for the current position is walked.
+*/
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define LZFIND_PREFETCH(a) __builtin_prefetch((const void *)(a))
+#elif defined(_MSC_VER) && defined(MY_CPU_X86_OR_AMD64)
+  #include <xmmintrin.h>
+  #define LZFIND_PREFETCH(a) _mm_prefetch((const char *)(const void *)(a), _MM_HINT_T0)
+#else
+  #define LZFIND_PREFETCH(a)
+#endif
+
 static void LzInWindow_Free(CMatchFinder *p, ISzAllocPtr alloc)
 {
   if (!p->directInput)
@@ -153,6 +218,8 @@ void MatchFinder_Construct(CMatchFinder *p)
       r = (r >> 1) ^ (kCrcPoly & ((UInt32)0 - (r & 1)));
     p->crc[i] = r;
   }
+
+  LzFindPrepare();
 }
 
 static void MatchFinder_FreeThisClassMemory(CMatchFinder *p, ISzAllocPtr alloc)
@@ -347,17 +414,134 @@ static UInt32 MatchFinder_GetSubValue(CMatchFinder *p)
   return (p->pos - p->historySize - 1) & kNormalizeMask;
 }
 
+#ifdef LZFIND_SATUR_SUB
+
+/* the SIMD code processes (items) aligned for 32 bytes, in blocks of (kSaturSubBlockSize) items */
+
+#define kSaturSubBlockSize 16
+#define kSaturSubAlign 32
+
+typedef void (MY_FAST_CALL *LZFIND_SATUR_SUB_FUNC)(UInt32 subValue, CLzRef *items, const CLzRef *lim);
+
+#ifdef LZFIND_SATUR_SUB_SSE41
+
+#define SASUB_128(i) { \
+    __m128i *d = (__m128i *)(void *)items + (i); \
+    *d = _mm_sub_epi32(_mm_max_epu32(*d, sub2), sub2); }
+
+static LZFIND_ATTRIB_SSE41 void MY_FAST_CALL LzFind_SaturSub_128(UInt32 subValue, CLzRef *items, const CLzRef *lim)
+{
+  const __m128i sub2 = _mm_set1_epi32((Int32)subValue);
+  do
+  {
+    SASUB_128(0)
+    SASUB_128(1)
+    SASUB_128(2)
+    SASUB_128(3)
+    items += kSaturSubBlockSize;
+  }
+  while (items != lim);
+}
+
+#endif
+
+#ifdef LZFIND_SATUR_SUB_AVX2
+
+#define SASUB_256(i) { \
+    __m256i *d = (__m256i *)(void *)items + (i); \
+    *d = _mm256_sub_epi32(_mm256_max_epu32(*d, sub2), sub2); }
+
+static LZFIND_ATTRIB_AVX2 void MY_FAST_CALL LzFind_SaturSub_256(UInt32 subValue, CLzRef *items, const CLzRef *lim)
+{
+  const __m256i sub2 = _mm256_set1_epi32((Int32)subValue);
+  do
+  {
+    SASUB_256(0)
+    SASUB_256(1)
+    items += kSaturSubBlockSize;
+  }
+  while (items != lim);
+}
+
+#endif
+
+#ifdef LZFIND_SATUR_SUB_NEON
+
+#define SASUB_NEON(i) { \
+    uint32x4_t *d = (uint32x4_t *)(void *)items + (i); \
+    *d = vqsubq_u32(*d, sub2); }
+
+static void MY_FAST_CALL LzFind_SaturSub_Neon(UInt32 subValue, CLzRef *items, const CLzRef *lim)
+{
+  const uint32x4_t sub2 = vdupq_n_u32(subValue);
+  do
+  {
+    SASUB_NEON(0)
+    SASUB_NEON(1)
+    SASUB_NEON(2)
+    SASUB_NEON(3)
+    items += kSaturSubBlockSize;
+  }
+  while (items != lim);
+}
+
+#endif
+
+static LZFIND_SATUR_SUB_FUNC g_LzFind_SaturSub;
+
+#endif
+
+
+void LzFindPrepare()
+{
+  #ifdef LZFIND_SATUR_SUB
+  LZFIND_SATUR_SUB_FUNC f = NULL;
+  #if defined(LZFIND_SATUR_SUB_NEON)
+    f = LzFind_SaturSub_Neon;
+  #else
+    #ifdef LZFIND_SATUR_SUB_SSE41
+    if (CPU_IsSupported_SSE41())
+      f = LzFind_SaturSub_128;
+    #endif
+    #ifdef LZFIND_SATUR_SUB_AVX2
+    if (CPU_IsSupported_AVX2())
+      f = LzFind_SaturSub_256;
+    #endif
+  #endif
+  g_LzFind_SaturSub = f;
+  #endif
+}
+
+
 void MatchFinder_Normalize3(UInt32 subValue, CLzRef *items, size_t numItems)
 {
-  size_t i;
-  for (i = 0; i < numItems; i++)
+  #ifdef LZFIND_SATUR_SUB
+  LZFIND_SATUR_SUB_FUNC f = g_LzFind_SaturSub;
+  if (f && numItems >= kSaturSubBlockSize * 4)
   {
-    UInt32 value = items[i];
-    if (value <= subValue)
-      value = kEmptyHashValue;
-    else
-      value -= subValue;
-    items[i] = value;
+    size_t numBlockItems;
+    for (; ((size_t)(ptrdiff_t)items & (kSaturSubAlign - 1)) != 0; numItems--)
+    {
+      UInt32 value = *items;
+      *items++ = (value <= subValue) ? kEmptyHashValue : value - subValue;
+    }
+    numBlockItems = numItems & ~(size_t)(kSaturSubBlockSize - 1);
+    f(subValue, items, items + numBlockItems);
+    items += numBlockItems;
+    numItems -= numBlockItems;
+  }
+  #endif
+  {
+    size_t i;
+    for (i = 0; i < numItems; i++)
+    {
+      UInt32 value = items[i];
+      if (value <= subValue)
+        value = kEmptyHashValue;
+      else
+        value -= subValue;
+      items[i] = value;
+    }
   }
 }
 
@@ -532,6 +716,13 @@ static void MatchFinder_MovePos(CMatchFinder *p) { MOVE_POS; }
 #define GET_MATCHES_HEADER(minLen) GET_MATCHES_HEADER2(minLen, return 0)
 #define SKIP_HEADER(minLen)        GET_MATCHES_HEADER2(minLen, continue)
 
+/* it's allowed to read cur[4] only if (lenLimit > 4) */
+#define PREFETCH_NEXT_HASH4 \
+  if (lenLimit > 4) { \
+    UInt32 temp = p->crc[cur[1]] ^ cur[2]; \
+    temp ^= ((UInt32)cur[3] << 8); \
+    LZFIND_PREFETCH(hash + kFix4HashSize + ((temp ^ (p->crc[cur[4]] << 5)) & p->hashMask)); }
+
 #define MF_PARAMS(p) p->pos, p->buffer, p->son, p->cyclicBufferPos, p->cyclicBufferSize, p->cutValue
 
 #define GET_MATCHES_FOOTER(offset, maxLen) \
@@ -627,6 +818,8 @@ static UInt32 Bt4_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances)
   (hash + kFix3HashSize)[h3] = pos;
   (hash + kFix4HashSize)[hv] = pos;
 
+  PREFETCH_NEXT_HASH4
+
   maxLen = 0;
   offset = 0;
   
@@ -759,6 +952,8 @@ static UInt32 Hc4_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances)
   (hash + kFix3HashSize)[h3] = pos;
   (hash + kFix4HashSize)[hv] = pos;
 
+  PREFETCH_NEXT_HASH4
+
   maxLen = 0;
   offset = 0;
 
@@ -943,6 +1138,7 @@ static void Bt4_MatchFinder_Skip(CMatchFinder *p, UInt32 num)
     hash[                h2] =
     (hash + kFix3HashSize)[h3] =
     (hash + kFix4HashSize)[hv] = p->pos;
+    PREFETCH_NEXT_HASH4
     SKIP_FOOTER
   }
   while (--num != 0);
@@ -982,6 +1178,7 @@ static void Hc4_MatchFinder_Skip(CMatchFinder *p, UInt32 num)
     hash[                h2] =
     (hash + kFix3HashSize)[h3] =
     (hash + kFix4HashSize)[hv] = p->pos;
+    PREFETCH_NEXT_HASH4
     p->son[p->cyclicBufferPos] = curMatch;
     MOVE_POS
   }
@@ -67,6 +67,10 @@ void MatchFinder_ReadIfRequired(CMatchFinder *p);
 
 void MatchFinder_Construct(CMatchFinder *p);
 
+/* LzFindPrepare() selects SIMD code for MatchFinder_Normalize3().
+   MatchFinder_Construct() calls it. */
+void LzFindPrepare();
+
 /* Conditions:
      historySize <= 3 GB
      keepAddBufferBefore + matchMaxLen + keepAddBufferAfter < 511MB
@@ -3,10 +3,24 @@
 
 #include "Precomp.h"
 
+#include "CpuArch.h"
 #include "LzmaDec.h"
 
 #include <string.h>
 
+/*
+  _LZMA_DEC_OPT : faster code for 64-bit CPUs (x64, arm64):
+    - branchless decoding of literal bits (the compiler can use cmov / csel),
+      since the bits of literals are not predictable,
+    - match copying in 8-byte words, if (distance >= 8).
+  The output is identical to the output of portable code.
+  Define _LZMA_DEC_NO_OPT to compile the portable code only.
+*/
+
+#if defined(MY_CPU_64BIT) && defined(MY_CPU_LE_UNALIGN) && !defined(_LZMA_DEC_NO_OPT) && !defined(_LZMA_DEC_OPT)
+  #define _LZMA_DEC_OPT
+#endif
+
 #define kNumTopBits 24
 #define kTopValue ((UInt32)1 << kNumTopBits)
 
@@ -46,6 +60,29 @@
   i -= 0x40; }
 #endif
 
+#ifdef _LZMA_DEC_OPT
+
+/* (m) is (0 - bit) : it's 0 for bit 0, and 0xFFFFFFFF for bit 1 */
+
+#define GET_BIT_BL(p, i, m) \
+  ttt = *(p); NORMALIZE; bound = (range >> kNumBitModelTotalBits) * ttt; \
+  m = (UInt32)0 - (UInt32)(code >= bound); \
+  range = (code < bound) ? bound : range - bound; \
+  code -= bound & m; \
+  *(p) = (CLzmaProb)(ttt + (((kBitModelTotal - ttt) >> kNumMoveBits) & ~m) - ((ttt >> kNumMoveBits) & m)); \
+  i = (i + i) - m;
+
+#define NORMAL_LITER_DEC { UInt32 m; GET_BIT_BL(prob + symbol, symbol, m) }
+#define MATCHED_LITER_DEC { \
+  UInt32 m; \
+  matchByte <<= 1; \
+  bit = (matchByte & offs); \
+  probLit = prob + offs + bit + symbol; \
+  GET_BIT_BL(probLit, symbol, m) \
+  offs &= (~bit ^ (unsigned)m); }
+
+#else
+
 #define NORMAL_LITER_DEC GET_BIT(prob + symbol, symbol)
 #define MATCHED_LITER_DEC \
   matchByte <<= 1; \
@@ -53,6 +90,8 @@
   probLit = prob + offs + bit + symbol; \
   GET_BIT2(probLit, symbol, offs &= ~bit, offs &= bit)
 
+#endif
+
 #define NORMALIZE_CHECK if (range < kTopValue) { if (buf >= bufLimit) return DUMMY_ERROR; range <<= 8; code = (code << 8) | (*buf++); }
 
 #define IF_BIT_0_CHECK(p) ttt = *(p); NORMALIZE_CHECK; bound = (range >> kNumBitModelTotalBits) * ttt; if (code < bound)
@@ -476,6 +515,16 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
           ptrdiff_t src = (ptrdiff_t)pos - (ptrdiff_t)dicPos;
           const Byte *lim = dest + curLen;
           dicPos += curLen;
+          #ifdef _LZMA_DEC_OPT
+          /* we don't write after (lim), since old data there still can be used by next matches */
+          if (src <= -8)
+          {
+            for (; curLen >= 8; curLen -= 8, dest += 8)
+              SetUi64(dest, GetUi64(dest + src));
+            if (dest == lim)
+              continue;
+          }
+          #endif
           do
             *(dest) = (Byte)*(dest + src);
           while (++dest != lim);
@@ -201,7 +201,7 @@ $(LZ5_OBJS): ../../../../C/lz5/$(*B).c
 
 !IFDEF ZSTD_OBJS
 $(ZSTD_OBJS): ../../../../C/zstd/$(*B).c
-	$(COMPL_O2)
+	$(COMPL_O2) -DZSTD_MULTITHREAD
 !ENDIF
 
 !IFDEF ZSTDMT_OBJS
@@ -287,7 +287,7 @@ $(RADYX_OBJS): ../../../Radyx/$(*B).cpp
 {../../../../C/lz5}.c{$O}.obj::
 	$(COMPLB_O2)
 {../../../../C/zstd}.c{$O}.obj::
-	$(COMPLB_O2)
+	$(COMPLB_O2) -DZSTD_MULTITHREAD
 {../../../../C/zstdmt}.c{$O}.obj::
 	$(COMPLB_O2) \
 	-I ../../../../C/brotli \
@@ -48,6 +48,7 @@ struct CCompressionMethodMode
 
   bool DefaultMethod_was_Inserted;
   bool Filter_was_Inserted;
+  bool RestartPoints;
 
   #ifndef _7ZIP_ST
   UInt32 NumThreads;
@@ -61,6 +62,7 @@ struct CCompressionMethodMode
   CCompressionMethodMode():
       DefaultMethod_was_Inserted(false),
       Filter_was_Inserted(false),
+      RestartPoints(false),
       PasswordIsDefined(false)
       #ifndef _7ZIP_ST
       , NumThreads(1)
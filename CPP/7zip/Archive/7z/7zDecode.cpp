@@ -114,6 +114,20 @@ CDecoder::CDecoder(bool useMixerMT):
     _useMixerMT(useMixerMT)
 {}
 
+static const unsigned kNumFreeCodersMax = 4;
+
+int CDecoder::FindFreeCoder(CMethodId methodId) const
+{
+  // we search from the end to get most recently used coder
+  for (unsigned i = _freeCoders.Size(); i != 0;)
+  {
+    i--;
+    if (_freeCoders[i].MethodID == methodId)
+      return (int)i;
+  }
+  return -1;
+}
+
 
 struct CLockedInStream:
   public IUnknown,
@@ -223,6 +237,7 @@ HRESULT CDecoder::Decode(
     UInt64 startPos,
     const CFolders &folders, unsigned folderIndex,
     const UInt64 *unpackSize
+    , const CRestartPoint *restartPoint
 
     , ISequentialOutStream *outStream
     , ICompressProgressInfo *compressProgress
@@ -264,6 +279,27 @@ HRESULT CDecoder::Decode(
     fullUnpack = (*unpackSize == folderUnpackSize);
   }
 
+  /* Restart point is supported only for folder with one coder and one pack stream.
+     We skip restartPoint->PackPos bytes in pack stream and we don't write
+     first restartPoint->UnpackPos bytes of folder to outStream. */
+
+  UInt64 restartPackPos = 0;
+  UInt64 restartUnpackSize = 0;
+
+  if (restartPoint)
+  {
+    if (folderInfo.Coders.Size() != 1
+        || folderInfo.PackStreams.Size() != 1
+        || !outStream)
+      return E_NOTIMPL;
+    restartPackPos = restartPoint->PackPos;
+    restartUnpackSize = (unpackSize ? *unpackSize : folderUnpackSize);
+    if (restartPoint->UnpackPos > restartUnpackSize
+        || restartPackPos > packPositions[1] - packPositions[0])
+      return E_FAIL;
+    restartUnpackSize -= restartPoint->UnpackPos;
+  }
+
   /*
   We don't need to init isEncrypted and passwordIsDefined
   We must upgrade them only
@@ -276,8 +312,17 @@ HRESULT CDecoder::Decode(
   
   if (!_bindInfoPrev_Defined || !AreBindInfoExEqual(bindInfo, _bindInfoPrev))
   {
+    _bindInfoPrev_Defined = false;
     _mixerRef.Release();
 
+    {
+      FOR_VECTOR (k, _mixerCoders)
+        _freeCoders.Add(_mixerCoders[k]);
+      _mixerCoders.Clear();
+      if (_freeCoders.Size() > kNumFreeCodersMax)
+        _freeCoders.DeleteFrontal(_freeCoders.Size() - kNumFreeCodersMax);
+    }
+
     #ifdef USE_MIXER_MT
     #ifdef USE_MIXER_ST
     if (_useMixerMT)
@@ -312,9 +357,20 @@ HRESULT CDecoder::Decode(
       #endif
   
       CCreatedCoder cod;
-      RINOK(CreateCoder(
-          EXTERNAL_CODECS_LOC_VARS
-          coderInfo.MethodID, false, cod));
+      {
+        int freeIndex = FindFreeCoder(coderInfo.MethodID);
+        if (freeIndex >= 0)
+        {
+          cod = _freeCoders[(unsigned)freeIndex].Coder;
+          _freeCoders.Delete((unsigned)freeIndex);
+        }
+        else
+        {
+          RINOK(CreateCoder(
+              EXTERNAL_CODECS_LOC_VARS
+              coderInfo.MethodID, false, cod));
+        }
+      }
     
       if (coderInfo.IsSimpleCoder())
       {
@@ -329,6 +385,11 @@ HRESULT CDecoder::Decode(
           return E_NOTIMPL;
       }
       _mixer->AddCoder(cod);
+      {
+        CCachedCoder &cc = _mixerCoders.AddNew();
+        cc.MethodID = coderInfo.MethodID;
+        cc.Coder = cod;
+      }
       
       // now there is no codec that uses another external codec
       /*
@@ -446,12 +507,14 @@ HRESULT CDecoder::Decode(
         int index = folderInfo.Find_in_PackStreams(packStreamIndex);
         if (index < 0)
           return E_NOTIMPL;
-        packSizes[j] = packPositions[(unsigned)index + 1] - packPositions[(unsigned)index];
+        packSizes[j] = packPositions[(unsigned)index + 1] - packPositions[(unsigned)index] - restartPackPos;
         packSizesPointers[j] = &packSizes[j];
       }
     }
 
     const UInt64 *unpackSizesPointer =
+        restartPoint ?
+            &restartUnpackSize :
         (unpackSize && i == bindInfo.UnpackCoder) ?
             unpackSize :
             &folders.CoderUnpackSizes[unpackStreamIndexStart + i];
@@ -487,7 +550,7 @@ HRESULT CDecoder::Decode(
   for (unsigned j = 0; j < folderInfo.PackStreams.Size(); j++)
   {
     CMyComPtr<ISequentialInStream> packStream;
-    UInt64 packPos = startPos + packPositions[j];
+    UInt64 packPos = startPos + packPositions[j] + restartPackPos;
 
     if (folderInfo.PackStreams.Size() == 1)
     {
@@ -521,7 +584,7 @@ HRESULT CDecoder::Decode(
     CLimitedSequentialInStream *streamSpec = new CLimitedSequentialInStream;
     inStreams.AddNew() = streamSpec;
     streamSpec->SetStream(packStream);
-    streamSpec->Init(packPositions[j + 1] - packPositions[j]);
+    streamSpec->Init(packPositions[j + 1] - packPositions[j] - restartPackPos);
   }
   
   unsigned num = inStreams.Size();
@@ -21,6 +21,12 @@ struct CBindInfoEx: public NCoderMixer2::CBindInfo
   }
 };
 
+struct CCachedCoder
+{
+  CMethodId MethodID;
+  CCreatedCoder Coder;
+};
+
 class CDecoder
 {
   bool _bindInfoPrev_Defined;
@@ -39,6 +45,14 @@ class CDecoder
   NCoderMixer2::CMixer *_mixer;
   CMyComPtr<IUnknown> _mixerRef;
 
+  /* If folders use different methods, the mixer is recreated for each folder.
+     The coders of previous mixers are kept in _freeCoders and reused,
+     so big buffers (dictionaries) of these coders are not allocated again. */
+  CObjectVector<CCachedCoder> _mixerCoders; // coders of current mixer
+  CObjectVector<CCachedCoder> _freeCoders;
+
+  int FindFreeCoder(CMethodId methodId) const;
+
 public:
 
   CDecoder(bool useMixerMT);
@@ -50,6 +64,7 @@ public:
       const CFolders &folders, unsigned folderIndex,
       const UInt64 *unpackSize // if (!unpackSize), then full folder is required
                                // if (unpackSize), then only *unpackSize bytes from folder are required
+      , const CRestartPoint *restartPoint // if (restartPoint), decoding starts from that restart point
 
       , ISequentialOutStream *outStream
       , ICompressProgressInfo *compressProgress
@@ -2,6 +2,8 @@
 
 #include "StdAfx.h"
 
+#include "../../../../C/CpuArch.h"
+
 #include "../../Common/CreateCoder.h"
 #include "../../Common/FilterCoder.h"
 #include "../../Common/LimitedStreams.h"
@@ -281,6 +283,213 @@ STDMETHODIMP CSequentialOutMtNotify::Write(const void *data, UInt32 size, UInt32
 
 
 
+/*
+  CRestartPointsOutStream scans the packed stream of LZMA2 or zstdmt coder
+  and records restart points:
+    LZMA2:   chunks with dictionary reset (control byte >= 0xE0).
+             Chunk headers contain unpack and pack sizes of chunk.
+    zstdmt:  each frame is preceded by 12-byte skippable frame that contains
+             the size of next frame. Unpack size of frame is taken from
+             Frame_Content_Size field of zstd frame header.
+  It doesn't decode the data.
+*/
+
+static const UInt64 kRestartPoints_MinStep = (UInt64)1 << 22;
+
+static const UInt32 kZstdMagicSkippable = 0x184D2A50;
+static const unsigned kZstdSkippableSize = 12;
+static const unsigned kZstdFrameHeaderMin = 4 + 1;
+
+class CRestartPointsOutStream:
+  public ISequentialOutStream,
+  public CMyUnknownImp
+{
+  CMyComPtr<ISequentialOutStream> _stream;
+  CRecordVector<CRestartPoint> *_points;
+  bool _isZstd;
+  bool _stop;
+
+  UInt64 _packPos;
+  UInt64 _unpackPos;
+  UInt64 _blockStart;   // pack position of current chunk or frame
+  UInt64 _skip;         // remaining size of current chunk or frame
+  UInt64 _lastUnpackPos;
+  
+  unsigned _headerSize;
+  unsigned _headerNeed;
+  Byte _header[kZstdSkippableSize + 18];
+
+  void AddPoint();
+  void ParseLzma2Header();
+  void ParseZstdHeader();
+  void Parse(const Byte *data, size_t size);
+public:
+  void Init(ISequentialOutStream *stream, CRecordVector<CRestartPoint> *points, bool isZstd)
+  {
+    _stream = stream;
+    _points = points;
+    _isZstd = isZstd;
+    _stop = false;
+    _packPos = 0;
+    _unpackPos = 0;
+    _blockStart = 0;
+    _skip = 0;
+    _lastUnpackPos = 0;
+    _headerSize = 0;
+    _headerNeed = isZstd ? kZstdSkippableSize + kZstdFrameHeaderMin : 1;
+  }
+
+  MY_UNKNOWN_IMP1(ISequentialOutStream)
+
+  STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
+};
+
+void CRestartPointsOutStream::AddPoint()
+{
+  if (_unpackPos - _lastUnpackPos < kRestartPoints_MinStep)
+    return;
+  CRestartPoint rp;
+  rp.PackPos = _blockStart;
+  rp.UnpackPos = _unpackPos;
+  _points->Add(rp);
+  _lastUnpackPos = _unpackPos;
+}
+
+void CRestartPointsOutStream::ParseLzma2Header()
+{
+  const unsigned control = _header[0];
+  
+  if (_headerSize == 1)
+  {
+    if (control == 0 || (control > 2 && control < 0x80))
+    {
+      // end marker or unsupported chunk
+      _stop = true;
+      return;
+    }
+    _headerNeed = (control < 0x80) ? 3 : (control >= 0xC0 ? 6 : 5);
+    return;
+  }
+
+  UInt32 unpackSize = ((UInt32)_header[1] << 8) + _header[2] + 1;
+  UInt32 packSize = unpackSize;
+  
+  if (control >= 0x80)
+  {
+    unpackSize += (UInt32)(control & 0x1F) << 16;
+    packSize = ((UInt32)_header[3] << 8) + _header[4] + 1;
+    if (control >= 0xE0)
+      AddPoint();
+  }
+  
+  _unpackPos += unpackSize;
+  _skip = packSize;
+  _headerSize = 0;
+  _headerNeed = 1;
+}
+
+void CRestartPointsOutStream::ParseZstdHeader()
+{
+  if (GetUi32(_header) != kZstdMagicSkippable || GetUi32(_header + 4) != 4)
+  {
+    _stop = true;
+    return;
+  }
+  
+  const Byte *p = _header + kZstdSkippableSize;
+  const unsigned fhd = p[4];
+  const unsigned fcsFlag = fhd >> 6;
+  const bool singleSegment = ((fhd >> 5) & 1) != 0;
+  const unsigned didFlag = fhd & 3;
+  
+  if (fcsFlag == 0 && !singleSegment)
+  {
+    // Frame_Content_Size is not stored
+    _stop = true;
+    return;
+  }
+
+  const unsigned fcsSize = (fcsFlag == 0) ? 1 : ((unsigned)1 << fcsFlag);
+  const unsigned fcsOffset = kZstdFrameHeaderMin
+      + (singleSegment ? 0 : 1)
+      + (didFlag == 0 ? 0 : ((unsigned)1 << (didFlag - 1)));
+  
+  const unsigned need = kZstdSkippableSize + fcsOffset + fcsSize;
+  if (_headerSize < need)
+  {
+    _headerNeed = need;
+    return;
+  }
+  
+  p += fcsOffset;
+  UInt64 frameSize;
+  switch (fcsSize)
+  {
+    case 1: frameSize = p[0]; break;
+    case 2: frameSize = (UInt64)GetUi16(p) + 256; break;
+    case 4: frameSize = GetUi32(p); break;
+    default: frameSize = GetUi64(p); break;
+  }
+
+  const UInt32 packSize = GetUi32(_header + 8);
+  if (packSize < _headerSize - kZstdSkippableSize)
+  {
+    _stop = true;
+    return;
+  }
+
+  AddPoint();
+  
+  _unpackPos += frameSize;
+  _skip = packSize - (_headerSize - kZstdSkippableSize);
+  _headerSize = 0;
+  _headerNeed = kZstdSkippableSize + kZstdFrameHeaderMin;
+}
+
+void CRestartPointsOutStream::Parse(const Byte *data, size_t size)
+{
+  while (size != 0 && !_stop)
+  {
+    if (_skip != 0)
+    {
+      size_t cur = size;
+      if (cur > _skip)
+        cur = (size_t)_skip;
+      _skip -= cur;
+      _packPos += cur;
+      data += cur;
+      size -= cur;
+      continue;
+    }
+    
+    if (_headerSize == 0)
+      _blockStart = _packPos;
+    
+    _header[_headerSize++] = *data++;
+    size--;
+    _packPos++;
+    
+    if (_headerSize == _headerNeed)
+    {
+      if (_isZstd)
+        ParseZstdHeader();
+      else
+        ParseLzma2Header();
+    }
+  }
+}
+
+STDMETHODIMP CRestartPointsOutStream::Write(const void *data, UInt32 size, UInt32 *processed)
+{
+  UInt32 realProcessed = 0;
+  HRESULT res = _stream->Write(data, size, &realProcessed);
+  Parse((const Byte *)data, realProcessed);
+  if (processed)
+    *processed = realProcessed;
+  return res;
+}
+
+
 HRESULT CEncoder::Encode(
     DECL_EXTERNAL_CODECS_LOC_VARS
     ISequentialInStream *inStream,
@@ -428,11 +637,31 @@ HRESULT CEncoder::Encode(
   }
   
   
+  folderItem.RestartPoints.Clear();
+  CMyComPtr<ISequentialOutStream> restartPointsStream;
+
+  if (_options.RestartPoints
+      && numMethods == 1
+      && _bindInfo.PackStreams.Size() == 1)
+  {
+    const CMethodId methodId = _options.Methods[0].Id;
+    if (methodId == k_LZMA2 || methodId == k_ZSTD)
+    {
+      CRestartPointsOutStream *restartPointsStreamSpec = new CRestartPointsOutStream;
+      restartPointsStream = restartPointsStreamSpec;
+      restartPointsStreamSpec->Init(mtOutStreamNotify ? (ISequentialOutStream *)mtOutStreamNotify : outStream,
+          &folderItem.RestartPoints, methodId == k_ZSTD);
+    }
+  }
+  
   if (_bindInfo.PackStreams.Size() != 0)
   {
     outStreamSizeCountSpec = new CSequentialOutStreamSizeCount;
     outStreamSizeCount = outStreamSizeCountSpec;
-    outStreamSizeCountSpec->SetStream(mtOutStreamNotify ? (ISequentialOutStream *)mtOutStreamNotify : outStream);
+    if (restartPointsStream)
+      outStreamSizeCountSpec->SetStream(restartPointsStream);
+    else
+      outStreamSizeCountSpec->SetStream(mtOutStreamNotify ? (ISequentialOutStream *)mtOutStreamNotify : outStream);
     outStreamSizeCountSpec->Init();
     outStreamPointers.Add(outStreamSizeCount);
   }
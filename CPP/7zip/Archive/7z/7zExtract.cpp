@@ -8,11 +8,23 @@
 
 #include "../../Common/ProgressUtils.h"
 
+#if !defined(_7ZIP_ST) && !defined(_SFX)
+#include "../../../Windows/System.h"
+
+#include "../../Common/StreamObjects.h"
+#include "../../Common/StreamUtils.h"
+#include "../../Common/VirtThread.h"
+#endif
+
 #include "7zDecode.h"
 #include "7zHandler.h"
 
 // EXTERN_g_ExternalCodecs
 
+#if !defined(_7ZIP_ST) && !defined(_SFX)
+#define _7Z_EXTRACT_MT
+#endif
+
 namespace NArchive {
 namespace N7z {
 
@@ -29,10 +41,16 @@ private:
   bool _calcCrc;
   UInt32 _crc;
   UInt64 _rem;
+  UInt64 _skipRem;
 
   const UInt32 *_indexes;
   unsigned _numFiles;
   unsigned _fileIndex;
+  UInt32 _dupIndex; // if (_dupIndex != kNumNoIndex), data of (*_indexes) file is reported as data of _dupIndex file
+
+  // in duplicate mode we don't report other files of solid block to callback
+  bool IsHiddenFile() const { return _dupIndex != kNumNoIndex && *_indexes != _fileIndex; }
+  UInt32 GetCallbackIndex() const { return _dupIndex != kNumNoIndex ? _dupIndex : _fileIndex; }
 
   HRESULT OpenFile(bool isCorrupted = false);
   HRESULT CloseFile_and_SetResult(Int32 res);
@@ -54,18 +72,20 @@ public:
 
   STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
 
-  HRESULT Init(unsigned startIndex, const UInt32 *indexes, unsigned numFiles);
+  HRESULT Init(unsigned startIndex, const UInt32 *indexes, unsigned numFiles, UInt64 skipSize = 0, UInt32 dupIndex = kNumNoIndex);
   HRESULT FlushCorrupted(Int32 callbackOperationResult);
 
   bool WasWritingFinished() const { return _numFiles == 0; }
 };
 
 
-HRESULT CFolderOutStream::Init(unsigned startIndex, const UInt32 *indexes, unsigned numFiles)
+HRESULT CFolderOutStream::Init(unsigned startIndex, const UInt32 *indexes, unsigned numFiles, UInt64 skipSize, UInt32 dupIndex)
 {
   _fileIndex = startIndex;
   _indexes = indexes;
   _numFiles = numFiles;
+  _skipRem = skipSize;
+  _dupIndex = dupIndex;
   
   _fileIsOpen = false;
   ExtraWriteWasCut = false;
@@ -76,6 +96,16 @@ HRESULT CFolderOutStream::Init(unsigned startIndex, const UInt32 *indexes, unsig
 HRESULT CFolderOutStream::OpenFile(bool isCorrupted)
 {
   const CFileItem &fi = _db->Files[_fileIndex];
+
+  if (IsHiddenFile())
+  {
+    _stream.Release();
+    _calcCrc = false;
+    _fileIsOpen = true;
+    _rem = fi.Size;
+    return S_OK;
+  }
+
   UInt32 nextFileIndex = (_indexes ? *_indexes : _fileIndex);
   Int32 askMode = (_fileIndex == nextFileIndex) ?
         (TestMode ?
@@ -90,7 +120,7 @@ HRESULT CFolderOutStream::OpenFile(bool isCorrupted)
     askMode = NExtract::NAskMode::kTest;
   
   CMyComPtr<ISequentialOutStream> realOutStream;
-  RINOK(ExtractCallback->GetStream(_fileIndex, &realOutStream, askMode));
+  RINOK(ExtractCallback->GetStream(GetCallbackIndex(), &realOutStream, askMode));
   
   _stream = realOutStream;
   _crc = CRC_INIT_VAL;
@@ -109,6 +139,7 @@ HRESULT CFolderOutStream::OpenFile(bool isCorrupted)
 
 HRESULT CFolderOutStream::CloseFile_and_SetResult(Int32 res)
 {
+  const bool hidden = IsHiddenFile();
   _stream.Release();
   _fileIsOpen = false;
   
@@ -121,6 +152,8 @@ HRESULT CFolderOutStream::CloseFile_and_SetResult(Int32 res)
   }
 
   _fileIndex++;
+  if (hidden)
+    return S_OK;
   return ExtractCallback->SetOperationResult(res);
 }
 
@@ -149,6 +182,18 @@ STDMETHODIMP CFolderOutStream::Write(const void *data, UInt32 size, UInt32 *proc
   
   while (size != 0)
   {
+    if (_skipRem != 0)
+    {
+      // data before startIndex file, if decoding was started from restart point
+      UInt32 cur = (size < _skipRem ? size : (UInt32)_skipRem);
+      if (processedSize)
+        *processedSize += cur;
+      data = (const Byte *)data + cur;
+      size -= cur;
+      _skipRem -= cur;
+      continue;
+    }
+
     if (_fileIsOpen)
     {
       UInt32 cur = (size < _rem ? size : (UInt32)_rem);
@@ -208,6 +253,477 @@ HRESULT CFolderOutStream::FlushCorrupted(Int32 callbackOperationResult)
   return S_OK;
 }
 
+struct CExtractRange
+{
+  CNum FolderIndex;
+  UInt32 StartFile;      // first file in the folder, or the file itself, if it has no folder
+  UInt32 NumSolidFiles;  // number of requested items in range
+  UInt64 PackSize;
+  UInt64 UnpackSize;     // unpack size from start of folder to end of last requested file
+  
+  const CRestartPoint *Restart; // if (Restart), StartFile is first file after restart point
+  UInt64 RestartSkip;           // size of data from restart point to StartFile
+
+  UInt64 GetDecodeSize() const { return UnpackSize - (Restart ? Restart->UnpackPos : 0); }
+};
+
+static void GetExtractRange(const CDbEx &db, const UInt32 *indices, UInt32 numItems, UInt32 i, CExtractRange &r)
+{
+  UInt32 fileIndex = indices ? indices[i] : i;
+  CNum folderIndex = db.FileIndexToFolderIndexMap[fileIndex];
+
+  r.FolderIndex = folderIndex;
+  r.NumSolidFiles = 1;
+  r.PackSize = 0;
+  r.UnpackSize = 0;
+  r.Restart = NULL;
+  r.RestartSkip = 0;
+
+  if (folderIndex != kNumNoIndex)
+  {
+    r.PackSize = db.GetFolderFullPackSize(folderIndex);
+    UInt32 nextFile = fileIndex + 1;
+    fileIndex = db.FolderStartFileIndex[folderIndex];
+    UInt32 k;
+
+    for (k = i + 1; k < numItems; k++)
+    {
+      UInt32 fileIndex2 = indices ? indices[k] : k;
+      if (db.FileIndexToFolderIndexMap[fileIndex2] != folderIndex
+          || fileIndex2 < nextFile)
+        break;
+      nextFile = fileIndex2 + 1;
+    }
+    
+    r.NumSolidFiles = k - i;
+    
+    const UInt32 firstFile = indices ? indices[i] : i;
+    UInt64 firstFilePos = 0;
+
+    for (k = fileIndex; k < nextFile; k++)
+    {
+      if (k == firstFile)
+        firstFilePos = r.UnpackSize;
+      r.UnpackSize += db.Files[k].Size;
+    }
+
+    // if there are restart points, we don't decode data before first requested file
+    
+    if (firstFilePos != 0)
+    {
+      const CRestartPoint *rp = db.FindRestartPoint(folderIndex, firstFilePos);
+      if (rp)
+      {
+        UInt64 pos = 0;
+        for (k = fileIndex; pos < rp->UnpackPos; k++)
+          pos += db.Files[k].Size;
+        r.Restart = rp;
+        r.RestartSkip = pos - rp->UnpackPos;
+        fileIndex = k;
+      }
+    }
+  }
+
+  r.StartFile = fileIndex;
+}
+
+static HRESULT SetDecodeResult(HRESULT result, bool dataAfterEnd_Error,
+    CFolderOutStream *folderOutStream,
+    IArchiveExtractCallbackMessage *callbackMessage, CNum folderIndex)
+{
+  if (result == S_FALSE || result == E_NOTIMPL || dataAfterEnd_Error)
+  {
+    bool wasFinished = folderOutStream->WasWritingFinished();
+
+    int resOp = NExtract::NOperationResult::kDataError;
+    
+    if (result != S_FALSE)
+    {
+      if (result == E_NOTIMPL)
+        resOp = NExtract::NOperationResult::kUnsupportedMethod;
+      else if (wasFinished && dataAfterEnd_Error)
+        resOp = NExtract::NOperationResult::kDataAfterEnd;
+    }
+
+    RINOK(folderOutStream->FlushCorrupted(resOp));
+
+    if (wasFinished)
+    {
+      // we don't show error, if it's after required files
+      if (/* !folderOutStream->ExtraWriteWasCut && */ callbackMessage)
+      {
+        RINOK(callbackMessage->ReportExtractResult(NEventIndexType::kBlockIndex, folderIndex, resOp));
+      }
+    }
+    return S_OK;
+  }
+  
+  if (result != S_OK)
+    return result;
+
+  return folderOutStream->FlushCorrupted(NExtract::NOperationResult::kDataError);
+}
+
+
+#ifdef _7Z_EXTRACT_MT
+
+/*
+  Parallel extraction of folders.
+  Folders that follow the current folder are decoded to memory by
+  additional threads, each with its own CDecoder and its own view of
+  archive stream. The main thread writes decoded data of folders
+  to IArchiveExtractCallback in original order. Encrypted folders
+  and folders that are larger than memory limit are decoded by main thread.
+*/
+
+struct CLockedArcStream:
+  public IUnknown,
+  public CMyUnknownImp
+{
+  CMyComPtr<IInStream> Stream;
+  UInt64 Size;
+  NWindows::NSynchronization::CCriticalSection CriticalSection;
+
+  MY_UNKNOWN_IMP
+};
+
+class CLockedArcStreamView:
+  public IInStream,
+  public CMyUnknownImp
+{
+  CLockedArcStream *_glob;
+  CMyComPtr<IUnknown> _globRef;
+  UInt64 _pos;
+public:
+  void Init(CLockedArcStream *glob)
+  {
+    _glob = glob;
+    _globRef = glob;
+    _pos = 0;
+  }
+
+  MY_UNKNOWN_IMP2(ISequentialInStream, IInStream)
+  STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
+};
+
+STDMETHODIMP CLockedArcStreamView::Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  NWindows::NSynchronization::CCriticalSectionLock lock(_glob->CriticalSection);
+  RINOK(_glob->Stream->Seek(_pos, STREAM_SEEK_SET, NULL));
+  UInt32 realProcessedSize = 0;
+  HRESULT res = _glob->Stream->Read(data, size, &realProcessedSize);
+  _pos += realProcessedSize;
+  if (processedSize)
+    *processedSize = realProcessedSize;
+  return res;
+}
+
+STDMETHODIMP CLockedArcStreamView::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+{
+  switch (seekOrigin)
+  {
+    case STREAM_SEEK_SET: break;
+    case STREAM_SEEK_CUR: offset += _pos; break;
+    case STREAM_SEEK_END: offset += _glob->Size; break;
+    default: return STG_E_INVALIDFUNCTION;
+  }
+  if (offset < 0)
+    return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+  _pos = offset;
+  if (newPosition)
+    *newPosition = offset;
+  return S_OK;
+}
+
+
+class CFolderDecodeThread: public CVirtThread
+{
+public:
+  CDecoder Decoder;
+  CMyComPtr<IInStream> InStream;
+  CByteBuffer Buf;
+  CBufPtrSeqOutStream *OutStreamSpec;
+  CMyComPtr<ISequentialOutStream> OutStream;
+
+  const CDbEx *Db;
+  UInt32 StartItem;
+  CNum FolderIndex;
+  UInt64 UnpackSize;
+  const CRestartPoint *Restart;
+  UInt32 NumThreads;
+  
+  HRESULT Result;
+  bool DataAfterEnd_Error;
+
+  DECL_EXTERNAL_CODECS_LOC_VARS2;
+
+  explicit CFolderDecodeThread(bool useMixerMT): Decoder(useMixerMT)
+  {
+    OutStreamSpec = new CBufPtrSeqOutStream;
+    OutStream = OutStreamSpec;
+  }
+  ~CFolderDecodeThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute();
+};
+
+void CFolderDecodeThread::Execute()
+{
+  try
+  {
+    #ifndef _NO_CRYPTO
+    // encrypted folders are not decoded in these threads
+    ICryptoGetTextPassword *getTextPassword = NULL;
+    bool isEncrypted = false;
+    bool passwordIsDefined = false;
+    UString password;
+    #endif
+    
+    DataAfterEnd_Error = false;
+    OutStreamSpec->Init(Buf, (size_t)(UnpackSize - (Restart ? Restart->UnpackPos : 0)));
+    
+    Result = Decoder.Decode(
+        EXTERNAL_CODECS_LOC_VARS
+        InStream,
+        Db->ArcInfo.DataStartPosition,
+        *Db, FolderIndex,
+        &UnpackSize,
+        Restart,
+
+        OutStream,
+        NULL, // compressProgress
+        NULL  // *inStreamMainRes
+        , DataAfterEnd_Error
+        
+        _7Z_DECODER_CRYPRO_VARS
+        , true, NumThreads
+        );
+  }
+  catch(...)
+  {
+    Result = E_FAIL;
+  }
+}
+
+
+struct CFolderDecodeThreads
+{
+  CObjectVector<CFolderDecodeThread> Threads;
+  unsigned First;
+  unsigned NumRunning;
+  UInt32 NextItem;  // next item for planning
+  UInt64 MemUsage;  // the size of buffers of all threads (they are reused for next folders)
+  UInt64 MaxMemUsage;
+
+  CFolderDecodeThreads(): First(0), NumRunning(0), NextItem(0), MemUsage(0), MaxMemUsage(0) {}
+
+  bool IsFirst(UInt32 item) const
+  {
+    return NumRunning != 0 && Threads[First].StartItem == item;
+  }
+
+  // returns false, if there is no memory for buffer. Then main thread decodes that folder.
+  bool AllocBuf(CFolderDecodeThread &thread, size_t size)
+  {
+    MemUsage -= thread.Buf.Size();
+    try
+    {
+      thread.Buf.AllocAtLeast(size);
+    }
+    catch(...)
+    {
+      // AllocAtLeast() frees old buffer before allocation
+      thread.Buf.Free();
+    }
+    MemUsage += thread.Buf.Size();
+    return thread.Buf.Size() >= size;
+  }
+
+  // big buffers are not kept for next folders
+  void ReleaseBuf(CFolderDecodeThread &thread)
+  {
+    const UInt64 bufSize = thread.Buf.Size();
+    if (bufSize > MaxMemUsage / Threads.Size())
+    {
+      MemUsage -= bufSize;
+      thread.Buf.Free();
+    }
+  }
+};
+
+
+/*
+  CFolderOutPipe moves CRC calculation and writing to callback streams
+  from decoder thread to additional thread.
+  The decoder writes data to ring of blocks, and the writer thread passes
+  these blocks to CFolderOutStream in same order. Only the writer thread
+  calls CFolderOutStream between Begin() and Finish(), so the sequence of
+  callback calls is the same as without pipe.
+  The decoder doesn't get progress while the pipe is running: the writer
+  thread reports progress after each block, so all calls of
+  IArchiveExtractCallback are made from one thread at any time.
+*/
+
+static const unsigned kNumPipeBlocks = 4;
+static const size_t kPipeBlockSize = (size_t)1 << 20;
+static const UInt64 kPipeMinSize = (UInt64)1 << 22; // smaller folders are written by decoder thread
+
+class CFolderOutPipe:
+  public ISequentialOutStream,
+  public CMyUnknownImp,
+  public CVirtThread
+{
+  CByteBuffer _blocks[kNumPipeBlocks];
+  size_t _sizes[kNumPipeBlocks];
+  NWindows::NSynchronization::CSemaphore _freeSemaphore;
+  NWindows::NSynchronization::CSemaphore _filledSemaphore;
+  
+  unsigned _writeBlock;
+  size_t _writePos;
+  unsigned _readBlock;
+  
+  HRESULT _result;
+  volatile bool _stopped; // _result was set by writer thread
+  UInt64 _processed;
+
+  HRESULT SendBlock(size_t size);
+  virtual void Execute();
+public:
+  ISequentialOutStream *Stream;
+  ICompressProgressInfo *Progress;
+
+  MY_UNKNOWN_IMP1(ISequentialOutStream)
+  STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
+
+  ~CFolderOutPipe() { CVirtThread::WaitThreadFinish(); }
+  
+  HRESULT CreatePipe();
+  void Begin();
+  HRESULT Finish();
+};
+
+HRESULT CFolderOutPipe::CreatePipe()
+{
+  for (unsigned i = 0; i < kNumPipeBlocks; i++)
+    _blocks[i].Alloc(kPipeBlockSize);
+  RINOK(_freeSemaphore.Create(kNumPipeBlocks, kNumPipeBlocks));
+  RINOK(_filledSemaphore.Create(0, kNumPipeBlocks));
+  return Create();
+}
+
+void CFolderOutPipe::Begin()
+{
+  _writeBlock = 0;
+  _writePos = 0;
+  _readBlock = 0;
+  _result = S_OK;
+  _stopped = false;
+  _processed = 0;
+  Start();
+}
+
+HRESULT CFolderOutPipe::SendBlock(size_t size)
+{
+  // the block must be locked already
+  _sizes[_writeBlock] = size;
+  _writeBlock = (_writeBlock + 1) % kNumPipeBlocks;
+  _writePos = 0;
+  return _filledSemaphore.Release();
+}
+
+STDMETHODIMP CFolderOutPipe::Write(const void *data, UInt32 size, UInt32 *processedSize)
+{
+  if (processedSize)
+    *processedSize = 0;
+  
+  while (size != 0)
+  {
+    if (_stopped)
+      return _result;
+    
+    if (_writePos == 0)
+    {
+      RINOK(_freeSemaphore.Lock());
+    }
+    
+    size_t cur = kPipeBlockSize - _writePos;
+    if (cur > size)
+      cur = size;
+    memcpy(_blocks[_writeBlock] + _writePos, data, cur);
+    _writePos += cur;
+    data = (const Byte *)data + cur;
+    size -= (UInt32)cur;
+    if (processedSize)
+      *processedSize += (UInt32)cur;
+    
+    if (_writePos == kPipeBlockSize)
+    {
+      RINOK(SendBlock(kPipeBlockSize));
+    }
+  }
+  
+  return S_OK;
+}
+
+HRESULT CFolderOutPipe::Finish()
+{
+  if (_writePos != 0)
+  {
+    RINOK(SendBlock(_writePos));
+  }
+  // empty block is end marker
+  RINOK(_freeSemaphore.Lock());
+  RINOK(SendBlock(0));
+  WaitExecuteFinish();
+  return _result;
+}
+
+void CFolderOutPipe::Execute()
+{
+  for (;;)
+  {
+    if (_filledSemaphore.Lock() != 0)
+    {
+      _result = E_FAIL;
+      _stopped = true;
+      return;
+    }
+    
+    const size_t size = _sizes[_readBlock];
+    
+    if (size != 0 && !_stopped)
+    {
+      // after error we still release blocks, so the decoder thread can't be blocked
+      HRESULT res;
+      try
+      {
+        res = WriteStream(Stream, _blocks[_readBlock], size);
+        _processed += size;
+        if (res == S_OK && Progress)
+          res = Progress->SetRatioInfo(NULL, &_processed);
+      }
+      catch(...)
+      {
+        res = E_FAIL;
+      }
+      if (res != S_OK)
+      {
+        _result = res;
+        _stopped = true;
+      }
+    }
+    
+    _readBlock = (_readBlock + 1) % kNumPipeBlocks;
+    _freeSemaphore.Release();
+    
+    if (size == 0)
+      return;
+  }
+}
+
+#endif
+
+
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testModeSpec, IArchiveExtractCallback *extractCallbackSpec)
 {
@@ -237,7 +753,16 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
       UInt32 fileIndex = allFilesMode ? i : indices[i];
       CNum folderIndex = _db.FileIndexToFolderIndexMap[fileIndex];
       if (folderIndex == kNumNoIndex)
+      {
+        UInt32 source;
+        if (_db.DuplicateOf.GetItem(fileIndex, source))
+        {
+          CExtractRange range;
+          GetExtractRange(_db, &source, 1, 0, range);
+          importantTotalUnpacked += range.UnpackSize;
+        }
         continue;
+      }
       if (folderIndex != prevFolder || fileIndex < nextFile)
         nextFile = _db.FolderStartFileIndex[folderIndex];
       for (CNum index = nextFile; index <= fileIndex; index++)
@@ -253,7 +778,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(extractCallback, false);
 
-  CDecoder decoder(
+  const bool useMixerMT =
     #if !defined(USE_MIXER_MT)
       false
     #elif !defined(USE_MIXER_ST)
@@ -267,7 +792,9 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     #else
       _useMultiThreadMixer
     #endif
-    );
+    ;
+
+  CDecoder decoder(useMixerMT);
 
   UInt64 curPacked, curUnpacked;
 
@@ -282,6 +809,58 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   folderOutStream->TestMode = (testModeSpec != 0);
   folderOutStream->CheckCrc = (_crcSize != 0);
 
+  CMyComPtr<IInStream> inStream = _inStream;
+
+  #ifdef _7Z_EXTRACT_MT
+  
+  CFolderDecodeThreads threads;
+  CMyComPtr<IUnknown> lockedStream;
+  CFolderOutPipe *pipeSpec = NULL;
+  CMyComPtr<ISequentialOutStream> pipe;
+  
+  if (_numFolderThreads > 1 && _db.NumFolders > 1)
+  {
+    CLockedArcStream *lockedStreamSpec = new CLockedArcStream;
+    lockedStream = lockedStreamSpec;
+    lockedStreamSpec->Stream = _inStream;
+    RINOK(_inStream->Seek(0, STREAM_SEEK_END, &lockedStreamSpec->Size));
+
+    // main thread also uses locked stream, since it shares _inStream with threads
+    CLockedArcStreamView *viewSpec = new CLockedArcStreamView;
+    inStream = viewSpec;
+    viewSpec->Init(lockedStreamSpec);
+
+    UInt32 numThreads = _numThreads / _numFolderThreads;
+    if (numThreads == 0)
+      numThreads = 1;
+    
+    UInt64 ramSize = (UInt64)(sizeof(size_t)) << 29;
+    NWindows::NSystem::GetRamSize(ramSize);
+    threads.MaxMemUsage = ramSize / 4;
+    
+    const unsigned numFolderThreads = _numFolderThreads - 1;
+    threads.Threads.ClearAndReserve(numFolderThreads);
+    
+    for (unsigned t = 0; t < numFolderThreads; t++)
+    {
+      CFolderDecodeThread *thread = new CFolderDecodeThread(useMixerMT);
+      threads.Threads.AddInReserved_Ptr_of_new(thread);
+      
+      CLockedArcStreamView *threadViewSpec = new CLockedArcStreamView;
+      thread->InStream = threadViewSpec;
+      threadViewSpec->Init(lockedStreamSpec);
+      
+      thread->Db = &_db;
+      thread->NumThreads = numThreads;
+      #ifdef EXTERNAL_CODECS
+      thread->__externalCodecs = EXTERNAL_CODECS_VARS2;
+      #endif
+      RINOK(thread->Create());
+    }
+  }
+  
+  #endif
+
   for (UInt32 i = 0;; lps->OutSize += curUnpacked, lps->InSize += curPacked)
   {
     RINOK(lps->SetCur());
@@ -289,44 +868,111 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     if (i >= numItems)
       break;
 
-    curUnpacked = 0;
-    curPacked = 0;
-
-    UInt32 fileIndex = allFilesMode ? i : indices[i];
-    CNum folderIndex = _db.FileIndexToFolderIndexMap[fileIndex];
-
-    UInt32 numSolidFiles = 1;
-
-    if (folderIndex != kNumNoIndex)
+    #ifdef _7Z_EXTRACT_MT
+    
+    if (threads.Threads.Size() != 0)
     {
-      curPacked = _db.GetFolderFullPackSize(folderIndex);
-      UInt32 nextFile = fileIndex + 1;
-      fileIndex = _db.FolderStartFileIndex[folderIndex];
-      UInt32 k;
-
-      for (k = i + 1; k < numItems; k++)
-      {
-        UInt32 fileIndex2 = allFilesMode ? k : indices[k];
-        if (_db.FileIndexToFolderIndexMap[fileIndex2] != folderIndex
-            || fileIndex2 < nextFile)
-          break;
-        nextFile = fileIndex2 + 1;
-      }
+      // we start decoding of next folders that can be decoded to memory
       
-      numSolidFiles = k - i;
+      if (threads.NextItem < i)
+        threads.NextItem = i;
       
-      for (k = fileIndex; k < nextFile; k++)
-        curUnpacked += _db.Files[k].Size;
+      while (threads.NumRunning < threads.Threads.Size() && threads.NextItem < numItems)
+      {
+        CExtractRange range;
+        GetExtractRange(_db, allFilesMode ? NULL : indices, numItems, threads.NextItem, range);
+        
+        const UInt64 decodeSize = range.GetDecodeSize();
+        
+        if (range.FolderIndex != kNumNoIndex
+            && decodeSize != 0
+            && !IsFolderEncrypted(range.FolderIndex))
+        {
+          CFolderDecodeThread &thread = threads.Threads[(threads.First + threads.NumRunning) % threads.Threads.Size()];
+          const UInt64 bufSize = thread.Buf.Size();
+          const UInt64 newBufSize = MyMax(bufSize, decodeSize);
+          
+          if (newBufSize - bufSize > threads.MaxMemUsage - threads.MemUsage)
+          {
+            if (decodeSize <= threads.MaxMemUsage)
+              break;
+          }
+          // if there is no memory for buffer, the main thread will decode that folder as usual
+          else if (threads.AllocBuf(thread, (size_t)decodeSize))
+          {
+            thread.StartItem = threads.NextItem;
+            thread.FolderIndex = range.FolderIndex;
+            thread.UnpackSize = range.UnpackSize;
+            thread.Restart = range.Restart;
+            thread.Start();
+            threads.NumRunning++;
+          }
+        }
+
+        threads.NextItem += range.NumSolidFiles;
+      }
+    }
+    
+    #endif
+
+    CExtractRange range;
+    GetExtractRange(_db, allFilesMode ? NULL : indices, numItems, i, range);
+    
+    // duplicate file is extracted from solid block of source file
+    UInt32 dupIndex = kNumNoIndex;
+    UInt32 dupSource = 0;
+    if (range.FolderIndex == kNumNoIndex
+        && _db.DuplicateOf.GetItem(range.StartFile, dupSource))
+    {
+      dupIndex = range.StartFile;
+      GetExtractRange(_db, &dupSource, 1, 0, range);
     }
 
+    const CNum folderIndex = range.FolderIndex;
+    curUnpacked = range.UnpackSize;
+    curPacked = range.PackSize;
+
     {
-      HRESULT result = folderOutStream->Init(fileIndex,
-          allFilesMode ? NULL : indices + i,
-          numSolidFiles);
+      HRESULT result = folderOutStream->Init(range.StartFile,
+          dupIndex != kNumNoIndex ? &dupSource : (allFilesMode ? NULL : indices + i),
+          range.NumSolidFiles,
+          range.RestartSkip,
+          dupIndex);
+
+      #ifdef _7Z_EXTRACT_MT
+      const bool isThreadItem = threads.IsFirst(i);
+      #endif
 
-      i += numSolidFiles;
+      i += range.NumSolidFiles;
 
       RINOK(result);
+
+      #ifdef _7Z_EXTRACT_MT
+      if (isThreadItem)
+      {
+        CFolderDecodeThread &thread = threads.Threads[threads.First];
+        thread.WaitExecuteFinish();
+        threads.First = (threads.First + 1) % threads.Threads.Size();
+        threads.NumRunning--;
+        
+        if (folderOutStream->WasWritingFinished())
+        {
+          threads.ReleaseBuf(thread);
+          continue;
+        }
+        
+        result = thread.Result;
+        if (result == S_OK)
+        {
+          result = WriteStream(outStream, thread.Buf, thread.OutStreamSpec->GetPos());
+          if (result == k_My_HRESULT_WritingWasCut)
+            result = S_OK;
+        }
+        threads.ReleaseBuf(thread);
+        RINOK(SetDecodeResult(result, thread.DataAfterEnd_Error, folderOutStream, callbackMessage, folderIndex));
+        continue;
+      }
+      #endif
     }
 
     // to test solid block with zero unpacked size we disable that code
@@ -339,6 +985,10 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
       extractCallback.QueryInterface(IID_ICryptoGetTextPassword, &getTextPassword);
     #endif
 
+    #ifdef _7Z_EXTRACT_MT
+    bool pipeIsRunning = false;
+    #endif
+
     try
     {
       #ifndef _NO_CRYPTO
@@ -350,15 +1000,44 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
       bool dataAfterEnd_Error = false;
 
+      ISequentialOutStream *decodeOutStream = outStream;
+      ICompressProgressInfo *decodeProgress = progress;
+      
+      #ifdef _7Z_EXTRACT_MT
+      if (_numThreads > 1 && range.GetDecodeSize() >= kPipeMinSize)
+      {
+        if (!pipe)
+        {
+          CFolderOutPipe *spec = new CFolderOutPipe;
+          CMyComPtr<ISequentialOutStream> pipeLoc = spec;
+          spec->Stream = outStream;
+          spec->Progress = progress;
+          if (spec->CreatePipe() == S_OK)
+          {
+            pipeSpec = spec;
+            pipe = pipeLoc;
+          }
+        }
+        if (pipe)
+        {
+          pipeIsRunning = true;
+          pipeSpec->Begin();
+          decodeOutStream = pipe;
+          decodeProgress = NULL;
+        }
+      }
+      #endif
+
       HRESULT result = decoder.Decode(
           EXTERNAL_CODECS_VARS
-          _inStream,
+          inStream,
           _db.ArcInfo.DataStartPosition,
           _db, folderIndex,
           &curUnpacked,
+          range.Restart,
 
-          outStream,
-          progress,
+          decodeOutStream,
+          decodeProgress,
           NULL // *inStreamMainRes
           , dataAfterEnd_Error
           
@@ -368,41 +1047,25 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
           #endif
           );
 
-      if (result == S_FALSE || result == E_NOTIMPL || dataAfterEnd_Error)
+      #ifdef _7Z_EXTRACT_MT
+      if (pipeIsRunning)
       {
-        bool wasFinished = folderOutStream->WasWritingFinished();
-
-        int resOp = NExtract::NOperationResult::kDataError;
-        
-        if (result != S_FALSE)
-        {
-          if (result == E_NOTIMPL)
-            resOp = NExtract::NOperationResult::kUnsupportedMethod;
-          else if (wasFinished && dataAfterEnd_Error)
-            resOp = NExtract::NOperationResult::kDataAfterEnd;
-        }
-
-        RINOK(folderOutStream->FlushCorrupted(resOp));
-
-        if (wasFinished)
-        {
-          // we don't show error, if it's after required files
-          if (/* !folderOutStream->ExtraWriteWasCut && */ callbackMessage)
-          {
-            RINOK(callbackMessage->ReportExtractResult(NEventIndexType::kBlockIndex, folderIndex, resOp));
-          }
-        }
-        continue;
+        pipeIsRunning = false;
+        // writing error is more important than decoding result
+        HRESULT pipeRes = pipeSpec->Finish();
+        if (pipeRes != S_OK && pipeRes != k_My_HRESULT_WritingWasCut)
+          result = pipeRes;
       }
-      
-      if (result != S_OK)
-        return result;
+      #endif
 
-      RINOK(folderOutStream->FlushCorrupted(NExtract::NOperationResult::kDataError));
-      continue;
+      RINOK(SetDecodeResult(result, dataAfterEnd_Error, folderOutStream, callbackMessage, folderIndex));
     }
     catch(...)
     {
+      #ifdef _7Z_EXTRACT_MT
+      if (pipeIsRunning)
+        pipeSpec->Finish();
+      #endif
       RINOK(folderOutStream->FlushCorrupted(NExtract::NOperationResult::kDataError));
       // continue;
       return E_FAIL;
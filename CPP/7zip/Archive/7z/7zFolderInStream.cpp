@@ -8,12 +8,14 @@ namespace NArchive {
 namespace N7z {
 
 void CFolderInStream::Init(IArchiveUpdateCallback *updateCallback,
-    const UInt32 *indexes, unsigned numFiles)
+    const UInt32 *indexes, unsigned numFiles, CFileDigests *digests)
 {
   _updateCallback = updateCallback;
   _indexes = indexes;
   _numFiles = numFiles;
   _index = 0;
+  _digests = digests;
+  _digestIndex = -1;
   
   Processed.ClearAndReserve(numFiles);
   CRCs.ClearAndReserve(numFiles);
@@ -33,6 +35,7 @@ HRESULT CFolderInStream::OpenStream()
   _crc = CRC_INIT_VAL;
   _size_Defined = false;
   _size = 0;
+  _digestIndex = -1;
 
   while (_index < _numFiles)
   {
@@ -55,6 +58,12 @@ HRESULT CFolderInStream::OpenStream()
         if (streamGetSize->GetSize(&_size) == S_OK)
           _size_Defined = true;
       }
+      if (_digests)
+      {
+        _digestIndex = _digests->Indexes.FindInSorted(_indexes[_index]);
+        if (_digestIndex >= 0)
+          Sha256_Init(&_sha);
+      }
       return S_OK;
     }
     
@@ -72,6 +81,17 @@ void CFolderInStream::AddFileInfo(bool isProcessed)
   CRCs.Add(CRC_GET_DIGEST(_crc));
 }
 
+void CFolderInStream::CheckDigest()
+{
+  if (_digestIndex < 0)
+    return;
+  Byte digest[SHA256_DIGEST_SIZE];
+  Sha256_Final(&_sha, digest);
+  if (memcmp(digest, _digests->Digests + (size_t)(unsigned)_digestIndex * SHA256_DIGEST_SIZE, SHA256_DIGEST_SIZE) != 0)
+    _digests->Changed[(unsigned)_digestIndex] = true;
+  _digestIndex = -1;
+}
+
 STDMETHODIMP CFolderInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 {
   if (processedSize)
@@ -88,6 +108,8 @@ STDMETHODIMP CFolderInStream::Read(void *data, UInt32 size, UInt32 *processedSiz
       if (cur != 0)
       {
         _crc = CrcUpdate(_crc, data, cur);
+        if (_digestIndex >= 0)
+          Sha256_Update(&_sha, (const Byte *)data, cur);
         _pos += cur;
         if (processedSize)
           *processedSize = cur;
@@ -96,6 +118,7 @@ STDMETHODIMP CFolderInStream::Read(void *data, UInt32 size, UInt32 *processedSiz
       
       _stream.Release();
       _index++;
+      CheckDigest();
       AddFileInfo(true);
 
       _pos = 0;
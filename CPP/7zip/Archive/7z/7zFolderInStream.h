@@ -4,7 +4,9 @@
 #define __7Z_FOLDER_IN_STREAM_H
 
 #include "../../../../C/7zCrc.h"
+#include "../../../../C/Sha256.h"
 
+#include "../../../Common/MyBuffer.h"
 #include "../../../Common/MyCom.h"
 #include "../../../Common/MyVector.h"
 
@@ -14,6 +16,19 @@
 namespace NArchive {
 namespace N7z {
 
+/*
+  SHA-256 digests of files that are sources of duplicates.
+  CFolderInStream calculates the digest of such file, when it reads the file
+  for compression. If the data differs from data of (Digests), it sets (Changed).
+*/
+
+struct CFileDigests
+{
+  CRecordVector<UInt32> Indexes; // sorted update indexes
+  CByteBuffer Digests;           // SHA256_DIGEST_SIZE bytes for each index
+  CRecordVector<bool> Changed;
+};
+
 class CFolderInStream:
   public ISequentialInStream,
   public ICompressGetSubStreamSize,
@@ -29,10 +44,15 @@ class CFolderInStream:
   unsigned _numFiles;
   unsigned _index;
 
+  CFileDigests *_digests;
+  int _digestIndex;
+  CSha256 _sha;
+
   CMyComPtr<IArchiveUpdateCallback> _updateCallback;
 
   HRESULT OpenStream();
   void AddFileInfo(bool isProcessed);
+  void CheckDigest();
 
 public:
   CRecordVector<bool> Processed;
@@ -43,7 +63,8 @@ public:
   STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
   STDMETHOD(GetSubStreamSize)(UInt64 subStream, UInt64 *value);
 
-  void Init(IArchiveUpdateCallback *updateCallback, const UInt32 *indexes, unsigned numFiles);
+  void Init(IArchiveUpdateCallback *updateCallback, const UInt32 *indexes, unsigned numFiles,
+      CFileDigests *digests = NULL);
 
   bool WasFinished() const { return _index == _numFiles; }
 
@@ -45,6 +45,11 @@ public:
   bool _numSolidBytesDefined;
   bool _solidExtension;
   bool _useTypeSorting;
+  bool _useSimilaritySorting;
+  bool _restartPoints;
+  bool _dedup;
+  UInt32 _incompressibleThreshold;
+  bool _appendMode;
 
   bool _compressHeaders;
   bool _encryptHeadersSpecified;
@@ -58,6 +63,10 @@ public:
 
   bool _useMultiThreadMixer;
 
+  #ifndef _7ZIP_ST
+  UInt32 _numFolderThreads;
+  #endif
+
   // bool _volumeMode;
 
   void InitSolidFiles() { _numSolidFiles = (UInt64)(Int64)(-1); }
@@ -136,6 +145,7 @@ private:
   
   #ifdef __7Z_SET_PROPERTIES
   UInt32 _numThreads;
+  UInt32 _numFolderThreads;
   bool _useMultiThreadMixer;
   #endif
 
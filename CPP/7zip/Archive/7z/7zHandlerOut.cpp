@@ -6,6 +6,8 @@
 #include "../../../Common/StringToInt.h"
 #include "../../../Common/Wildcard.h"
 
+#include "../../../Windows/System.h"
+
 #include "../Common/ItemNameUtils.h"
 #include "../Common/ParseProperties.h"
 
@@ -287,10 +289,10 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   
   if (db && !db->Files.IsEmpty())
   {
-    if (!Write_CTime.Def) need_CTime = !db->CTime.Defs.IsEmpty();
-    if (!Write_ATime.Def) need_ATime = !db->ATime.Defs.IsEmpty();
-    if (!Write_MTime.Def) need_MTime = !db->MTime.Defs.IsEmpty();
-    if (!Write_Attrib.Def) need_Attrib = !db->Attrib.Defs.IsEmpty();
+    if (!Write_CTime.Def) need_CTime = !db->CTime.IsEmpty();
+    if (!Write_ATime.Def) need_ATime = !db->ATime.IsEmpty();
+    if (!Write_MTime.Def) need_MTime = !db->MTime.IsEmpty();
+    if (!Write_Attrib.Def) need_Attrib = !db->Attrib.IsEmpty();
   }
 
   // UString s;
@@ -543,17 +545,34 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
 
   CCompressionMethodMode methodMode, headerMethod;
 
+  #ifndef _7ZIP_ST
+  /* solid blocks compressed at the same time share the threads of -mmt:
+     (numFolderThreads * numThreads <= _numThreads) */
+  UInt32 numFolderThreads = _numFolderThreads;
+  UInt32 numThreads = _numThreads;
+  if (numFolderThreads > 1)
+  {
+    if (numFolderThreads > _numThreads)
+      numFolderThreads = _numThreads;
+    if (numFolderThreads < 1)
+      numFolderThreads = 1;
+    numThreads = _numThreads / numFolderThreads;
+  }
+  #endif
+
   HRESULT res = SetMainMethod(methodMode
     #ifndef _7ZIP_ST
-    , _numThreads
+    , numThreads
     #endif
     );
   RINOK(res);
 
   RINOK(SetHeaderMethod(headerMethod));
+
+  methodMode.RestartPoints = _restartPoints;
   
   #ifndef _7ZIP_ST
-  methodMode.NumThreads = _numThreads;
+  methodMode.NumThreads = numThreads;
   methodMode.MultiThreadMixer = _useMultiThreadMixer;
   headerMethod.NumThreads = 1;
   headerMethod.MultiThreadMixer = _useMultiThreadMixer;
@@ -628,12 +647,26 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   options.NumSolidBytes = _numSolidBytes;
   options.SolidExtension = _solidExtension;
   options.UseTypeSorting = _useTypeSorting;
+  options.UseSimilaritySorting = _useSimilaritySorting;
+  options.Dedup = _dedup;
+  options.IncompressibleThreshold = _incompressibleThreshold;
+  options.AppendMode = _appendMode;
 
   options.RemoveSfxBlock = _removeSfxBlock;
   // options.VolumeMode = _volumeMode;
 
   options.MultiThreadMixer = _useMultiThreadMixer;
 
+  #ifndef _7ZIP_ST
+  options.NumFolderThreads = numFolderThreads;
+  if (numFolderThreads > 1)
+  {
+    UInt64 ramSize = (UInt64)(sizeof(size_t)) << 29;
+    NSystem::GetRamSize(ramSize);
+    options.FolderThreadsMemory = ramSize / 4;
+  }
+  #endif
+
   COutArchive archive;
   CArchiveDatabaseOut newDatabase;
 
@@ -717,10 +750,19 @@ void COutHandler::InitProps()
 
   _useMultiThreadMixer = true;
 
+  #ifndef _7ZIP_ST
+  _numFolderThreads = 1;
+  #endif
+
   // _volumeMode = false;
 
   InitSolid();
   _useTypeSorting = false;
+  _useSimilaritySorting = false;
+  _restartPoints = false;
+  _dedup = false;
+  _incompressibleThreshold = 0;
+  _appendMode = false;
 }
 
 HRESULT COutHandler::SetSolidFromString(const UString &s)
@@ -843,7 +885,27 @@ HRESULT COutHandler::SetProperty(const wchar_t *nameSpec, const PROPVARIANT &val
     
     if (name.IsEqualTo("mtf")) return PROPVARIANT_to_bool(value, _useMultiThreadMixer);
 
+    #ifndef _7ZIP_ST
+    if (name.IsPrefixedBy_Ascii_NoCase("mtb"))
+      return ParseMtProp(name.Ptr(3), value, _numProcessors, _numFolderThreads);
+    #endif
+
     if (name.IsEqualTo("qs")) return PROPVARIANT_to_bool(value, _useTypeSorting);
+    if (name.IsEqualTo("qsim")) return PROPVARIANT_to_bool(value, _useSimilaritySorting);
+    if (name.IsEqualTo("rp")) return PROPVARIANT_to_bool(value, _restartPoints);
+    if (name.IsEqualTo("dd")) return PROPVARIANT_to_bool(value, _dedup);
+    
+    if (name.IsPrefixedBy_Ascii_NoCase("ent"))
+    {
+      UInt32 v = 0;
+      RINOK(ParsePropToUInt32(name.Ptr(3), value, v));
+      if (v > 100)
+        return E_INVALIDARG;
+      _incompressibleThreshold = v;
+      return S_OK;
+    }
+    
+    if (name.IsEqualTo("ap")) return PROPVARIANT_to_bool(value, _appendMode);
 
     // if (name.IsEqualTo("v"))  return PROPVARIANT_to_bool(value, _volumeMode);
   }
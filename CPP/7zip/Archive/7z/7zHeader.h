@@ -93,6 +93,9 @@ namespace NID
     // kNtSecure,
     // kParent,
     // kIsAux
+
+    , kRestartPoints = 0x40 // restart points in solid folders (not known to original 7-Zip)
+    , kDuplicateOf          // index of file with same data (not known to original 7-Zip)
   };
 }
 
@@ -14,6 +14,10 @@
 #include "../../Common/StreamObjects.h"
 #include "../../Common/StreamUtils.h"
 
+#ifndef _7ZIP_ST
+#include "../../../Windows/Thread.h"
+#endif
+
 #include "7zDecode.h"
 #include "7zIn.h"
 
@@ -457,6 +461,30 @@ void CFolders::ParseFolderInfo(unsigned folderIndex, CFolder &folder) const
   inByte.ParseFolder(folder);
   if (inByte.GetRem() != 0)
     throw 20120424;
+
+  folder.RestartPoints.Clear();
+  if (!RestartPoints.IsEmpty())
+    for (CNum i = FoToRestartPoints[folderIndex]; i < FoToRestartPoints[folderIndex + 1]; i++)
+      folder.RestartPoints.Add(RestartPoints[i]);
+}
+
+const CRestartPoint *CFolders::FindRestartPoint(unsigned folderIndex, UInt64 unpackPos) const
+{
+  if (RestartPoints.IsEmpty())
+    return NULL;
+  CNum left = FoToRestartPoints[folderIndex];
+  CNum right = FoToRestartPoints[folderIndex + 1];
+  while (left != right)
+  {
+    CNum mid = (left + right) / 2;
+    if (RestartPoints[mid].UnpackPos <= unpackPos)
+      left = mid + 1;
+    else
+      right = mid;
+  }
+  if (left == FoToRestartPoints[folderIndex])
+    return NULL;
+  return &RestartPoints[left - 1];
 }
 
 
@@ -1047,25 +1075,44 @@ void CInArchive::ReadBoolVector2(unsigned numItems, CBoolVector &v)
     p[i] = true;
 }
 
-void CInArchive::ReadUInt64DefVector(const CObjectVector<CByteBuffer> &dataVector,
-    CUInt64DefVector &v, unsigned numItems)
+// it copies the bits and values of property without decoding. See CPackedDefs.
+
+void CInArchive::ReadPackedDefs(const CObjectVector<CByteBuffer> &dataVector,
+    CPackedDefs &v, unsigned numItems, unsigned itemSize)
 {
-  ReadBoolVector2(numItems, v.Defs);
+  v.Clear();
+  size_t numDefined = numItems;
+  
+  const Byte allAreDefined = ReadByte();
+  if (allAreDefined == 0)
+  {
+    const size_t defsSize = ((size_t)numItems + 7) >> 3;
+    v.Defs.Alloc(defsSize);
+    ReadBytes(v.Defs, defsSize);
+    if ((numItems & 7) != 0)
+      v.Defs[defsSize - 1] &= (Byte)(0xFF << (8 - (numItems & 7)));
+    
+    const unsigned kBlockBytes = (unsigned)1 << (kPackedDefs_BlockBits - 3);
+    v.Ranks.Alloc((defsSize + kBlockBytes - 1) / kBlockBytes);
+    numDefined = 0;
+    const Byte *defs = v.Defs;
+    for (size_t i = 0; i < defsSize; i++)
+    {
+      if ((i & (kBlockBytes - 1)) == 0)
+        v.Ranks[i / kBlockBytes] = (UInt32)numDefined;
+      numDefined += CPackedDefs::CountBits(defs[i]);
+    }
+  }
 
   CStreamSwitch streamSwitch;
   streamSwitch.Set(this, &dataVector);
-  
-  v.Vals.ClearAndSetSize(numItems);
-  UInt64 *p = &v.Vals[0];
-  const bool *defs = &v.Defs[0];
 
-  for (unsigned i = 0; i < numItems; i++)
-  {
-    UInt64 t = 0;
-    if (defs[i])
-      t = ReadUInt64();
-    p[i] = t;
-  }
+  if (numDefined > _inByteBack->GetRem() / itemSize)
+    ThrowEndOfData();
+  const size_t valsSize = numDefined * itemSize;
+  v.Vals.Alloc(valsSize);
+  ReadBytes(v.Vals, valsSize);
+  v.NumItems = numItems;
 }
 
 HRESULT CInArchive::ReadAndDecodePackedStreams(
@@ -1107,6 +1154,7 @@ HRESULT CInArchive::ReadAndDecodePackedStreams(
         _stream, baseOffset + dataOffset,
         folders, i,
         NULL, // *unpackSize
+        NULL, // restartPoint
         
         outStream,
         NULL, // *compressProgress
@@ -1138,6 +1186,164 @@ HRESULT CInArchive::ReadAndDecodePackedStreams(
   return S_OK;
 }
 
+void CInArchive::ReadRestartPoints(CFolders &f)
+{
+  CRecordVector<CRestartPoint> &points = f.RestartPoints;
+  points.Clear();
+  f.FoToRestartPoints.Alloc(f.NumFolders + 1);
+  
+  for (CNum i = 0; i < f.NumFolders; i++)
+  {
+    f.FoToRestartPoints[i] = points.Size();
+    CNum numPoints = ReadNum();
+    if (numPoints == 0)
+      continue;
+    
+    // restart points are allowed only for folders with one pack stream
+    const CNum packStreamIndex = f.FoStartPackStreamIndex[i];
+    if (f.FoStartPackStreamIndex[i + 1] - packStreamIndex != 1)
+      ThrowIncorrect();
+    
+    const UInt64 packSize = f.GetStreamPackSize(packStreamIndex);
+    const UInt64 unpackSize = f.GetFolderUnpackSize(i);
+    
+    CRestartPoint rp;
+    rp.PackPos = 0;
+    rp.UnpackPos = 0;
+    
+    for (; numPoints != 0; numPoints--)
+    {
+      const UInt64 packDelta = ReadNumber();
+      const UInt64 unpackDelta = ReadNumber();
+      if (packDelta == 0 || packDelta >= packSize - rp.PackPos
+          || unpackDelta == 0 || unpackDelta >= unpackSize - rp.UnpackPos)
+        ThrowIncorrect();
+      rp.PackPos += packDelta;
+      rp.UnpackPos += unpackDelta;
+      points.Add(rp);
+    }
+  }
+  
+  f.FoToRestartPoints[f.NumFolders] = points.Size();
+  
+  if (points.IsEmpty())
+    f.FoToRestartPoints.Free();
+}
+
+/*
+  Names, attributes and times take most of the header of big archive.
+  These properties don't depend on each other, so they are read
+  after main loop of ReadHeader(). Attributes, times and start positions
+  are kept in packed form and each value is decoded by GetItem(), when
+  it's requested. Names are kept as is, but the offsets of names are found
+  here. Each big property is read by separate thread, while main thread
+  fills CFileItem records and links between files and folders.
+*/
+
+void CInArchive::ReadFileProp(UInt64 type, const CObjectVector<CByteBuffer> &dataVector,
+    CDbEx &db, CNum numFiles)
+{
+  switch ((UInt32)type)
+  {
+    case NID::kName:
+    {
+      CStreamSwitch streamSwitch;
+      streamSwitch.Set(this, &dataVector);
+      size_t rem = _inByteBack->GetRem();
+      db.NamesBuf.Alloc(rem);
+      ReadBytes(db.NamesBuf, rem);
+      db.NameOffsets.Alloc(numFiles + 1);
+      size_t pos = 0;
+      unsigned i;
+      for (i = 0; i < numFiles; i++)
+      {
+        size_t curRem = (rem - pos) / 2;
+        const UInt16 *buf = (const UInt16 *)(db.NamesBuf + pos);
+        size_t j;
+        for (j = 0; j < curRem && buf[j] != 0; j++);
+        if (j == curRem)
+          ThrowEndOfData();
+        db.NameOffsets[i] = pos / 2;
+        pos += j * 2 + 2;
+      }
+      db.NameOffsets[i] = pos / 2;
+      if (pos != rem)
+        ThereIsHeaderError = true;
+      break;
+    }
+
+    case NID::kWinAttrib:  ReadPackedDefs(dataVector, db.Attrib, (unsigned)numFiles, 4); break;
+    case NID::kStartPos:  ReadPackedDefs(dataVector, db.StartPos, (unsigned)numFiles, 8); break;
+    case NID::kCTime:  ReadPackedDefs(dataVector, db.CTime, (unsigned)numFiles, 8); break;
+    case NID::kATime:  ReadPackedDefs(dataVector, db.ATime, (unsigned)numFiles, 8); break;
+    case NID::kMTime:  ReadPackedDefs(dataVector, db.MTime, (unsigned)numFiles, 8); break;
+  }
+}
+
+struct CFilePropDecoder
+{
+  UInt64 Type;
+  const Byte *Data;
+  size_t Size;
+
+  const CObjectVector<CByteBuffer> *DataVector;
+  CDbEx *Db;
+  CNum NumFiles;
+
+  bool HeaderError;
+  bool Error;       // CInArchiveException was thrown
+  bool OtherError;  // another exception was thrown
+
+  #ifndef _7ZIP_ST
+  NWindows::CThread Thread;
+  
+  ~CFilePropDecoder() { WaitFinish(); }
+  
+  void WaitFinish()
+  {
+    if (Thread.IsCreated())
+    {
+      Thread.Wait();
+      Thread.Close();
+    }
+  }
+  #endif
+
+  CFilePropDecoder(): HeaderError(false), Error(false), OtherError(false) {}
+  void Decode();
+};
+
+void CFilePropDecoder::Decode()
+{
+  CInArchive archive(false);
+  archive.ThereIsHeaderError = false;
+  try
+  {
+    CStreamSwitch switchProp;
+    switchProp.Set(&archive, Data, Size, false);
+    archive.ReadFileProp(Type, *DataVector, *Db, NumFiles);
+    if (archive._inByteBack->GetRem() != 0)
+      ThrowIncorrect();
+  }
+  catch(CInArchiveException &) { Error = true; }
+  catch(...) { OtherError = true; }
+  HeaderError = archive.ThereIsHeaderError;
+}
+
+#ifndef _7ZIP_ST
+
+static THREAD_FUNC_DECL FilePropDecoderThread(void *p)
+{
+  ((CFilePropDecoder *)p)->Decode();
+  return 0;
+}
+
+// smaller property is read faster than new thread is created
+static const size_t kMinSize_for_MtPropDecode = (size_t)1 << 16;
+
+#endif
+
+
 HRESULT CInArchive::ReadHeader(
     DECL_EXTERNAL_CODECS_LOC_VARS
     CDbEx &db
@@ -1170,6 +1376,7 @@ HRESULT CInArchive::ReadHeader(
 
   CRecordVector<UInt64> unpackSizes;
   CUInt32DefVector digests;
+  CObjectVector<CFilePropDecoder> propDecoders;
   
   if (type == NID::kMainStreamsInfo)
   {
@@ -1215,38 +1422,26 @@ HRESULT CInArchive::ReadHeader(
     else switch ((UInt32)type2)
     {
       case NID::kName:
-      {
-        CStreamSwitch streamSwitch;
-        streamSwitch.Set(this, &dataVector);
-        size_t rem = _inByteBack->GetRem();
-        db.NamesBuf.Alloc(rem);
-        ReadBytes(db.NamesBuf, rem);
-        db.NameOffsets.Alloc(numFiles + 1);
-        size_t pos = 0;
-        unsigned i;
-        for (i = 0; i < numFiles; i++)
-        {
-          size_t curRem = (rem - pos) / 2;
-          const UInt16 *buf = (const UInt16 *)(db.NamesBuf + pos);
-          size_t j;
-          for (j = 0; j < curRem && buf[j] != 0; j++);
-          if (j == curRem)
-            ThrowEndOfData();
-          db.NameOffsets[i] = pos / 2;
-          pos += j * 2 + 2;
-        }
-        db.NameOffsets[i] = pos / 2;
-        if (pos != rem)
-          ThereIsHeaderError = true;
-        break;
-      }
-
       case NID::kWinAttrib:
+      case NID::kStartPos:
+      case NID::kCTime:
+      case NID::kATime:
+      case NID::kMTime:
       {
-        ReadBoolVector2(numFiles, db.Attrib.Defs);
-        CStreamSwitch streamSwitch;
-        streamSwitch.Set(this, &dataVector);
-        Read_UInt32_Vector(db.Attrib);
+        // it will be decoded later by ReadFileProp()
+        CFilePropDecoder *dec = NULL;
+        FOR_VECTOR (k, propDecoders)
+          if (propDecoders[k].Type == type2)
+            dec = &propDecoders[k];
+        if (!dec)
+          dec = &propDecoders.AddNew();
+        dec->Type = type2;
+        dec->Data = _inByteBack->GetPtr();
+        dec->Size = _inByteBack->GetRem();
+        dec->DataVector = &dataVector;
+        dec->Db = &db;
+        dec->NumFiles = numFiles;
+        _inByteBack->SkipRem();
         break;
       }
       
@@ -1290,10 +1485,6 @@ HRESULT CInArchive::ReadHeader(
       }
       case NID::kEmptyFile:  ReadBoolVector(numEmptyStreams, emptyFileVector); break;
       case NID::kAnti:  ReadBoolVector(numEmptyStreams, antiFileVector); break;
-      case NID::kStartPos:  ReadUInt64DefVector(dataVector, db.StartPos, (unsigned)numFiles); break;
-      case NID::kCTime:  ReadUInt64DefVector(dataVector, db.CTime, (unsigned)numFiles); break;
-      case NID::kATime:  ReadUInt64DefVector(dataVector, db.ATime, (unsigned)numFiles); break;
-      case NID::kMTime:  ReadUInt64DefVector(dataVector, db.MTime, (unsigned)numFiles); break;
       case NID::kDummy:
       {
         for (UInt64 j = 0; j < size; j++)
@@ -1302,6 +1493,31 @@ HRESULT CInArchive::ReadHeader(
         addPropIdToList = false;
         break;
       }
+      case NID::kDuplicateOf:
+      {
+        ReadBoolVector2(numFiles, db.DuplicateOf.Defs);
+        CStreamSwitch streamSwitch;
+        streamSwitch.Set(this, &dataVector);
+        Read_UInt32_Vector(db.DuplicateOf);
+        addPropIdToList = false;
+        break;
+      }
+      case NID::kRestartPoints:
+      {
+        try
+        {
+          ReadRestartPoints(db);
+        }
+        catch(CInArchiveException &)
+        {
+          ThereIsHeaderError = true;
+          db.FoToRestartPoints.Free();
+          db.RestartPoints.Clear();
+          _inByteBack->SkipRem();
+        }
+        addPropIdToList = false;
+        break;
+      }
       /*
       case NID::kNtSecure:
       {
@@ -1370,6 +1586,17 @@ HRESULT CInArchive::ReadHeader(
   if (numFiles - numEmptyStreams != unpackSizes.Size())
     ThrowUnsupported();
 
+  FOR_VECTOR (k, propDecoders)
+  {
+    CFilePropDecoder &dec = propDecoders[k];
+    #ifndef _7ZIP_ST
+    if (dec.Size >= kMinSize_for_MtPropDecode
+        && dec.Thread.Create(FilePropDecoderThread, &dec) == 0)
+      continue;
+    #endif
+    dec.Decode();
+  }
+
   CNum emptyFileIndex = 0;
   CNum sizeIndex = 0;
 
@@ -1408,11 +1635,51 @@ HRESULT CInArchive::ReadHeader(
     if (numAntiItems != 0)
       db.IsAnti[i] = isAnti;
   }
+
+  if (!db.DuplicateOf.Defs.IsEmpty())
+  {
+    // duplicate is stored as empty file. It gets size and CRC of source file.
+    for (CNum i = 0; i < numFiles; i++)
+    {
+      if (!db.DuplicateOf.Defs[i])
+        continue;
+      const UInt32 source = db.DuplicateOf.Vals[i];
+      CFileItem &file = db.Files[i];
+      if (source >= numFiles
+          || !db.Files[source].HasStream
+          || file.HasStream
+          || file.IsDir
+          || db.IsItemAnti(i))
+      {
+        ThereIsHeaderError = true;
+        db.DuplicateOf.Defs[i] = false;
+        continue;
+      }
+      const CFileItem &sourceFile = db.Files[source];
+      file.Size = sourceFile.Size;
+      file.CrcDefined = sourceFile.CrcDefined;
+      file.Crc = sourceFile.Crc;
+    }
+  }
   
   }
   
   db.FillLinks();
 
+  FOR_VECTOR (k, propDecoders)
+  {
+    CFilePropDecoder &dec = propDecoders[k];
+    #ifndef _7ZIP_ST
+    dec.WaitFinish();
+    #endif
+    if (dec.HeaderError)
+      ThereIsHeaderError = true;
+    if (dec.OtherError)
+      return E_OUTOFMEMORY;
+    if (dec.Error)
+      ThrowIncorrect();
+  }
+
   if (type != NID::kEnd || _inByteBack->GetRem() != 0)
   {
     db.UnsupportedFeatureWarning = true;
@@ -3,6 +3,8 @@
 #ifndef __7Z_IN_H
 #define __7Z_IN_H
 
+#include "../../../../C/CpuArch.h"
+
 #include "../../../Common/MyCom.h"
 
 #include "../../../Windows/PropVariant.h"
@@ -63,6 +65,9 @@ struct CFolders
   CObjArray<size_t> FoCodersDataOffset;    // NumFolders + 1
   CByteBuffer CodersData;
 
+  CObjArray<CNum> FoToRestartPoints;       // NumFolders + 1, if (!RestartPoints.IsEmpty())
+  CRecordVector<CRestartPoint> RestartPoints;
+
   CParsedMethods ParsedMethods;
 
   void ParseFolderInfo(unsigned folderIndex, CFolder &folder) const;
@@ -87,6 +92,9 @@ struct CFolders
     return PackPositions[index + 1] - PackPositions[index];
   }
 
+  // returns the last restart point with (UnpackPos <= unpackPos), or NULL
+  const CRestartPoint *FindRestartPoint(unsigned folderIndex, UInt64 unpackPos) const;
+
   CFolders(): NumPackStreams(0), NumFolders(0) {}
 
   void Clear()
@@ -104,6 +112,96 @@ struct CFolders
     FoToMainUnpackSizeIndex.Free();
     FoCodersDataOffset.Free();
     CodersData.Free();
+    FoToRestartPoints.Free();
+    RestartPoints.Clear();
+  }
+};
+
+/*
+  File property vector in the packed form of archive header:
+  (Defs) bits of defined items and values of defined items only.
+  The value of item is decoded, when it's requested.
+  (Ranks) contains the number of defined items before each block
+  of (1 << kPackedDefs_BlockBits) items.
+*/
+
+const unsigned kPackedDefs_BlockBits = 6;
+
+struct CPackedDefs
+{
+  CByteBuffer Defs;         // empty, if all items are defined
+  CByteBuffer Vals;
+  CObjArray<UInt32> Ranks;
+  unsigned NumItems;        // 0, if there is no such property in archive
+
+  CPackedDefs(): NumItems(0) {}
+
+  void Clear()
+  {
+    Defs.Free();
+    Vals.Free();
+    Ranks.Free();
+    NumItems = 0;
+  }
+
+  bool IsEmpty() const { return NumItems == 0; }
+
+  bool GetValIndex(unsigned index, size_t &valIndex) const
+  {
+    if (index >= NumItems)
+      return false;
+    if (Defs.Size() == 0)
+    {
+      valIndex = index;
+      return true;
+    }
+    const Byte *defs = Defs;
+    const unsigned bytePos = index >> 3;
+    const unsigned b = defs[bytePos];
+    if ((b & (0x80 >> (index & 7))) == 0)
+      return false;
+    size_t v = Ranks[index >> kPackedDefs_BlockBits];
+    for (unsigned i = (bytePos & ~(((unsigned)1 << (kPackedDefs_BlockBits - 3)) - 1)); i < bytePos; i++)
+      v += CountBits(defs[i]);
+    valIndex = v + CountBits(b >> (8 - (index & 7)));
+    return true;
+  }
+
+  static unsigned CountBits(unsigned b)
+  {
+    b = b - ((b >> 1) & 0x55);
+    b = (b & 0x33) + ((b >> 2) & 0x33);
+    return (b + (b >> 4)) & 0xF;
+  }
+};
+
+struct CPackedUInt32DefVector: public CPackedDefs
+{
+  bool GetItem(unsigned index, UInt32 &value) const
+  {
+    size_t valIndex;
+    if (GetValIndex(index, valIndex))
+    {
+      value = GetUi32((const Byte *)Vals + valIndex * 4);
+      return true;
+    }
+    value = 0;
+    return false;
+  }
+};
+
+struct CPackedUInt64DefVector: public CPackedDefs
+{
+  bool GetItem(unsigned index, UInt64 &value) const
+  {
+    size_t valIndex;
+    if (GetValIndex(index, valIndex))
+    {
+      value = GetUi64((const Byte *)Vals + valIndex * 8);
+      return true;
+    }
+    value = 0;
+    return false;
   }
 };
 
@@ -111,12 +209,13 @@ struct CDatabase: public CFolders
 {
   CRecordVector<CFileItem> Files;
 
-  CUInt64DefVector CTime;
-  CUInt64DefVector ATime;
-  CUInt64DefVector MTime;
-  CUInt64DefVector StartPos;
-  CUInt32DefVector Attrib;
+  CPackedUInt64DefVector CTime;
+  CPackedUInt64DefVector ATime;
+  CPackedUInt64DefVector MTime;
+  CPackedUInt64DefVector StartPos;
+  CPackedUInt32DefVector Attrib;
   CBoolVector IsAnti;
+  CUInt32DefVector DuplicateOf; // file without stream that has same data as file with stream
   /*
   CBoolVector IsAux;
   CByteBuffer SecureBuf;
@@ -149,6 +248,7 @@ struct CDatabase: public CFolders
     StartPos.Clear();
     Attrib.Clear();
     IsAnti.Clear();
+    DuplicateOf.Clear();
     // IsAux.Clear();
   }
 
@@ -327,6 +427,7 @@ const UInt32 kHeaderSize = 32;
 class CInArchive
 {
   friend class CStreamSwitch;
+  friend struct CFilePropDecoder;
 
   CMyComPtr<IInStream> _stream;
 
@@ -396,8 +497,11 @@ class CInArchive
 
   void ReadBoolVector(unsigned numItems, CBoolVector &v);
   void ReadBoolVector2(unsigned numItems, CBoolVector &v);
-  void ReadUInt64DefVector(const CObjectVector<CByteBuffer> &dataVector,
-      CUInt64DefVector &v, unsigned numItems);
+  void ReadRestartPoints(CFolders &f);
+  void ReadPackedDefs(const CObjectVector<CByteBuffer> &dataVector,
+      CPackedDefs &v, unsigned numItems, unsigned itemSize);
+  void ReadFileProp(UInt64 type, const CObjectVector<CByteBuffer> &dataVector,
+      CDbEx &db, CNum numFiles);
   HRESULT ReadAndDecodePackedStreams(
       DECL_EXTERNAL_CODECS_LOC_VARS
       UInt64 baseOffset, UInt64 &dataOffset,
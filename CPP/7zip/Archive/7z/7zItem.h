@@ -34,6 +34,21 @@ struct CBond
 };
 
 
+/*
+  Restart point is a position in the folder, where the decoder can start
+  decoding without previous data: LZMA2 chunk with dictionary reset or
+  frame of zstdmt stream.
+  PackPos is offset in the pack stream, UnpackPos is offset in unpacked data of folder.
+  Restart points are supported only for folders with one coder and one pack stream.
+*/
+
+struct CRestartPoint
+{
+  UInt64 PackPos;
+  UInt64 UnpackPos;
+};
+
+
 struct CFolder
 {
   CLASS_NO_COPY(CFolder)
@@ -41,6 +56,7 @@ public:
   CObjArray2<CCoderInfo> Coders;
   CObjArray2<CBond> Bonds;
   CObjArray2<UInt32> PackStreams;
+  CRecordVector<CRestartPoint> RestartPoints;
 
   CFolder() {}
 
@@ -113,10 +113,35 @@ HRESULT COutArchive::Create(ISequentialOutStream *stream, bool endMarker)
   return S_OK;
 }
 
+/* Append mode: stream is the stream of archive that is updated.
+   New data is written after the end of archive, and the start header
+   is rewritten by WriteDatabase() after new header was written. */
+
+HRESULT COutArchive::Create_Append(ISequentialOutStream *stream, UInt64 arcStartPos, UInt64 arcEndPos)
+{
+  Close();
+  #ifdef _7Z_VOL
+  _endMarker = false;
+  #endif
+  SeqStream = stream;
+  SeqStream.QueryInterface(IID_IOutStream, &Stream);
+  if (!Stream)
+    return E_NOTIMPL;
+  UInt64 size;
+  RINOK(Stream->Seek(0, STREAM_SEEK_END, &size));
+  // we check that the stream is not some another (new) file
+  if (size != arcEndPos)
+    return E_NOTIMPL;
+  _prefixHeaderPos = arcStartPos + kSignatureSize + 2;
+  Stream.QueryInterface(IID_IOutStreamFlush, &_appendFlush);
+  return S_OK;
+}
+
 void COutArchive::Close()
 {
   SeqStream.Release();
   Stream.Release();
+  _appendFlush.Release();
 }
 
 HRESULT COutArchive::SkipPrefixArchiveHeader()
@@ -685,6 +710,64 @@ void COutArchive::WriteHeader(
     }
   }
 
+  {
+    /* ---------- Write Duplicates ---------- */
+    const unsigned numDefined = BoolVector_CountSum(db.DuplicateOf.Defs);
+    
+    if (numDefined != 0)
+    {
+      WriteAlignedBools(db.DuplicateOf.Defs, numDefined, NID::kDuplicateOf, 2);
+      FOR_VECTOR (i, db.DuplicateOf.Defs)
+      {
+        if (db.DuplicateOf.Defs[i])
+          WriteUInt32(db.DuplicateOf.Vals[i]);
+      }
+    }
+  }
+
+  {
+    /* ---------- Write Restart Points ---------- */
+    UInt64 dataSize = 0;
+    unsigned numPoints = 0;
+    FOR_VECTOR (i, db.Folders)
+    {
+      const CRecordVector<CRestartPoint> &points = db.Folders[i].RestartPoints;
+      dataSize += GetBigNumberSize(points.Size());
+      UInt64 packPos = 0;
+      UInt64 unpackPos = 0;
+      FOR_VECTOR (k, points)
+      {
+        const CRestartPoint &rp = points[k];
+        dataSize += GetBigNumberSize(rp.PackPos - packPos);
+        dataSize += GetBigNumberSize(rp.UnpackPos - unpackPos);
+        packPos = rp.PackPos;
+        unpackPos = rp.UnpackPos;
+      }
+      numPoints += points.Size();
+    }
+
+    if (numPoints != 0)
+    {
+      WriteID(NID::kRestartPoints);
+      WriteNumber(dataSize);
+      FOR_VECTOR (i, db.Folders)
+      {
+        const CRecordVector<CRestartPoint> &points = db.Folders[i].RestartPoints;
+        WriteNumber(points.Size());
+        UInt64 packPos = 0;
+        UInt64 unpackPos = 0;
+        FOR_VECTOR (k, points)
+        {
+          const CRestartPoint &rp = points[k];
+          WriteNumber(rp.PackPos - packPos);
+          WriteNumber(rp.UnpackPos - unpackPos);
+          packPos = rp.PackPos;
+          unpackPos = rp.UnpackPos;
+        }
+      }
+    }
+  }
+
   /*
   {
     // ---------- Write IsAux ----------
@@ -859,8 +942,18 @@ HRESULT COutArchive::WriteDatabase(
     h.NextHeaderSize = headerSize;
     h.NextHeaderCRC = headerCRC;
     h.NextHeaderOffset = headerOffset;
+    /* In append mode the old start header must stay valid until
+       the new data and the new header are on the storage.
+       So the new start header is written only after the flush. */
+    if (_appendFlush)
+    {
+      RINOK(_appendFlush->Flush());
+    }
     RINOK(Stream->Seek(_prefixHeaderPos, STREAM_SEEK_SET, NULL));
-    return WriteStartHeader(h);
+    RINOK(WriteStartHeader(h));
+    if (_appendFlush)
+      return _appendFlush->Flush();
+    return S_OK;
   }
 }
 
@@ -134,6 +134,7 @@ struct CArchiveDatabaseOut: public COutFolders
   CUInt64DefVector StartPos;
   CUInt32DefVector Attrib;
   CBoolVector IsAnti;
+  CUInt32DefVector DuplicateOf;
 
   /*
   CBoolVector IsAux;
@@ -166,6 +167,7 @@ struct CArchiveDatabaseOut: public COutFolders
     StartPos.Clear();
     Attrib.Clear();
     IsAnti.Clear();
+    DuplicateOf.Clear();
 
     /*
     IsAux.Clear();
@@ -189,6 +191,7 @@ struct CArchiveDatabaseOut: public COutFolders
     StartPos.ReserveDown();
     Attrib.ReserveDown();
     IsAnti.ReserveDown();
+    DuplicateOf.ReserveDown();
 
     /*
     IsAux.ReserveDown();
@@ -213,6 +216,7 @@ struct CArchiveDatabaseOut: public COutFolders
         && MTime.CheckSize(size)
         && StartPos.CheckSize(size)
         && Attrib.CheckSize(size)
+        && DuplicateOf.CheckSize(size)
         && (size == IsAnti.Size() || IsAnti.Size() == 0));
   }
 
@@ -310,11 +314,13 @@ class COutArchive
   HRESULT WriteFinishHeader(const CFinishHeader &h);
   #endif
   CMyComPtr<IOutStream> Stream;
+  CMyComPtr<IOutStreamFlush> _appendFlush;
 public:
 
   COutArchive() { _outByte.Create(1 << 16); }
   CMyComPtr<ISequentialOutStream> SeqStream;
   HRESULT Create(ISequentialOutStream *stream, bool endMarker);
+  HRESULT Create_Append(ISequentialOutStream *stream, UInt64 arcStartPos, UInt64 arcEndPos);
   void Close();
   HRESULT SkipPrefixArchiveHeader();
   HRESULT WriteDatabase(
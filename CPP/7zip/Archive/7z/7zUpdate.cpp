@@ -3,12 +3,15 @@
 #include "StdAfx.h"
 
 #include "../../../../C/CpuArch.h"
+#include "../../../../C/Sha256.h"
 
 #include "../../../Common/Wildcard.h"
 
 #include "../../Common/CreateCoder.h"
 #include "../../Common/LimitedStreams.h"
 #include "../../Common/ProgressUtils.h"
+#include "../../Common/StreamObjects.h"
+#include "../../Common/StreamUtils.h"
 
 #include "../../Compress/CopyCoder.h"
 
@@ -302,9 +305,10 @@ static Bool ParseFile(const Byte *buf, size_t size, CFilterMode *filterMode)
 struct CFilterMode2: public CFilterMode
 {
   bool Encrypted;
+  bool Store; // the data is probably incompressible, so it's stored with Copy method
   unsigned GroupIndex;
   
-  CFilterMode2(): Encrypted(false) {}
+  CFilterMode2(): Encrypted(false), Store(false) {}
 
   int Compare(const CFilterMode2 &m) const
   {
@@ -316,6 +320,14 @@ struct CFilterMode2: public CFilterMode
     else if (!m.Encrypted)
       return 1;
     
+    if (!Store)
+    {
+      if (m.Store)
+        return -1;
+    }
+    else if (!m.Store)
+      return 1;
+    
     if (Id < m.Id) return -1;
     if (Id > m.Id) return 1;
 
@@ -327,7 +339,7 @@ struct CFilterMode2: public CFilterMode
   
   bool operator ==(const CFilterMode2 &m) const
   {
-    return Id == m.Id && Delta == m.Delta && Encrypted == m.Encrypted;
+    return Id == m.Id && Delta == m.Delta && Encrypted == m.Encrypted && Store == m.Store;
   }
 };
 
@@ -381,14 +393,16 @@ static inline bool IsExeFilter(CMethodId m)
 }
 
 static unsigned Get_FilterGroup_for_Folder(
-    CRecordVector<CFilterMode2> &filters, const CFolderEx &f, bool extractFilter)
+    CRecordVector<CFilterMode2> &filters, const CFolderEx &f, bool extractFilter, bool extractStore)
 {
   CFilterMode2 m;
   m.Id = 0;
   m.Delta = 0;
   m.Encrypted = f.IsEncrypted();
 
-  if (extractFilter)
+  if (extractStore && f.Coders[f.UnpackCoder].MethodID == k_Copy)
+    m.Store = true;
+  else if (extractFilter)
   {
     const CCoderInfo &coder = f.Coders[f.UnpackCoder];
   
@@ -419,15 +433,9 @@ static HRESULT WriteRange(IInStream *inStream, ISequentialOutStream *outStream,
     UInt64 position, UInt64 size, ICompressProgressInfo *progress)
 {
   RINOK(inStream->Seek(position, STREAM_SEEK_SET, 0));
-  CLimitedSequentialInStream *streamSpec = new CLimitedSequentialInStream;
-  CMyComPtr<CLimitedSequentialInStream> inStreamLimited(streamSpec);
-  streamSpec->SetStream(inStream);
-  streamSpec->Init(size);
-
-  NCompress::CCopyCoder *copyCoderSpec = new NCompress::CCopyCoder;
-  CMyComPtr<ICompressCoder> copyCoder = copyCoderSpec;
-  RINOK(copyCoder->Code(inStreamLimited, outStream, NULL, NULL, progress));
-  return (copyCoderSpec->TotalSize == size ? S_OK : E_FAIL);
+  /* we pass (inStream) directly without limited stream wrapper,
+     so the copy coder can use in-kernel copy for file streams */
+  return NCompress::CopyStream_ExactSize(inStream, outStream, size, progress);
 }
 
 /*
@@ -801,17 +809,26 @@ struct CAnalysis
   CMyComPtr<IArchiveUpdateCallbackFile> Callback;
   CByteBuffer Buffer;
 
+  UInt32 BufIndex; // index of item whose first bytes are in Buffer
+  size_t BufSize;
+
   bool ParseWav;
   bool ParseExe;
   bool ParseAll;
 
   CAnalysis():
+      BufIndex((UInt32)(Int32)-1),
+      BufSize(0),
       ParseWav(true),
       ParseExe(false),
       ParseAll(false)
   {}
 
   HRESULT GetFilterGroup(UInt32 index, const CUpdateItem &ui, CFilterMode &filterMode);
+  HRESULT ReadFileStart(IArchiveUpdateCallbackFile *callback, UInt32 index);
+  HRESULT GetSketch(IArchiveUpdateCallbackFile *callback, UInt32 index, UInt32 *sketch);
+  HRESULT IsIncompressible(IArchiveUpdateCallbackFile *callback, UInt32 index,
+      UInt32 threshold, bool &incompressible);
 };
 
 static const size_t kAnalysisBufSize = 1 << 14;
@@ -884,6 +901,7 @@ HRESULT CAnalysis::GetFilterGroup(UInt32 index, const CUpdateItem &ui, CFilterMo
         Buffer.Alloc(kAnalysisBufSize);
       }
       {
+        BufIndex = (UInt32)(Int32)-1;
         CMyComPtr<ISequentialInStream> stream;
         HRESULT result = Callback->GetStream2(index, &stream, NUpdateNotifyOp::kAnalyze);
         if (result == S_OK && stream)
@@ -894,6 +912,8 @@ HRESULT CAnalysis::GetFilterGroup(UInt32 index, const CUpdateItem &ui, CFilterMo
           // RINOK(Callback->SetOperationResult2(index, NUpdate::NOperationResult::kOK));
           if (result == S_OK)
           {
+            BufIndex = index;
+            BufSize = size;
             Bool parseRes = ParseFile(Buffer, size, &filterModeTemp);
             if (parseRes && filterModeTemp.Delta == 0)
             {
@@ -928,6 +948,432 @@ HRESULT CAnalysis::GetFilterGroup(UInt32 index, const CUpdateItem &ui, CFilterMo
   return S_OK;
 }
 
+
+/*
+  Similarity sorting.
+  The sketch of file is bottom-k MinHash of 4-byte shingles from first bytes of file:
+  kSketchSize smallest different hashes of all shingles.
+  Files that have many common hashes in sketches probably have similar data,
+  so we place them near each other in solid block.
+*/
+
+static const unsigned kSketchSize = 16;
+static const UInt32 kSketchEmpty = 0xFFFFFFFF;
+static const UInt64 kSketchMinFileSize = 256;
+static const unsigned kSketchMinCommon = kSketchSize / 4;
+static const unsigned kSketchMaxCandidates = 64;
+static const unsigned kSketchMaxScan = 256;
+
+static void CalcSketch(const Byte *p, size_t size, UInt32 *sketch)
+{
+  unsigned num = 0;
+  if (size >= 4)
+  {
+    const Byte *lim = p + size - 3;
+    for (; p != lim; p++)
+    {
+      UInt32 h = GetUi32(p) * 0x9E3779B1;
+      h ^= h >> 15;
+      h *= 0x85EBCA6B;
+      h ^= h >> 13;
+      if (num == kSketchSize && h >= sketch[kSketchSize - 1])
+        continue;
+      if (h == kSketchEmpty)
+        continue;
+      unsigned k = num;
+      while (k != 0 && sketch[k - 1] > h)
+        k--;
+      if (k != 0 && sketch[k - 1] == h)
+        continue;
+      if (num != kSketchSize)
+        num++;
+      for (unsigned j = num - 1; j > k; j--)
+        sketch[j] = sketch[j - 1];
+      sketch[k] = h;
+    }
+  }
+  for (; num < kSketchSize; num++)
+    sketch[num] = kSketchEmpty;
+}
+
+HRESULT CAnalysis::ReadFileStart(IArchiveUpdateCallbackFile *callback, UInt32 index)
+{
+  if (BufIndex == index)
+    return S_OK; // the file was read already by GetFilterGroup() or by previous call
+  BufIndex = (UInt32)(Int32)-1;
+  if (Buffer.Size() != kAnalysisBufSize)
+    Buffer.Alloc(kAnalysisBufSize);
+  size_t size = 0;
+  CMyComPtr<ISequentialInStream> stream;
+  HRESULT result = callback->GetStream2(index, &stream, NUpdateNotifyOp::kAnalyze);
+  if (result == S_OK && stream)
+  {
+    size = kAnalysisBufSize;
+    result = ReadStream(stream, Buffer, &size);
+  }
+  if (result != S_OK)
+    size = 0;
+  BufIndex = index;
+  BufSize = size;
+  return S_OK;
+}
+
+HRESULT CAnalysis::GetSketch(IArchiveUpdateCallbackFile *callback, UInt32 index, UInt32 *sketch)
+{
+  RINOK(ReadFileStart(callback, index));
+  CalcSketch(Buffer, BufSize, sketch);
+  return S_OK;
+}
+
+
+/*
+  Incompressible data detection.
+  We calculate order-0 entropy of first bytes of file.
+  If entropy is not smaller than (threshold) percents of 8 bits per byte,
+  the data is probably compressed or encrypted already, and LZ compression can't reduce it.
+*/
+
+static const UInt64 kIncompressibleMinFileSize = 1 << 12;
+static const size_t kIncompressibleMinSample = 1 << 12;
+
+// returns (log2(v) * 256), v != 0
+
+static UInt32 GetLog2_x256(UInt32 v)
+{
+  unsigned i = 0;
+  while ((v >> i) > 1)
+    i++;
+  UInt32 res = (UInt32)i << 8;
+  // mantissa in [1, 2) range with 16 bits of fraction
+  UInt64 m = (i > 16) ? ((UInt64)v >> (i - 16)) : ((UInt64)v << (16 - i));
+  for (UInt32 bit = 1 << 7; bit != 0; bit >>= 1)
+  {
+    m = (m * m) >> 16;
+    if (m >= ((UInt64)2 << 16))
+    {
+      m >>= 1;
+      res |= bit;
+    }
+  }
+  return res;
+}
+
+HRESULT CAnalysis::IsIncompressible(IArchiveUpdateCallbackFile *callback, UInt32 index,
+    UInt32 threshold, bool &incompressible)
+{
+  incompressible = false;
+  RINOK(ReadFileStart(callback, index));
+  const size_t size = BufSize;
+  if (size < kIncompressibleMinSample)
+    return S_OK;
+
+  UInt32 freqs[256];
+  unsigned i;
+  for (i = 0; i < 256; i++)
+    freqs[i] = 0;
+  const Byte *p = Buffer;
+  for (size_t k = 0; k < size; k++)
+    freqs[p[k]]++;
+
+  UInt64 sum = 0;
+  for (i = 0; i < 256; i++)
+  {
+    const UInt32 freq = freqs[i];
+    if (freq != 0)
+      sum += (UInt64)freq * GetLog2_x256(freq);
+  }
+  
+  // entropy in (1/256) bits per byte
+  const UInt64 entropy = GetLog2_x256((UInt32)size) - sum / size;
+  incompressible = (entropy * 100 >= (UInt64)threshold * (8 << 8));
+  return S_OK;
+}
+
+struct CSketchRef
+{
+  UInt32 Val;
+  UInt32 Pos;
+};
+
+static int CompareSketchRefs(const CSketchRef *p1, const CSketchRef *p2, void * /* param */)
+{
+  RINOZ_COMP(p1->Val, p2->Val);
+  return MyCompare(p1->Pos, p2->Pos);
+}
+
+/*
+  Greedy chaining: after each file we place the most similar file that was not placed yet.
+  If there is no similar file, we continue from first unplaced file in original order.
+  So files without similar files keep the order of CompareUpdateItems().
+*/
+
+static void SortBySimilarity(CRecordVector<CRefItem> &refItems, const UInt32 *sketches)
+{
+  const unsigned num = refItems.Size();
+  if (num < 3)
+    return;
+
+  CRecordVector<CSketchRef> refs;
+  {
+    for (unsigned pos = 0; pos < num; pos++)
+    {
+      const UInt32 *sketch = sketches + (size_t)refItems[pos].Index * kSketchSize;
+      for (unsigned j = 0; j < kSketchSize && sketch[j] != kSketchEmpty; j++)
+      {
+        CSketchRef ref;
+        ref.Val = sketch[j];
+        ref.Pos = pos;
+        refs.Add(ref);
+      }
+    }
+  }
+  if (refs.IsEmpty())
+    return;
+  refs.Sort(CompareSketchRefs, NULL);
+
+  CBoolVector used;
+  used.ClearAndSetSize(num);
+  CRecordVector<UInt32> counts;
+  counts.ClearAndSetSize(num);
+  {
+    for (unsigned pos = 0; pos < num; pos++)
+    {
+      used[pos] = false;
+      counts[pos] = 0;
+    }
+  }
+
+  CUIntVector candidates;
+  CRecordVector<CRefItem> sorted;
+  sorted.ClearAndReserve(num);
+
+  unsigned next = 0;
+  unsigned cur = 0;
+  
+  for (;;)
+  {
+    used[cur] = true;
+    sorted.AddInReserved(refItems[cur]);
+    if (sorted.Size() == num)
+      break;
+
+    const UInt32 *sketch = sketches + (size_t)refItems[cur].Index * kSketchSize;
+    
+    for (unsigned j = 0; j < kSketchSize && sketch[j] != kSketchEmpty; j++)
+    {
+      const UInt32 val = sketch[j];
+      unsigned left = 0, right = refs.Size();
+      while (left != right)
+      {
+        const unsigned mid = (left + right) / 2;
+        if (refs[mid].Val < val)
+          left = mid + 1;
+        else
+          right = mid;
+      }
+      unsigned numCands = 0;
+      for (unsigned k = left; k < refs.Size() && k - left < kSketchMaxScan; k++)
+      {
+        const CSketchRef &ref = refs[k];
+        if (ref.Val != val)
+          break;
+        if (used[ref.Pos])
+          continue;
+        if (counts[ref.Pos]++ == 0)
+          candidates.Add(ref.Pos);
+        if (++numCands == kSketchMaxCandidates)
+          break;
+      }
+    }
+
+    int best = -1;
+    UInt32 bestCount = kSketchMinCommon - 1;
+    FOR_VECTOR (k, candidates)
+    {
+      const unsigned pos = candidates[k];
+      const UInt32 count = counts[pos];
+      counts[pos] = 0;
+      if (count > bestCount || (count == bestCount && best >= 0 && pos < (unsigned)best))
+      {
+        best = (int)pos;
+        bestCount = count;
+      }
+    }
+    candidates.Clear();
+
+    if (best >= 0)
+      cur = (unsigned)best;
+    else
+    {
+      while (used[next])
+        next++;
+      cur = next;
+    }
+  }
+
+  refItems = sorted;
+}
+
+
+/*
+  Search of new files with same data.
+  Only files of same size are read. Each such file is read once to get its
+  SHA-256 digest, and the files of same size and same digest are duplicates
+  of the first such file. The data is not compared byte by byte here:
+  the digest of each source file is calculated again by CFolderInStream, when
+  the file is read for compression. If the data of source file was changed,
+  its duplicates are compressed as normal files.
+  dupSources[i] is index of first update item with same data, or -1.
+*/
+
+static int CompareUpdateItemSizes(const unsigned *p1, const unsigned *p2, void *param)
+{
+  const CObjectVector<CUpdateItem> &updateItems = *(const CObjectVector<CUpdateItem> *)param;
+  RINOZ_COMP(updateItems[*p1].Size, updateItems[*p2].Size);
+  return MyCompare(*p1, *p2);
+}
+
+static const size_t kDedupBufSize = 1 << 16;
+static const unsigned kDedupDigestSize = SHA256_DIGEST_SIZE;
+
+static int CompareDigests(const unsigned *p1, const unsigned *p2, void *param)
+{
+  const Byte *digests = (const Byte *)param;
+  RINOZ(memcmp(digests + *p1 * kDedupDigestSize, digests + *p2 * kDedupDigestSize, kDedupDigestSize));
+  return MyCompare(*p1, *p2);
+}
+
+static HRESULT GetItemDigest(IArchiveUpdateCallbackFile *callback, UInt32 index, const CUpdateItem &ui,
+    Byte *buf, Byte *digest, bool &isOK)
+{
+  isOK = false;
+  CMyComPtr<ISequentialInStream> stream;
+  HRESULT result = callback->GetStream2(index, &stream, NUpdateNotifyOp::kAnalyze);
+  if (result != S_OK || !stream)
+    return S_OK;
+  
+  CSha256 sha;
+  Sha256_Init(&sha);
+  UInt64 size = 0;
+  
+  for (;;)
+  {
+    size_t processed = kDedupBufSize;
+    result = ReadStream(stream, buf, &processed);
+    if (result != S_OK)
+      return S_OK;
+    if (processed == 0)
+      break;
+    Sha256_Update(&sha, buf, processed);
+    size += processed;
+  }
+  
+  Sha256_Final(&sha, digest);
+  isOK = (size == ui.Size);
+  return S_OK;
+}
+
+static inline bool IsDupItem(const CIntVector &dupSources, unsigned index)
+{
+  return index < dupSources.Size() && dupSources[index] >= 0;
+}
+
+struct CSourceDigest
+{
+  UInt32 Index;
+  Byte Digest[kDedupDigestSize];
+};
+
+static int CompareSourceDigests(const CSourceDigest *p1, const CSourceDigest *p2, void * /* param */)
+{
+  return MyCompare(p1->Index, p2->Index);
+}
+
+static HRESULT FindDuplicates(IArchiveUpdateCallbackFile *callback,
+    const CObjectVector<CUpdateItem> &updateItems, CIntVector &dupSources,
+    CFileDigests &sourceDigests)
+{
+  CUIntVector refs;
+  FOR_VECTOR (i, updateItems)
+  {
+    const CUpdateItem &ui = updateItems[i];
+    if (ui.NewData && ui.HasStream())
+      refs.Add(i);
+  }
+  
+  refs.Sort(CompareUpdateItemSizes, (void *)&updateItems);
+
+  CByteBuffer buf(kDedupBufSize);
+  CByteBuffer digests;
+  CUIntVector sorted;   // indexes in (refs + i), sorted by digest
+  CRecordVector<CSourceDigest> sources;
+
+  for (unsigned i = 0; i < refs.Size();)
+  {
+    const UInt64 size = updateItems[refs[i]].Size;
+    unsigned num = 1;
+    while (i + num < refs.Size() && updateItems[refs[i + num]].Size == size)
+      num++;
+    
+    if (num > 1)
+    {
+      digests.Alloc(num * kDedupDigestSize);
+      sorted.Clear();
+      
+      for (unsigned k = 0; k < num; k++)
+      {
+        const UInt32 index = refs[i + k];
+        bool isOK;
+        RINOK(GetItemDigest(callback, index, updateItems[index], buf, digests + k * kDedupDigestSize, isOK));
+        if (isOK)
+          sorted.Add(k);
+      }
+      
+      sorted.Sort(CompareDigests, (void *)(const Byte *)digests);
+
+      for (unsigned k = 0; k < sorted.Size();)
+      {
+        const Byte *digest = digests + sorted[k] * kDedupDigestSize;
+        unsigned numSame = 1;
+        while (k + numSame < sorted.Size()
+            && memcmp(digests + sorted[k + numSame] * kDedupDigestSize, digest, kDedupDigestSize) == 0)
+          numSame++;
+
+        if (numSame > 1)
+        {
+          // the items are sorted by index here, so the first item is source for other items
+          const UInt32 sourceIndex = refs[i + sorted[k]];
+          for (unsigned m = 1; m < numSame; m++)
+            dupSources[refs[i + sorted[k + m]]] = (int)sourceIndex;
+          CSourceDigest sd;
+          sd.Index = sourceIndex;
+          memcpy(sd.Digest, digest, kDedupDigestSize);
+          sources.Add(sd);
+        }
+        
+        k += numSame;
+      }
+    }
+    
+    i += num;
+  }
+
+  sources.Sort(CompareSourceDigests, NULL);
+  
+  sourceDigests.Indexes.ClearAndSetSize(sources.Size());
+  sourceDigests.Digests.Alloc(sources.Size() * kDedupDigestSize);
+  sourceDigests.Changed.ClearAndSetSize(sources.Size());
+  FOR_VECTOR (k, sources)
+  {
+    sourceDigests.Indexes[k] = sources[k].Index;
+    memcpy(sourceDigests.Digests + k * kDedupDigestSize, sources[k].Digest, kDedupDigestSize);
+    sourceDigests.Changed[k] = false;
+  }
+  
+  return S_OK;
+}
+
+
 static inline void GetMethodFull(UInt64 methodID, UInt32 numStreams, CMethodFull &m)
 {
   m.Id = methodID;
@@ -1498,6 +1944,7 @@ void CThreadDecoder::Execute()
       
       // send_UnpackSize ? &UnpackSize : NULL,
       NULL, // unpackSize : FULL unpack
+      NULL, // restartPoint
       
       Fos,
       NULL, // compressProgress
@@ -1559,61 +2006,646 @@ static void GetFile(const CDatabase &inDb, unsigned index, CFileItem &file, CFil
   // file2.IsAux = inDb.IsItemAux(index);
 }
 
-HRESULT Update(
-    DECL_EXTERNAL_CODECS_LOC_VARS
-    IInStream *inStream,
+static void CopyFolder(CFolder &dest, const CFolder &src)
+{
+  unsigned i;
+  dest.Coders.SetSize(src.Coders.Size());
+  for (i = 0; i < src.Coders.Size(); i++)
+    dest.Coders[i] = src.Coders[i];
+  dest.Bonds.SetSize(src.Bonds.Size());
+  for (i = 0; i < src.Bonds.Size(); i++)
+    dest.Bonds[i] = src.Bonds[i];
+  dest.PackStreams.SetSize(src.PackStreams.Size());
+  for (i = 0; i < src.PackStreams.Size(); i++)
+    dest.PackStreams[i] = src.PackStreams[i];
+  dest.RestartPoints = src.RestartPoints;
+}
+
+static HRESULT AddFolderFiles(
     const CDbEx *db,
     const CObjectVector<CUpdateItem> &updateItems,
-    // const CObjectVector<CTreeFolder> &treeFolders,
-    // const CUniqBlocks &secureBlocks,
-    COutArchive &archive,
+    const UInt32 *indices,
+    unsigned numSubFiles,
+    const CFolderInStream &inStream,
     CArchiveDatabaseOut &newDatabase,
-    ISequentialOutStream *seqOutStream,
-    IArchiveUpdateCallback *updateCallback,
-    const CUpdateOptions &options
-    #ifndef _NO_CRYPTO
-    , ICryptoGetTextPassword *getDecoderPassword
-    #endif
-    )
+    int *updateIndexToNewIndex,
+    UInt64 &skippedSize)
 {
-  UInt64 numSolidFiles = options.NumSolidFiles;
-  if (numSolidFiles == 0)
-    numSolidFiles = 1;
+  CNum numUnpackStreams = 0;
+  skippedSize = 0;
+  
+  for (unsigned subIndex = 0; subIndex < numSubFiles; subIndex++)
+  {
+    const CUpdateItem &ui = updateItems[indices[subIndex]];
+    CFileItem file;
+    CFileItem2 file2;
+    UString name;
+    if (ui.NewProps)
+    {
+      UpdateItem_To_FileItem(ui, file, file2);
+      name = ui.Name;
+    }
+    else
+    {
+      GetFile(*db, ui.IndexInArchive, file, file2);
+      db->GetPath(ui.IndexInArchive, name);
+    }
+    if (file2.IsAnti || file.IsDir)
+      return E_FAIL;
+    
+    /*
+    CFileItem &file = newDatabase.Files[
+          startFileIndexInDatabase + i + subIndex];
+    */
+    if (!inStream.Processed[subIndex])
+    {
+      skippedSize += ui.Size;
+      continue;
+      // file.Name += ".locked";
+    }
 
-  CMyComPtr<IArchiveUpdateCallbackFile> opCallback;
-  updateCallback->QueryInterface(IID_IArchiveUpdateCallbackFile, (void **)&opCallback);
+    file.Crc = inStream.CRCs[subIndex];
+    file.Size = inStream.Sizes[subIndex];
+    
+    // if (file.Size >= 0) // test purposes
+    if (file.Size != 0)
+    {
+      file.CrcDefined = true;
+      file.HasStream = true;
+      numUnpackStreams++;
+    }
+    else
+    {
+      file.CrcDefined = false;
+      file.HasStream = false;
+    }
 
-  CMyComPtr<IArchiveExtractCallbackMessage> extractCallback;
-  updateCallback->QueryInterface(IID_IArchiveExtractCallbackMessage, (void **)&extractCallback);
+    /*
+    file.Parent = ui.ParentFolderIndex;
+    if (ui.TreeFolderIndex >= 0)
+      treeFolderToArcIndex[ui.TreeFolderIndex] = newDatabase.Files.Size();
+    if (totalSecureDataSize != 0)
+      newDatabase.SecureIDs.Add(ui.SecureIndex);
+    */
+    if (updateIndexToNewIndex)
+      updateIndexToNewIndex[indices[subIndex]] = (int)newDatabase.Files.Size();
+    newDatabase.AddFile(file, file2, name);
+  }
 
-  // size_t totalSecureDataSize = (size_t)secureBlocks.GetTotalSizeInBytes();
+  // numUnpackStreams = 0 is very bad case for locked files
+  // v3.13 doesn't understand it.
+  newDatabase.NumUnpackStreamsVector.Add(numUnpackStreams);
+  return S_OK;
+}
 
-  /*
-  CMyComPtr<IOutStream> outStream;
-  RINOK(seqOutStream->QueryInterface(IID_IOutStream, (void **)&outStream));
-  if (!outStream)
-    return E_NOTIMPL;
-  */
 
-  UInt64 startBlockSize = db ? db->ArcInfo.StartPosition: 0;
-  if (startBlockSize > 0 && !options.RemoveSfxBlock)
+static void AddCopiedFolder(const CDbEx *db, CNum folderIndex, CArchiveDatabaseOut &newDatabase)
+{
+  CFolder &folder = newDatabase.Folders.AddNew();
+  db->ParseFolderInfo(folderIndex, folder);
+  CNum startIndex = db->FoStartPackStreamIndex[folderIndex];
+  FOR_VECTOR(j, folder.PackStreams)
   {
-    RINOK(WriteRange(inStream, seqOutStream, 0, startBlockSize, NULL));
+    newDatabase.PackSizes.Add(db->GetStreamPackSize(startIndex + j));
+    // newDatabase.PackCRCsDefined.Add(db.PackCRCsDefined[startIndex + j]);
+    // newDatabase.PackCRCs.Add(db.PackCRCs[startIndex + j]);
   }
 
-  CIntArr fileIndexToUpdateIndexMap;
-  UInt64 complexity = 0;
-  UInt64 inSizeForReduce2 = 0;
-  bool needEncryptedRepack = false;
-
-  CRecordVector<CFilterMode2> filters;
-  CObjectVector<CSolidGroup> groups;
-  bool thereAreRepacks = false;
+  size_t indexStart = db->FoToCoderUnpackSizes[folderIndex];
+  size_t indexEnd = db->FoToCoderUnpackSizes[folderIndex + 1];
+  for (; indexStart < indexEnd; indexStart++)
+    newDatabase.CoderUnpackSizes.Add(db->CoderUnpackSizes[indexStart]);
+}
 
-  bool useFilters = options.UseFilters;
-  if (useFilters)
+static void AddCopiedFolderFiles(
+    const CDbEx *db,
+    CNum folderIndex,
+    const CObjectVector<CUpdateItem> &updateItems,
+    const int *fileIndexToUpdateIndexMap,
+    CArchiveDatabaseOut &newDatabase,
+    int *updateIndexToNewIndex)
+{
+  const CNum numUnpackStreams = db->NumUnpackStreamsVector[folderIndex];
+  CNum indexInFolder = 0;
+  for (CNum fi = db->FolderStartFileIndex[folderIndex]; indexInFolder < numUnpackStreams; fi++)
   {
-    const CCompressionMethodMode &method = *options.Method;
+    if (db->Files[fi].HasStream)
+    {
+      indexInFolder++;
+      int updateIndex = fileIndexToUpdateIndexMap[fi];
+      if (updateIndex >= 0)
+      {
+        const CUpdateItem &ui = updateItems[updateIndex];
+        if (ui.NewData)
+          continue;
+
+        UString name;
+        CFileItem file;
+        CFileItem2 file2;
+        GetFile(*db, fi, file, file2);
+
+        if (ui.NewProps)
+        {
+          UpdateItem_To_FileItem2(ui, file2);
+          file.IsDir = ui.IsDir;
+          name = ui.Name;
+        }
+        else if (ui.IndexInArchive != (int)fi)
+        {
+          // duplicate that took the place of its source file
+          CFileItem dupFile;
+          GetFile(*db, ui.IndexInArchive, dupFile, file2);
+          db->GetPath(ui.IndexInArchive, name);
+        }
+        else
+          db->GetPath(fi, name);
+
+        /*
+        file.Parent = ui.ParentFolderIndex;
+        if (ui.TreeFolderIndex >= 0)
+          treeFolderToArcIndex[ui.TreeFolderIndex] = newDatabase.Files.Size();
+        if (totalSecureDataSize != 0)
+          newDatabase.SecureIDs.Add(ui.SecureIndex);
+        */
+        if (updateIndexToNewIndex)
+          updateIndexToNewIndex[updateIndex] = (int)newDatabase.Files.Size();
+        newDatabase.AddFile(file, file2, name);
+      }
+    }
+  }
+}
+
+
+#ifndef _7ZIP_ST
+
+/*
+  Parallel compression of solid blocks.
+  The main thread reads the files of each solid block to memory and starts
+  a thread that compresses that block to memory. The blocks are appended
+  to archive in original order. All calls to updateCallback are protected
+  with CFolderThreads::CS, since callbacks are not thread-safe.
+*/
+
+class CFolderBufInStream:
+  public ISequentialInStream,
+  public ICompressGetSubStreamSize,
+  public CMyUnknownImp
+{
+  const Byte *_data;
+  size_t _size;
+  size_t _pos;
+  const CRecordVector<UInt64> *_sizes;
+public:
+  void Init(const Byte *data, size_t size, const CRecordVector<UInt64> *sizes)
+  {
+    _data = data;
+    _size = size;
+    _pos = 0;
+    _sizes = sizes;
+  }
+
+  MY_UNKNOWN_IMP2(ISequentialInStream, ICompressGetSubStreamSize)
+  STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(GetSubStreamSize)(UInt64 subStream, UInt64 *value);
+};
+
+STDMETHODIMP CFolderBufInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  size_t rem = _size - _pos;
+  if (rem > size)
+    rem = size;
+  if (rem != 0)
+    memcpy(data, _data + _pos, rem);
+  _pos += rem;
+  if (processedSize)
+    *processedSize = (UInt32)rem;
+  return S_OK;
+}
+
+STDMETHODIMP CFolderBufInStream::GetSubStreamSize(UInt64 subStream, UInt64 *value)
+{
+  *value = 0;
+  if (subStream >= _sizes->Size())
+    return S_FALSE;
+  *value = (*_sizes)[(unsigned)subStream];
+  return S_OK;
+}
+
+
+/*
+  Memory used by one CEncoder for (method). The estimates are the same
+  as in CCompressDialog::GetMemoryUsage(). Methods that have no estimate
+  there are counted as (kMemUsage_Default) per thread.
+*/
+
+static UInt64 GetMethodMemUsage(const CMethodFull &m)
+{
+  const UInt64 kMemUsage_Default = (UInt64)1 << 25;
+  const int level = m.GetLevel();
+  const int numThreadsProp = m.Get_NumThreads();
+  const UInt32 numThreads = (numThreadsProp < 1 ? 1 : (UInt32)numThreadsProp);
+
+  switch (m.Id)
+  {
+    case k_LZMA:
+    case k_LZMA2:
+    {
+      const UInt32 dict = m.Get_Lzma_DicSize();
+      UInt32 hs = dict - 1;
+      hs |= (hs >> 1);
+      hs |= (hs >> 2);
+      hs |= (hs >> 4);
+      hs |= (hs >> 8);
+      hs >>= 1;
+      hs |= 0xFFFF;
+      if (hs > (1 << 24))
+        hs >>= 1;
+      hs++;
+      UInt64 size1 = (UInt64)hs * 4;
+      size1 += (UInt64)dict * 4;
+      if (level >= 5)
+        size1 += (UInt64)dict * 4;
+      size1 += (2 << 20);
+
+      UInt32 numThreads1 = 1;
+      if (numThreads > 1 && level >= 5)
+      {
+        size1 += (2 << 20) + (4 << 20);
+        numThreads1 = 2;
+      }
+
+      const UInt32 numBlockThreads = (m.Id == k_LZMA ? 1 : numThreads / numThreads1);
+      if (numBlockThreads <= 1)
+        return size1 + (UInt64)dict * 3 / 2;
+      
+      UInt64 chunkSize = (UInt64)dict << 2;
+      chunkSize = MyMax(chunkSize, (UInt64)(1 << 20));
+      chunkSize = MyMin(chunkSize, (UInt64)(1 << 28));
+      chunkSize = MyMax(chunkSize, (UInt64)dict);
+      const UInt64 numPackChunks = numBlockThreads + (numBlockThreads / 4) + 2;
+      return numBlockThreads * (size1 + chunkSize) + numPackChunks * chunkSize;
+    }
+    case k_PPMD:
+      return (UInt64)m.Get_Ppmd_MemSize() + (2 << 20);
+    case k_Deflate:
+      return (level >= 7 ? (4 << 20) : (3 << 20));
+    case k_BZip2:
+      return (UInt64)(10 << 20) * numThreads;
+  }
+  
+  if (IsFilterMethod(m.Id))
+    return 0;
+  return kMemUsage_Default * numThreads;
+}
+
+static UInt64 GetEncoderMemUsage(const CCompressionMethodMode &method)
+{
+  UInt64 size = 0;
+  FOR_VECTOR (i, method.Methods)
+    size += GetMethodMemUsage(method.Methods[i]);
+  return size;
+}
+
+
+struct CFolderThreads;
+
+class CFolderThreadProgress:
+  public ICompressProgressInfo,
+  public CMyUnknownImp
+{
+public:
+  CFolderThreads *Threads;
+  UInt64 InSize;
+  UInt64 OutSize;
+
+  MY_UNKNOWN_IMP1(ICompressProgressInfo)
+  STDMETHOD(SetRatioInfo)(const UInt64 *inSize, const UInt64 *outSize);
+};
+
+
+class CFolderThread: public CVirtThread
+{
+public:
+  CEncoder *Encoder;
+  
+  CFolderInStream *InStreamSpec;
+  CMyComPtr<ISequentialInStream> InStream;
+  CDynBufSeqOutStream *InBufSpec;
+  CMyComPtr<ISequentialOutStream> InBuf;
+  CDynBufSeqOutStream *OutBufSpec;
+  CMyComPtr<ISequentialOutStream> OutBuf;
+  CFolderThreadProgress *ProgressSpec;
+  CMyComPtr<ICompressProgressInfo> Progress;
+  
+  unsigned StartIndex;
+  unsigned NumSubFiles;
+  UInt64 MemUsage;
+  UInt64 InSizeForReduce;
+
+  CFolder Folder;
+  CRecordVector<UInt64> CoderUnpackSizes;
+  CRecordVector<UInt64> PackSizes;
+  UInt64 UnpackSize;
+  HRESULT Result;
+
+  DECL_EXTERNAL_CODECS_LOC_VARS2;
+
+  CFolderThread(): Encoder(NULL)
+  {
+    InStreamSpec = new CFolderInStream;
+    InStream = InStreamSpec;
+    InBufSpec = new CDynBufSeqOutStream;
+    InBuf = InBufSpec;
+    OutBufSpec = new CDynBufSeqOutStream;
+    OutBuf = OutBufSpec;
+    ProgressSpec = new CFolderThreadProgress;
+    Progress = ProgressSpec;
+  }
+  ~CFolderThread()
+  {
+    CVirtThread::WaitThreadFinish();
+    delete Encoder;
+  }
+  virtual void Execute();
+};
+
+void CFolderThread::Execute()
+{
+  try
+  {
+    CFolderBufInStream *inStreamSpec = new CFolderBufInStream;
+    CMyComPtr<ISequentialInStream> inStream = inStreamSpec;
+    inStreamSpec->Init(InBufSpec->GetBuffer(), InBufSpec->GetSize(), &InStreamSpec->Sizes);
+    OutBufSpec->Init();
+    CoderUnpackSizes.Clear();
+    PackSizes.Clear();
+    UnpackSize = InBufSpec->GetSize();
+    
+    Result = Encoder->Encode(
+        EXTERNAL_CODECS_LOC_VARS
+        inStream,
+        &InSizeForReduce,
+        Folder, CoderUnpackSizes, UnpackSize,
+        OutBuf, PackSizes, Progress);
+  }
+  catch(...)
+  {
+    Result = E_FAIL;
+  }
+}
+
+
+struct CFolderThreads
+{
+  NWindows::NSynchronization::CCriticalSection CS;
+  
+  CLocalProgress *Lps;
+  IArchiveUpdateCallback *UpdateCallback;
+  ISequentialOutStream *OutStream;
+  const CDbEx *Db;
+  const CObjectVector<CUpdateItem> *UpdateItems;
+  CArchiveDatabaseOut *NewDatabase;
+  int *UpdateIndexToNewIndex;
+  CFileDigests *SourceDigests;
+  
+  // sizes reported by running threads
+  UInt64 InSize;
+  UInt64 OutSize;
+
+  unsigned First;
+  unsigned NumRunning;
+  UInt64 MemUsage;
+
+  CObjectVector<CFolderThread> Threads;
+
+  CFolderThreads(): UpdateIndexToNewIndex(NULL), SourceDigests(NULL), InSize(0), OutSize(0), First(0), NumRunning(0), MemUsage(0) {}
+
+  HRESULT Create(
+      DECL_EXTERNAL_CODECS_LOC_VARS
+      const CCompressionMethodMode &method, unsigned numThreads);
+  void Free();
+  void WaitAll();
+  bool IsFull(UInt64 memUsage, UInt64 maxMemUsage) const
+  {
+    return NumRunning == Threads.Size() || (NumRunning != 0 && MemUsage + memUsage > maxMemUsage);
+  }
+  HRESULT Start(unsigned startIndex, unsigned numSubFiles, UInt64 memUsage,
+      const UInt32 *indices, UInt64 inSizeForReduce);
+  HRESULT WriteFirst(const UInt32 *indices, UInt64 &complexity);
+};
+
+STDMETHODIMP CFolderThreadProgress::SetRatioInfo(const UInt64 *inSize, const UInt64 *outSize)
+{
+  NWindows::NSynchronization::CCriticalSectionLock lock(Threads->CS);
+  if (inSize)
+  {
+    Threads->InSize += *inSize - InSize;
+    InSize = *inSize;
+  }
+  if (outSize)
+  {
+    Threads->OutSize += *outSize - OutSize;
+    OutSize = *outSize;
+  }
+  return Threads->Lps->SetRatioInfo(&Threads->InSize, &Threads->OutSize);
+}
+
+HRESULT CFolderThreads::Create(
+    DECL_EXTERNAL_CODECS_LOC_VARS
+    const CCompressionMethodMode &method, unsigned numThreads)
+{
+  Free();
+  for (unsigned i = 0; i < numThreads; i++)
+  {
+    if (i == Threads.Size())
+      Threads.AddNew();
+    CFolderThread &t = Threads[i];
+    t.Encoder = new CEncoder(method);
+    t.ProgressSpec->Threads = this;
+    #ifdef EXTERNAL_CODECS
+    t.__externalCodecs = __externalCodecs;
+    #endif
+    RINOK(t.Create());
+  }
+  return S_OK;
+}
+
+void CFolderThreads::Free()
+{
+  WaitAll();
+  FOR_VECTOR (i, Threads)
+  {
+    CFolderThread &t = Threads[i];
+    delete t.Encoder;
+    t.Encoder = NULL;
+  }
+}
+
+void CFolderThreads::WaitAll()
+{
+  for (; NumRunning != 0; NumRunning--)
+  {
+    Threads[First].WaitExecuteFinish();
+    First = (First + 1) % Threads.Size();
+  }
+  MemUsage = 0;
+}
+
+// reads the files of solid block to memory and starts its compression
+
+HRESULT CFolderThreads::Start(unsigned startIndex, unsigned numSubFiles, UInt64 memUsage,
+    const UInt32 *indices, UInt64 inSizeForReduce)
+{
+  CFolderThread &t = Threads[(First + NumRunning) % Threads.Size()];
+  t.StartIndex = startIndex;
+  t.NumSubFiles = numSubFiles;
+  t.MemUsage = memUsage;
+  t.InSizeForReduce = inSizeForReduce;
+  t.ProgressSpec->InSize = 0;
+  t.ProgressSpec->OutSize = 0;
+  
+  t.InStreamSpec->Init(UpdateCallback, indices + startIndex, numSubFiles, SourceDigests);
+  t.InBufSpec->Init();
+  
+  const UInt32 kBufSize = (UInt32)1 << 20;
+  
+  for (;;)
+  {
+    Byte *buf = t.InBufSpec->GetBufPtrForWriting(kBufSize);
+    if (!buf)
+      return E_OUTOFMEMORY;
+    UInt32 processed;
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(CS);
+      RINOK(t.InStreamSpec->Read(buf, kBufSize, &processed));
+    }
+    if (processed == 0)
+      break;
+    t.InBufSpec->UpdateSize(processed);
+  }
+  
+  if (!t.InStreamSpec->WasFinished())
+    return E_FAIL;
+
+  NumRunning++;
+  MemUsage += memUsage;
+  t.Start();
+  return S_OK;
+}
+
+// waits for first running thread and writes its solid block to archive
+
+HRESULT CFolderThreads::WriteFirst(const UInt32 *indices, UInt64 &complexity)
+{
+  CFolderThread &t = Threads[First];
+  t.WaitExecuteFinish();
+  First = (First + 1) % Threads.Size();
+  NumRunning--;
+  MemUsage -= t.MemUsage;
+
+  // the buffers are not kept for next solid block, since only (t.MemUsage) was counted for them
+  t.InBufSpec->Free();
+  RINOK(t.Result);
+  HRESULT res = WriteStream(OutStream, t.OutBufSpec->GetBuffer(), t.OutBufSpec->GetSize());
+  t.OutBufSpec->Free();
+  RINOK(res);
+  
+  CopyFolder(NewDatabase->Folders.AddNew(), t.Folder);
+  NewDatabase->CoderUnpackSizes += t.CoderUnpackSizes;
+  NewDatabase->PackSizes += t.PackSizes;
+
+  UInt64 skippedSize;
+  RINOK(AddFolderFiles(Db, *UpdateItems, indices + t.StartIndex, t.NumSubFiles,
+      *t.InStreamSpec, *NewDatabase, UpdateIndexToNewIndex, skippedSize));
+
+  NWindows::NSynchronization::CCriticalSectionLock lock(CS);
+  
+  InSize -= t.ProgressSpec->InSize;
+  OutSize -= t.ProgressSpec->OutSize;
+  Lps->InSize += t.UnpackSize;
+  FOR_VECTOR (i, t.PackSizes)
+    Lps->OutSize += t.PackSizes[i];
+  
+  if (skippedSize != 0 && complexity >= skippedSize)
+  {
+    complexity -= skippedSize;
+    RINOK(UpdateCallback->SetTotal(complexity));
+  }
+  
+  return Lps->SetRatioInfo(&InSize, &OutSize);
+}
+
+#endif
+
+
+HRESULT Update(
+    DECL_EXTERNAL_CODECS_LOC_VARS
+    IInStream *inStream,
+    const CDbEx *db,
+    const CObjectVector<CUpdateItem> &updateItems,
+    // const CObjectVector<CTreeFolder> &treeFolders,
+    // const CUniqBlocks &secureBlocks,
+    COutArchive &archive,
+    CArchiveDatabaseOut &newDatabase,
+    ISequentialOutStream *seqOutStream,
+    IArchiveUpdateCallback *updateCallback,
+    const CUpdateOptions &options
+    #ifndef _NO_CRYPTO
+    , ICryptoGetTextPassword *getDecoderPassword
+    #endif
+    )
+{
+  UInt64 numSolidFiles = options.NumSolidFiles;
+  if (numSolidFiles == 0)
+    numSolidFiles = 1;
+
+  CMyComPtr<IArchiveUpdateCallbackFile> opCallback;
+  updateCallback->QueryInterface(IID_IArchiveUpdateCallbackFile, (void **)&opCallback);
+
+  CMyComPtr<IArchiveExtractCallbackMessage> extractCallback;
+  updateCallback->QueryInterface(IID_IArchiveExtractCallbackMessage, (void **)&extractCallback);
+
+  // size_t totalSecureDataSize = (size_t)secureBlocks.GetTotalSizeInBytes();
+
+  /*
+  CMyComPtr<IOutStream> outStream;
+  RINOK(seqOutStream->QueryInterface(IID_IOutStream, (void **)&outStream));
+  if (!outStream)
+    return E_NOTIMPL;
+  */
+
+  /* In append mode seqOutStream is the stream of the archive that is updated.
+     Old solid blocks stay in place, new solid blocks and new header are written
+     after the end of archive, and start header is rewritten at the end. */
+  const bool appendMode = (options.AppendMode && db);
+  if (appendMode)
+  {
+    /* E_NOTIMPL is returned before any write to the stream.
+       Then the caller can update the archive in usual way. */
+    if (db->NumPackStreams != 0 && db->ArcInfo.DataStartPosition != db->ArcInfo.StartPositionAfterHeader)
+      return E_NOTIMPL;
+  }
+
+  UInt64 startBlockSize = db ? db->ArcInfo.StartPosition: 0;
+  if (startBlockSize > 0 && !options.RemoveSfxBlock && !appendMode)
+  {
+    RINOK(WriteRange(inStream, seqOutStream, 0, startBlockSize, NULL));
+  }
+
+  CIntArr fileIndexToUpdateIndexMap;
+  UInt64 complexity = 0;
+  UInt64 inSizeForReduce2 = 0;
+  bool needEncryptedRepack = false;
+
+  CRecordVector<CFilterMode2> filters;
+  CObjectVector<CSolidGroup> groups;
+  bool thereAreRepacks = false;
+  CBoolVector keptFolders; // in append mode: folders that are not changed
+
+  bool useFilters = options.UseFilters;
+  if (useFilters)
+  {
+    const CCompressionMethodMode &method = *options.Method;
 
     FOR_VECTOR (i, method.Methods)
       if (IsFilterMethod(method.Methods[i].Id))
@@ -1631,6 +2663,9 @@ HRESULT Update(
     for (i = 0; i < db->Files.Size(); i++)
       fileIndexToUpdateIndexMap[i] = -1;
 
+    if (appendMode)
+      keptFolders.ClearAndSetSize(db->NumFolders);
+
     for (i = 0; i < updateItems.Size(); i++)
     {
       int index = updateItems[i].IndexInArchive;
@@ -1638,6 +2673,22 @@ HRESULT Update(
         fileIndexToUpdateIndexMap[(unsigned)index] = i;
     }
 
+    /* If the source file of kept duplicate is deleted or changed, the first such
+       duplicate takes the place of source file in old solid block. So it's
+       stored as normal file, and other duplicates refer to it. */
+    if (!db->DuplicateOf.Defs.IsEmpty())
+      for (i = 0; i < updateItems.Size(); i++)
+      {
+        const CUpdateItem &ui = updateItems[i];
+        UInt32 source;
+        if (ui.NewData || ui.IndexInArchive == -1
+            || !db->DuplicateOf.GetItem(ui.IndexInArchive, source))
+          continue;
+        const int sourceUpdateIndex = fileIndexToUpdateIndexMap[source];
+        if (sourceUpdateIndex < 0 || updateItems[sourceUpdateIndex].NewData)
+          fileIndexToUpdateIndexMap[source] = i;
+      }
+
     for (i = 0; i < db->NumFolders; i++)
     {
       CNum indexInFolder = 0;
@@ -1660,9 +2711,18 @@ HRESULT Update(
         }
       }
 
+      if (appendMode)
+        keptFolders[i] = false;
+
       if (numCopyItems == 0)
         continue;
 
+      if (appendMode && numCopyItems == numUnpackStreams)
+      {
+        keptFolders[i] = true;
+        continue;
+      }
+
       CFolderRepack rep;
       rep.FolderIndex = i;
       rep.NumCopyFiles = numCopyItems;
@@ -1673,7 +2733,7 @@ HRESULT Update(
       const bool needCopy = (numCopyItems == numUnpackStreams);
       const bool extractFilter = (useFilters || needCopy);
 
-      unsigned groupIndex = Get_FilterGroup_for_Folder(filters, f, extractFilter);
+      unsigned groupIndex = Get_FilterGroup_for_Folder(filters, f, extractFilter, options.IncompressibleThreshold != 0);
       
       while (groupIndex >= groups.Size())
         groups.AddNew();
@@ -1694,12 +2754,63 @@ HRESULT Update(
     }
   }
 
+  // ---------- Find duplicates ----------
+
+  CIntVector dupSources; // update index of file with same data, or -1
+  CFileDigests sourceDigests;
+  CIntVector updateIndexToNewIndex;
+  {
+    const bool oldDups = (db && !db->DuplicateOf.Defs.IsEmpty());
+    
+    if ((options.Dedup && opCallback) || oldDups)
+    {
+      unsigned i;
+      dupSources.ClearAndSetSize(updateItems.Size());
+      for (i = 0; i < updateItems.Size(); i++)
+        dupSources[i] = -1;
+      
+      if (options.Dedup && opCallback)
+      {
+        RINOK(FindDuplicates(opCallback, updateItems, dupSources, sourceDigests));
+      }
+
+      if (oldDups)
+      {
+        for (i = 0; i < updateItems.Size(); i++)
+        {
+          const CUpdateItem &ui = updateItems[i];
+          UInt32 source;
+          if (ui.NewData || ui.IndexInArchive == -1
+              || !db->DuplicateOf.GetItem(ui.IndexInArchive, source))
+            continue;
+          const int sourceUpdateIndex = fileIndexToUpdateIndexMap[source];
+          if (sourceUpdateIndex == (int)i)
+            continue; // it took the place of source file
+          dupSources[i] = sourceUpdateIndex;
+        }
+      }
+
+      for (i = 0; i < updateItems.Size(); i++)
+        if (dupSources[i] >= 0)
+          break;
+      
+      if (i == updateItems.Size())
+        dupSources.Clear();
+      else
+      {
+        updateIndexToNewIndex.ClearAndSetSize(updateItems.Size());
+        for (i = 0; i < updateItems.Size(); i++)
+          updateIndexToNewIndex[i] = -1;
+      }
+    }
+  }
+
   UInt64 inSizeForReduce = 0;
   {
     FOR_VECTOR (i, updateItems)
     {
       const CUpdateItem &ui = updateItems[i];
-      if (ui.NewData)
+      if (ui.NewData && !IsDupItem(dupSources, i))
       {
         complexity += ui.Size;
         if (numSolidFiles != 1)
@@ -1719,6 +2830,18 @@ HRESULT Update(
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(updateCallback, true);
 
+  #ifndef _7ZIP_ST
+  CFolderThreads folderThreads;
+  folderThreads.Lps = lps;
+  folderThreads.UpdateCallback = updateCallback;
+  folderThreads.Db = db;
+  folderThreads.UpdateItems = &updateItems;
+  folderThreads.NewDatabase = &newDatabase;
+  folderThreads.SourceDigests = &sourceDigests;
+  if (!updateIndexToNewIndex.IsEmpty())
+    folderThreads.UpdateIndexToNewIndex = &updateIndexToNewIndex[0];
+  #endif
+
   #ifndef _7ZIP_ST
   
   CStreamBinder sb;
@@ -1741,6 +2864,15 @@ HRESULT Update(
   }
   #endif
 
+  // sketches of files for similarity sorting: kSketchSize values for each update item
+  CRecordVector<UInt32> sketches;
+  if (options.UseSimilaritySorting && opCallback && numSolidFiles > 1 && !options.SolidExtension)
+  {
+    sketches.ClearAndSetSize(updateItems.Size() * kSketchSize);
+    FOR_VECTOR (i, sketches)
+      sketches[i] = kSketchEmpty;
+  }
+
   {
     CAnalysis analysis;
     if (options.AnalysisLevel == 0)
@@ -1771,7 +2903,7 @@ HRESULT Update(
     FOR_VECTOR (i, updateItems)
     {
       const CUpdateItem &ui = updateItems[i];
-      if (!ui.NewData || !ui.HasStream())
+      if (!ui.NewData || !ui.HasStream() || IsDupItem(dupSources, i))
         continue;
 
       CFilterMode2 fm;
@@ -1779,6 +2911,21 @@ HRESULT Update(
       {
         RINOK(analysis.GetFilterGroup(i, ui, fm));
       }
+      if (!sketches.IsEmpty() && ui.Size >= kSketchMinFileSize)
+      {
+        RINOK(analysis.GetSketch(opCallback, i, &sketches[i * kSketchSize]));
+      }
+      if (options.IncompressibleThreshold != 0 && opCallback && ui.Size >= kIncompressibleMinFileSize)
+      {
+        bool incompressible;
+        RINOK(analysis.IsIncompressible(opCallback, i, options.IncompressibleThreshold, incompressible));
+        if (incompressible)
+        {
+          fm.Id = 0;
+          fm.Delta = 0;
+          fm.Store = true;
+        }
+      }
       fm.Encrypted = method.PasswordIsDefined;
 
       unsigned groupIndex = GetGroup(filters, fm);
@@ -1820,8 +2967,21 @@ HRESULT Update(
   
   // ---------- Compress ----------
 
-  RINOK(archive.Create(seqOutStream, false));
-  RINOK(archive.SkipPrefixArchiveHeader());
+  if (appendMode)
+  {
+    RINOK(archive.Create_Append(seqOutStream,
+        db->ArcInfo.StartPosition, db->ArcInfo.StartPosition + db->PhySize));
+  }
+  else
+  {
+    RINOK(archive.Create(seqOutStream, false));
+    RINOK(archive.SkipPrefixArchiveHeader());
+  }
+
+  #ifndef _7ZIP_ST
+  // archive.SeqStream is set by archive.Create()
+  folderThreads.OutStream = archive.SeqStream;
+  #endif
 
   /*
   CIntVector treeFolderToArcIndex;
@@ -1877,13 +3037,22 @@ HRESULT Update(
     for (i = 0; i < updateItems.Size(); i++)
     {
       const CUpdateItem &ui = updateItems[i];
+      if (IsDupItem(dupSources, i))
+        continue;
       if (ui.NewData)
       {
         if (ui.HasStream())
           continue;
       }
-      else if (ui.IndexInArchive != -1 && db->Files[ui.IndexInArchive].HasStream)
-        continue;
+      else if (ui.IndexInArchive != -1)
+      {
+        if (db->Files[ui.IndexInArchive].HasStream)
+          continue;
+        UInt32 source;
+        if (db->DuplicateOf.GetItem(ui.IndexInArchive, source)
+            && fileIndexToUpdateIndexMap[source] == (int)i)
+          continue; // duplicate that took the place of its source file
+      }
       /*
       if (ui.TreeFolderIndex >= 0)
         continue;
@@ -1920,6 +3089,53 @@ HRESULT Update(
     }
   }
 
+  if (appendMode)
+  {
+    /* ---------- Keep old solid blocks in place ----------
+       Pack streams of new archive must follow the old ones without gaps.
+       So changed and deleted old folders are kept as folders without files,
+       and old headers are kept as data of additional folder without files.
+       Files of changed folders are repacked to new folders. */
+    
+    for (CNum i = 0; i < db->NumFolders; i++)
+    {
+      AddCopiedFolder(db, i, newDatabase);
+      if (keptFolders[i])
+      {
+        newDatabase.NumUnpackStreamsVector.Add(db->NumUnpackStreamsVector[i]);
+        AddCopiedFolderFiles(db, i, updateItems, fileIndexToUpdateIndexMap, newDatabase,
+            updateIndexToNewIndex.IsEmpty() ? NULL : &updateIndexToNewIndex[0]);
+      }
+      else
+      {
+        newDatabase.Folders.Back().RestartPoints.Clear();
+        newDatabase.NumUnpackStreamsVector.Add(0);
+      }
+    }
+
+    UInt64 dataEnd = db->ArcInfo.StartPositionAfterHeader;
+    if (db->NumPackStreams != 0)
+      dataEnd += db->PackPositions[db->NumPackStreams];
+    const UInt64 arcEnd = db->ArcInfo.StartPosition + db->PhySize;
+    if (arcEnd < dataEnd)
+      return E_FAIL;
+    
+    if (arcEnd != dataEnd)
+    {
+      const UInt64 size = arcEnd - dataEnd;
+      CFolder &folder = newDatabase.Folders.AddNew();
+      folder.Coders.SetSize(1);
+      CCoderInfo &coder = folder.Coders[0];
+      coder.MethodID = k_Copy;
+      coder.NumStreams = 1;
+      folder.PackStreams.SetSize(1);
+      folder.PackStreams[0] = 0;
+      newDatabase.PackSizes.Add(size);
+      newDatabase.CoderUnpackSizes.Add(size);
+      newDatabase.NumUnpackStreamsVector.Add(0);
+    }
+  }
+
   lps->ProgressOffset = 0;
 
   {
@@ -1937,6 +3153,16 @@ HRESULT Update(
     const CFilterMode2 &filterMode = filters[groupIndex];
 
     CCompressionMethodMode method = *options.Method;
+    if (filterMode.Store)
+    {
+      method.Methods.Clear();
+      method.Bonds.Clear();
+      method.Filter_was_Inserted = false;
+      CMethodFull &m = method.Methods.AddNew();
+      m.Id = k_Copy;
+      m.NumStreams = 1;
+    }
+    else
     {
       HRESULT res = MakeExeMethod(method, filterMode,
         #ifdef _7ZIP_ST
@@ -2009,20 +3235,7 @@ HRESULT Update(
             db->GetFolderStreamPos(folderIndex, 0), packSize, progress));
         lps->ProgressOffset += packSize;
         
-        CFolder &folder = newDatabase.Folders.AddNew();
-        db->ParseFolderInfo(folderIndex, folder);
-        CNum startIndex = db->FoStartPackStreamIndex[folderIndex];
-        FOR_VECTOR(j, folder.PackStreams)
-        {
-          newDatabase.PackSizes.Add(db->GetStreamPackSize(startIndex + j));
-          // newDatabase.PackCRCsDefined.Add(db.PackCRCsDefined[startIndex + j]);
-          // newDatabase.PackCRCs.Add(db.PackCRCs[startIndex + j]);
-        }
-
-        size_t indexStart = db->FoToCoderUnpackSizes[folderIndex];
-        size_t indexEnd = db->FoToCoderUnpackSizes[folderIndex + 1];
-        for (; indexStart < indexEnd; indexStart++)
-          newDatabase.CoderUnpackSizes.Add(db->CoderUnpackSizes[indexStart]);
+        AddCopiedFolder(db, folderIndex, newDatabase);
       }
       else
       {
@@ -2131,6 +3344,7 @@ HRESULT Update(
                   *db, folderIndex,
                   // &importantUnpackSize, // *unpackSize
                   NULL, // *unpackSize : FULL unpack
+                  NULL, // restartPoint
                 
                   NULL, // *outStream
                   NULL, // *compressProgress
@@ -2245,44 +3459,8 @@ HRESULT Update(
       
       newDatabase.NumUnpackStreamsVector.Add(rep.NumCopyFiles);
       
-      CNum indexInFolder = 0;
-      for (CNum fi = db->FolderStartFileIndex[folderIndex]; indexInFolder < numUnpackStreams; fi++)
-      {
-        if (db->Files[fi].HasStream)
-        {
-          indexInFolder++;
-          int updateIndex = fileIndexToUpdateIndexMap[fi];
-          if (updateIndex >= 0)
-          {
-            const CUpdateItem &ui = updateItems[updateIndex];
-            if (ui.NewData)
-              continue;
-
-            UString name;
-            CFileItem file;
-            CFileItem2 file2;
-            GetFile(*db, fi, file, file2);
-
-            if (ui.NewProps)
-            {
-              UpdateItem_To_FileItem2(ui, file2);
-              file.IsDir = ui.IsDir;
-              name = ui.Name;
-            }
-            else
-              db->GetPath(fi, name);
-
-            /*
-            file.Parent = ui.ParentFolderIndex;
-            if (ui.TreeFolderIndex >= 0)
-              treeFolderToArcIndex[ui.TreeFolderIndex] = newDatabase.Files.Size();
-            if (totalSecureDataSize != 0)
-              newDatabase.SecureIDs.Add(ui.SecureIndex);
-            */
-            newDatabase.AddFile(file, file2, name);
-          }
-        }
-      }
+      AddCopiedFolderFiles(db, folderIndex, updateItems, fileIndexToUpdateIndexMap, newDatabase,
+          updateIndexToNewIndex.IsEmpty() ? NULL : &updateIndexToNewIndex[0]);
     }
 
 
@@ -2304,6 +3482,8 @@ HRESULT Update(
     // sortParam.TreeFolders = &treeFolders;
     sortParam.SortByType = sortByType;
     refItems.Sort(CompareUpdateItems, (void *)&sortParam);
+    if (!sketches.IsEmpty())
+      SortBySimilarity(refItems, &sketches[0]);
     
     CObjArray<UInt32> indices(numFiles);
 
@@ -2324,6 +3504,26 @@ HRESULT Update(
       */
     }
     
+    #ifndef _7ZIP_ST
+    UInt32 numFolderThreads = options.NumFolderThreads;
+    UInt64 folderThreadsMemory = options.FolderThreadsMemory;
+    if (numFolderThreads > 1)
+    {
+      /* each thread keeps the memory of its encoder after first block.
+         So we reserve that memory for all threads, and the rest of budget
+         is used for buffers of solid blocks. */
+      const UInt64 encoderMemUsage = GetEncoderMemUsage(method);
+      while (numFolderThreads > 1 && encoderMemUsage * numFolderThreads > folderThreadsMemory / 2)
+        numFolderThreads--;
+      folderThreadsMemory -= encoderMemUsage * numFolderThreads;
+    }
+    const bool useFolderThreads = (numFolderThreads > 1);
+    if (useFolderThreads)
+    {
+      RINOK(folderThreads.Create(EXTERNAL_CODECS_LOC_VARS method, numFolderThreads));
+    }
+    #endif
+
     for (i = 0; i < numFiles;)
     {
       UInt64 totalSize = 0;
@@ -2352,11 +3552,39 @@ HRESULT Update(
       if (numSubFiles < 1)
         numSubFiles = 1;
 
+      #ifndef _7ZIP_ST
+      if (useFolderThreads)
+      {
+        /* we need memory for input data and for compressed data of solid block.
+           CDynBufSeqOutStream grows its buffer by 1/4, and input buffer has additional 1 MB for reading */
+        const UInt64 memUsage = totalSize / 2 * 5 + ((UInt64)1 << 21);
+        if (memUsage <= folderThreadsMemory)
+        {
+          while (folderThreads.IsFull(memUsage, folderThreadsMemory))
+          {
+            RINOK(folderThreads.WriteFirst(indices, complexity));
+          }
+          {
+            NWindows::NSynchronization::CCriticalSectionLock lock(folderThreads.CS);
+            RINOK(lps->SetCur());
+          }
+          RINOK(folderThreads.Start(i, numSubFiles, memUsage, indices, inSizeForReduce));
+          i += numSubFiles;
+          continue;
+        }
+        // big solid block is compressed directly to archive after previous blocks
+        while (folderThreads.NumRunning != 0)
+        {
+          RINOK(folderThreads.WriteFirst(indices, complexity));
+        }
+      }
+      #endif
+
       RINOK(lps->SetCur());
 
       CFolderInStream *inStreamSpec = new CFolderInStream;
       CMyComPtr<ISequentialInStream> solidInStream(inStreamSpec);
-      inStreamSpec->Init(updateCallback, &indices[i], numSubFiles);
+      inStreamSpec->Init(updateCallback, &indices[i], numSubFiles, &sourceDigests);
       
       unsigned startPackIndex = newDatabase.PackSizes.Size();
       UInt64 curFolderUnpackSize = totalSize;
@@ -2381,68 +3609,12 @@ HRESULT Update(
       // newDatabase.PackCRCsDefined.Add(false);
       // newDatabase.PackCRCs.Add(0);
 
-      CNum numUnpackStreams = 0;
-      UInt64 skippedSize = 0;
-      
-      for (unsigned subIndex = 0; subIndex < numSubFiles; subIndex++)
-      {
-        const CUpdateItem &ui = updateItems[indices[i + subIndex]];
-        CFileItem file;
-        CFileItem2 file2;
-        UString name;
-        if (ui.NewProps)
-        {
-          UpdateItem_To_FileItem(ui, file, file2);
-          name = ui.Name;
-        }
-        else
-        {
-          GetFile(*db, ui.IndexInArchive, file, file2);
-          db->GetPath(ui.IndexInArchive, name);
-        }
-        if (file2.IsAnti || file.IsDir)
-          return E_FAIL;
-        
-        /*
-        CFileItem &file = newDatabase.Files[
-              startFileIndexInDatabase + i + subIndex];
-        */
-        if (!inStreamSpec->Processed[subIndex])
-        {
-          skippedSize += ui.Size;
-          continue;
-          // file.Name += ".locked";
-        }
-
-        file.Crc = inStreamSpec->CRCs[subIndex];
-        file.Size = inStreamSpec->Sizes[subIndex];
-        
-        // if (file.Size >= 0) // test purposes
-        if (file.Size != 0)
-        {
-          file.CrcDefined = true;
-          file.HasStream = true;
-          numUnpackStreams++;
-        }
-        else
-        {
-          file.CrcDefined = false;
-          file.HasStream = false;
-        }
+      UInt64 skippedSize;
+      RINOK(AddFolderFiles(db, updateItems, &indices[i], numSubFiles,
+          *inStreamSpec, newDatabase,
+          updateIndexToNewIndex.IsEmpty() ? NULL : &updateIndexToNewIndex[0],
+          skippedSize));
 
-        /*
-        file.Parent = ui.ParentFolderIndex;
-        if (ui.TreeFolderIndex >= 0)
-          treeFolderToArcIndex[ui.TreeFolderIndex] = newDatabase.Files.Size();
-        if (totalSecureDataSize != 0)
-          newDatabase.SecureIDs.Add(ui.SecureIndex);
-        */
-        newDatabase.AddFile(file, file2, name);
-      }
-
-      // numUnpackStreams = 0 is very bad case for locked files
-      // v3.13 doesn't understand it.
-      newDatabase.NumUnpackStreamsVector.Add(numUnpackStreams);
       i += numSubFiles;
 
       if (skippedSize != 0 && complexity >= skippedSize)
@@ -2451,6 +3623,117 @@ HRESULT Update(
         RINOK(updateCallback->SetTotal(complexity));
       }
     }
+
+    #ifndef _7ZIP_ST
+    if (useFolderThreads)
+    {
+      while (folderThreads.NumRunning != 0)
+      {
+        RINOK(folderThreads.WriteFirst(indices, complexity));
+      }
+      folderThreads.Free();
+    }
+    #endif
+  }
+
+  if (!dupSources.IsEmpty())
+  {
+    /* ---------- Write new duplicates of skipped files ----------
+       if the source file was skipped or changed, its duplicates are compressed as normal files */
+
+    CRecordVector<UInt32> orphans;
+    UInt64 orphansSize = 0;
+    
+    FOR_VECTOR (i, updateItems)
+    {
+      const int source = dupSources[i];
+      if (source < 0 || !updateItems[i].NewData)
+        continue;
+      const int digestIndex = sourceDigests.Indexes.FindInSorted((UInt32)source);
+      if (updateIndexToNewIndex[source] < 0
+          || (digestIndex >= 0 && sourceDigests.Changed[(unsigned)digestIndex]))
+      {
+        dupSources[i] = -1;
+        orphans.Add(i);
+        orphansSize += updateItems[i].Size;
+      }
+    }
+
+    if (!orphans.IsEmpty())
+    {
+      complexity += orphansSize;
+      RINOK(updateCallback->SetTotal(complexity));
+      RINOK(lps->SetCur());
+
+      CEncoder encoder(*options.Method);
+      CFolderInStream *inStreamSpec = new CFolderInStream;
+      CMyComPtr<ISequentialInStream> solidInStream(inStreamSpec);
+      inStreamSpec->Init(updateCallback, &orphans[0], orphans.Size());
+      
+      unsigned startPackIndex = newDatabase.PackSizes.Size();
+      UInt64 curFolderUnpackSize = orphansSize;
+      
+      RINOK(encoder.Encode(
+          EXTERNAL_CODECS_LOC_VARS
+          solidInStream,
+          &orphansSize,
+          newDatabase.Folders.AddNew(), newDatabase.CoderUnpackSizes, curFolderUnpackSize,
+          archive.SeqStream, newDatabase.PackSizes, progress));
+
+      if (!inStreamSpec->WasFinished())
+        return E_FAIL;
+
+      for (; startPackIndex < newDatabase.PackSizes.Size(); startPackIndex++)
+        lps->OutSize += newDatabase.PackSizes[startPackIndex];
+
+      lps->InSize += curFolderUnpackSize;
+
+      UInt64 skippedSize;
+      RINOK(AddFolderFiles(db, updateItems, &orphans[0], orphans.Size(),
+          *inStreamSpec, newDatabase, &updateIndexToNewIndex[0], skippedSize));
+    }
+
+    /* ---------- Write duplicates ----------
+       duplicate is stored as empty file that refers to file with same data */
+    
+    FOR_VECTOR (i, updateItems)
+    {
+      const int source = dupSources[i];
+      if (source < 0)
+        continue;
+      const int sourceIndex = updateIndexToNewIndex[source];
+      if (sourceIndex < 0)
+        return E_FAIL;
+      
+      const CUpdateItem &ui = updateItems[i];
+      CFileItem file;
+      CFileItem2 file2;
+      UString name;
+      if (ui.NewProps)
+      {
+        UpdateItem_To_FileItem(ui, file, file2);
+        name = ui.Name;
+      }
+      else
+      {
+        GetFile(*db, ui.IndexInArchive, file, file2);
+        db->GetPath(ui.IndexInArchive, name);
+      }
+      
+      file.HasStream = false;
+      file.IsDir = false;
+      file.Size = 0;
+      file.CrcDefined = false;
+      
+      const unsigned index = newDatabase.Files.Size();
+      newDatabase.AddFile(file, file2, name);
+      newDatabase.DuplicateOf.SetItem(index, true, (UInt32)sourceIndex);
+      
+      if (ui.NewData && opCallback)
+      {
+        RINOK(opCallback->ReportOperation(NEventIndexType::kOutArcIndex, i, NUpdateNotifyOp::kReplicate));
+      }
+    }
   }
 
   RINOK(lps->SetCur());
@@ -99,9 +99,16 @@ struct CUpdateOptions
   bool SolidExtension;
   
   bool UseTypeSorting;
+  bool UseSimilaritySorting; // order files in solid blocks by similarity of their first bytes
+  bool Dedup;  // store new files with same data as references to first file
+  UInt32 IncompressibleThreshold; // entropy in percents of 8 bits per byte to store file with Copy method. 0 : disabled
   
   bool RemoveSfxBlock;
   bool MultiThreadMixer;
+  bool AppendMode; // output stream is the stream of old archive. New data is appended to it
+
+  UInt32 NumFolderThreads;     // number of solid blocks compressed at the same time
+  UInt64 FolderThreadsMemory;  // memory limit for buffers of these solid blocks
 
   CUpdateOptions():
       Method(NULL),
@@ -113,8 +120,14 @@ struct CUpdateOptions
       NumSolidBytes((UInt64)(Int64)(-1)),
       SolidExtension(false),
       UseTypeSorting(true),
+      UseSimilaritySorting(false),
+      Dedup(false),
+      IncompressibleThreshold(0),
       RemoveSfxBlock(false),
-      MultiThreadMixer(true)
+      MultiThreadMixer(true),
+      AppendMode(false),
+      NumFolderThreads(1),
+      FolderThreadsMemory(0)
     {}
 };
 
@@ -4,19 +4,27 @@
 
 // #include  <stdio.h>
 
+#include "../../../C/7zCrc.h"
 #include "../../../C/CpuArch.h"
 
 #include "../../Common/ComTry.h"
 #include "../../Common/Defs.h"
+#include "../../Common/MyBuffer.h"
 #include "../../Common/StringConvert.h"
+#include "../../Common/StringToInt.h"
 
 #include "../../Windows/PropVariant.h"
 #include "../../Windows/PropVariantUtils.h"
+#include "../../Windows/System.h"
 #include "../../Windows/TimeUtils.h"
 
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
+#include "../Common/StreamObjects.h"
 #include "../Common/StreamUtils.h"
+#ifndef _7ZIP_ST
+#include "../Common/VirtThread.h"
+#endif
 
 #include "../Compress/CopyCoder.h"
 #include "../Compress/DeflateDecoder.h"
@@ -446,9 +454,33 @@ HRESULT CItem::WriteFooter(ISequentialOutStream *stream)
   return WriteStream(stream, buf, 8);
 }
 
+/*
+  Random access to gzip data is based on check points (the method from zran.c in zlib):
+  each check point is the start of a deflate block or the start of a gzip member.
+  For block start we store the bit position in packed stream and last 32 KB
+  of unpacked data of that member (the history for decoder).
+*/
+
+static const UInt32 kCheckPointDictSize = (UInt32)1 << 15;
+static const unsigned kNumCheckPointsMax = 1 << 10;
+static const UInt64 kCheckPointStep = (UInt64)1 << 22;
+
+struct CCheckPoint
+{
+  UInt64 UnpackPos;
+  UInt64 PackPos;
+  unsigned NumSkipBits;
+  bool IsMemberStart;
+  CByteBuffer Dict;
+};
+
+class CCheckPointIndex;
+class CCompressProgressInfoImp;
+
 class CHandler:
   public IInArchive,
   public IArchiveOpenSeq,
+  public IInArchiveGetStream,
   public IOutArchive,
   public ISetProperties,
   public CMyUnknownImp
@@ -475,18 +507,30 @@ class CHandler:
 
   CSingleMethodProps _props;
 
+  UInt64 _memberSize; // 0 : one gzip member
+  
+  CCheckPointIndex *_indexSpec;
+  CMyComPtr<IUnknown> _index;
+  CCompressProgressInfoImp *_openProgressSpec;
+  CMyComPtr<ICompressProgressInfo> _openProgress;
+
+  HRESULT SetMemberSizeFromString(const UString &s);
+  HRESULT SetMemberSizeFromPROPVARIANT(const PROPVARIANT &value);
+
 public:
-  MY_UNKNOWN_IMP4(
+  MY_UNKNOWN_IMP5(
       IInArchive,
       IArchiveOpenSeq,
+      IInArchiveGetStream,
       IOutArchive,
       ISetProperties)
   INTERFACE_IInArchive(;)
   INTERFACE_IOutArchive(;)
   STDMETHOD(OpenSeq)(ISequentialInStream *stream);
+  STDMETHOD(GetStream)(UInt32 index, ISequentialInStream **stream);
   STDMETHOD(SetProperties)(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps);
 
-  CHandler()
+  CHandler(): _memberSize(0), _indexSpec(NULL), _openProgressSpec(NULL)
   {
     _decoderSpec = new NDecoder::CCOMCoder;
     _decoder = _decoderSpec;
@@ -621,7 +665,7 @@ STDMETHODIMP CCompressProgressInfoImp::SetRatioInfo(const UInt64 *inSize, const
 /*
 */
 
-STDMETHODIMP CHandler::Open(IInStream *stream, const UInt64 *, IArchiveOpenCallback *)
+STDMETHODIMP CHandler::Open(IInStream *stream, const UInt64 *, IArchiveOpenCallback *openCallback)
 {
   COM_TRY_BEGIN
   RINOK(OpenSeq(stream));
@@ -631,6 +675,13 @@ STDMETHODIMP CHandler::Open(IInStream *stream, const UInt64 *, IArchiveOpenCallb
   _packSize = endPos + 8;
   RINOK(_item.ReadFooter2(stream));
   _stream = stream;
+  if (openCallback)
+  {
+    _openProgressSpec = new CCompressProgressInfoImp;
+    _openProgress = _openProgressSpec;
+    _openProgressSpec->Init(openCallback);
+    _openProgressSpec->Offset = 0;
+  }
   _isArc = true;
   _needSeekToStart = true;
   return S_OK;
@@ -669,12 +720,511 @@ STDMETHODIMP CHandler::Close()
 
   _packSize = 0;
   _headerSize = 0;
+
+  if (_openProgressSpec)
+  {
+    // the streams from GetStream() can keep the index, but they don't report progress after Close()
+    _openProgressSpec->Init(NULL);
+    _openProgressSpec = NULL;
+    _openProgress.Release();
+  }
+  _indexSpec = NULL;
+  _index.Release();
   
   _stream.Release();
   _decoderSpec->ReleaseInStream();
   return S_OK;
 }
 
+
+class CHistoryOutStream:
+  public ISequentialOutStream,
+  public CMyUnknownImp
+{
+  CByteBuffer _buf;
+  UInt32 _pos;
+  UInt32 _crc;
+  UInt64 _size;
+public:
+  MY_UNKNOWN_IMP1(ISequentialOutStream)
+  STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
+
+  void Init()
+  {
+    if (_buf.Size() != kCheckPointDictSize)
+      _buf.Alloc(kCheckPointDictSize);
+    _pos = 0;
+    _crc = CRC_INIT_VAL;
+    _size = 0;
+  }
+  UInt64 GetSize() const { return _size; }
+  UInt32 GetCRC() const { return CRC_GET_DIGEST(_crc); }
+  void GetDict(CByteBuffer &dict) const;
+};
+
+STDMETHODIMP CHistoryOutStream::Write(const void *data, UInt32 size, UInt32 *processedSize)
+{
+  _crc = CrcUpdate(_crc, data, size);
+  _size += size;
+  if (processedSize)
+    *processedSize = size;
+  const Byte *p = (const Byte *)data;
+  while (size != 0)
+  {
+    UInt32 cur = kCheckPointDictSize - _pos;
+    if (cur > size)
+      cur = size;
+    memcpy(_buf + _pos, p, cur);
+    p += cur;
+    size -= cur;
+    _pos += cur;
+    if (_pos == kCheckPointDictSize)
+      _pos = 0;
+  }
+  return S_OK;
+}
+
+void CHistoryOutStream::GetDict(CByteBuffer &dict) const
+{
+  if (_size < kCheckPointDictSize)
+  {
+    dict.CopyFrom(_buf, (size_t)_size);
+    return;
+  }
+  dict.Alloc(kCheckPointDictSize);
+  memcpy(dict, _buf + _pos, kCheckPointDictSize - _pos);
+  memcpy(dict + (kCheckPointDictSize - _pos), _buf, _pos);
+}
+
+
+/*
+  The index of check points is built lazily: CInStream::Read() decodes the
+  data only up to the first check point after the requested position.
+  So GetStream() returns at once, and each Read() call indexes at most one
+  check point step. Seek from the end needs the full size, so it indexes
+  all remaining data. The progress of indexing goes to the open callback,
+  that also can cancel it.
+  The index holds its own reference to the archive stream, so the streams
+  from GetStream() can be used after CHandler::Close().
+*/
+
+class CCheckPointIndex:
+  public IUnknown,
+  public CMyUnknownImp
+{
+  NDecoder::CCOMCoder *_decoderSpec;
+  CMyComPtr<ICompressCoder> _decoder;
+  CHistoryOutStream *_histSpec;
+  CMyComPtr<ISequentialOutStream> _hist;
+
+  UInt64 _packBase;         // position in Stream, where the decoder was started
+  UInt64 _memberUnpackPos;  // unpack position of the start of current member
+  UInt64 _step;
+  unsigned _numDictPoints;
+  bool _canResume;          // the decoding was stopped at last check point
+  HRESULT _errorCode;
+
+  UInt64 GetPackPos() const { return _packBase + _decoderSpec->GetInputProcessedSize(); }
+  HRESULT Resume(bool &needHeader);
+  HRESULT ExtendSpec(UInt64 pos);
+public:
+  CMyComPtr<IInStream> Stream;
+  CMyComPtr<ICompressProgressInfo> Progress;
+  UInt64 PackSize;
+  CObjectVector<CCheckPoint> Points;
+  bool IsFinished;
+  UInt64 UnpackSize;        // it's defined, if (IsFinished)
+  const void *StreamUser;   // the object that was the last to seek in Stream
+
+  MY_UNKNOWN_IMP
+
+  CCheckPointIndex():
+      _packBase(0),
+      _memberUnpackPos(0),
+      _step(kCheckPointStep),
+      _numDictPoints(0),
+      _canResume(true),
+      _errorCode(S_OK),
+      PackSize(0),
+      IsFinished(false),
+      UnpackSize(0),
+      StreamUser(NULL)
+  {
+    _decoderSpec = new NDecoder::CCOMCoder;
+    _decoder = _decoderSpec;
+    _histSpec = new CHistoryOutStream;
+    _hist = _histSpec;
+  }
+
+  // it indexes the data until (Points.Back().UnpackPos > pos) or (IsFinished)
+  HRESULT Extend(UInt64 pos);
+};
+
+
+HRESULT CCheckPointIndex::Resume(bool &needHeader)
+{
+  StreamUser = this;
+  needHeader = Points.IsEmpty();
+  _packBase = needHeader ? 0 : Points.Back().PackPos;
+  RINOK(Stream->Seek(_packBase, STREAM_SEEK_SET, NULL));
+  
+  if (needHeader || Points.Back().IsMemberStart)
+  {
+    _decoderSpec->SetInStream(Stream);
+    RINOK(_decoderSpec->InitInStream(true));
+    if (!needHeader)
+    {
+      CItem item;
+      RINOK(item.ReadHeader(_decoderSpec));
+      _decoderSpec->SetOutStreamSizeResume(NULL);
+      _histSpec->Init();
+    }
+    return S_OK;
+  }
+  
+  // the history of _histSpec contains the data up to that check point
+  const CCheckPoint &cp = Points.Back();
+  return _decoderSpec->InitFromBlockStart(Stream, cp.NumSkipBits, cp.Dict, (UInt32)cp.Dict.Size());
+}
+
+
+HRESULT CCheckPointIndex::ExtendSpec(UInt64 pos)
+{
+  bool needHeader;
+  RINOK(Resume(needHeader));
+
+  for (;;)
+  {
+    _canResume = false;
+    
+    if (needHeader)
+    {
+      const UInt64 headerPos = GetPackPos();
+      CItem item;
+      HRESULT res = item.ReadHeader(_decoderSpec);
+      if (res == S_OK && _decoderSpec->InputEofError())
+        res = S_FALSE;
+      if (res != S_OK)
+      {
+        if (res != S_FALSE || Points.IsEmpty())
+          return res;
+        break; // data after end
+      }
+      needHeader = false;
+      _histSpec->Init();
+      _decoderSpec->SetOutStreamSizeResume(NULL);
+      
+      CCheckPoint &cp = Points.AddNew();
+      cp.UnpackPos = _memberUnpackPos;
+      cp.PackPos = headerPos;
+      cp.NumSkipBits = 0;
+      cp.IsMemberStart = true;
+      _canResume = true;
+      if (cp.UnpackPos > pos)
+        return S_OK;
+      _canResume = false;
+    }
+
+    RINOK(_decoderSpec->CodeToBlockStart(_hist, _step));
+    
+    if (!_decoderSpec->IsFinished())
+    {
+      if (_numDictPoints >= kNumCheckPointsMax)
+      {
+        // we remove every second check point and increase the distance for new check points
+        bool del = false;
+        for (unsigned i = 0; i < Points.Size();)
+        {
+          if (Points[i].IsMemberStart)
+          {
+            i++;
+            continue;
+          }
+          if (del)
+          {
+            Points.Delete(i);
+            _numDictPoints--;
+          }
+          else
+            i++;
+          del = !del;
+        }
+        _step <<= 1;
+      }
+
+      const UInt64 bits = _packBase * 8 + _decoderSpec->GetInputProcessedBits();
+      CCheckPoint &cp = Points.AddNew();
+      cp.UnpackPos = _memberUnpackPos + _histSpec->GetSize();
+      cp.PackPos = bits >> 3;
+      cp.NumSkipBits = (unsigned)bits & 7;
+      cp.IsMemberStart = false;
+      _histSpec->GetDict(cp.Dict);
+      _numDictPoints++;
+      _canResume = true;
+
+      if (Progress)
+      {
+        RINOK(Progress->SetRatioInfo(&cp.PackPos, &cp.UnpackPos));
+      }
+      if (cp.UnpackPos > pos)
+        return S_OK;
+      continue;
+    }
+
+    _decoderSpec->AlignToByte();
+    CItem item;
+    RINOK(item.ReadFooter1(_decoderSpec));
+    if (item.Crc != _histSpec->GetCRC() ||
+        item.Size32 != (UInt32)_histSpec->GetSize())
+      return S_FALSE;
+    _memberUnpackPos += _histSpec->GetSize();
+
+    if (GetPackPos() >= PackSize)
+      break;
+    needHeader = true;
+  }
+
+  UnpackSize = _memberUnpackPos;
+  IsFinished = true;
+  _canResume = true;
+  return S_OK;
+}
+
+
+HRESULT CCheckPointIndex::Extend(UInt64 pos)
+{
+  if (IsFinished || (!Points.IsEmpty() && Points.Back().UnpackPos > pos))
+    return S_OK;
+  if (_errorCode != S_OK)
+    return _errorCode;
+  
+  HRESULT res;
+  try
+  {
+    res = ExtendSpec(pos);
+  }
+  catch(const CInBufferException &e) { res = e.ErrorCode; }
+  
+  // if the decoding was broken after last check point, we can't continue it later
+  if (res != S_OK && !_canResume)
+    _errorCode = res;
+  return res;
+}
+
+
+static const UInt32 kSkipBufSize = 1 << 16;
+
+class CInStream:
+  public IInStream,
+  public CMyUnknownImp
+{
+  NDecoder::CCOMCoder *_decoderSpec;
+  CMyComPtr<ICompressCoder> _decoder;
+  UInt64 _decPos;
+  bool _decIsReady;
+  UInt64 _virtPos;
+  CByteBuffer _skipBuf;
+  CCheckPointIndex *_indexSpec;
+  CMyComPtr<IUnknown> _index;
+
+  HRESULT Restart(const CCheckPoint &cp);
+  HRESULT DecodeData(Byte *data, UInt32 size, UInt32 &processed);
+  HRESULT ReadSpec(void *data, UInt32 size, UInt32 &processed);
+public:
+  CInStream(CCheckPointIndex *indexSpec): _decPos(0), _decIsReady(false), _virtPos(0),
+      _indexSpec(indexSpec), _index(indexSpec)
+  {
+    _decoderSpec = new NDecoder::CCOMCoder;
+    _decoder = _decoderSpec;
+    _skipBuf.Alloc(kSkipBufSize);
+  }
+
+  MY_UNKNOWN_IMP1(IInStream)
+
+  STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
+};
+
+
+static unsigned FindCheckPoint(const CObjectVector<CCheckPoint> &points, UInt64 pos)
+{
+  unsigned left = 0, right = points.Size();
+  for (;;)
+  {
+    unsigned mid = (left + right) / 2;
+    if (mid == left)
+      return left;
+    if (pos < points[mid].UnpackPos)
+      right = mid;
+    else
+      left = mid;
+  }
+}
+
+
+HRESULT CInStream::Restart(const CCheckPoint &cp)
+{
+  _decIsReady = false;
+  IInStream *stream = _indexSpec->Stream;
+  _indexSpec->StreamUser = this;
+  RINOK(stream->Seek(cp.PackPos, STREAM_SEEK_SET, NULL));
+  if (cp.IsMemberStart)
+  {
+    _decoderSpec->SetInStream(stream);
+    RINOK(_decoderSpec->InitInStream(true));
+    CItem item;
+    RINOK(item.ReadHeader(_decoderSpec));
+    _decoderSpec->SetOutStreamSizeResume(NULL);
+  }
+  else
+  {
+    RINOK(_decoderSpec->InitFromBlockStart(stream, cp.NumSkipBits, cp.Dict, (UInt32)cp.Dict.Size()));
+  }
+  _decPos = cp.UnpackPos;
+  _decIsReady = true;
+  return S_OK;
+}
+
+
+HRESULT CInStream::DecodeData(Byte *data, UInt32 size, UInt32 &processed)
+{
+  processed = 0;
+  for (;;)
+  {
+    RINOK(_decoderSpec->Read(data, size, &processed));
+    if (processed != 0)
+      return S_OK;
+    if (!_decoderSpec->IsFinished())
+      return S_FALSE;
+    // end of gzip member: we skip footer and header of next member
+    _decoderSpec->AlignToByte();
+    CItem item;
+    RINOK(item.ReadFooter1(_decoderSpec));
+    RINOK(item.ReadHeader(_decoderSpec));
+    _decoderSpec->SetOutStreamSizeResume(NULL);
+  }
+}
+
+
+HRESULT CInStream::ReadSpec(void *data, UInt32 size, UInt32 &processed)
+{
+  processed = 0;
+  CCheckPointIndex &index = *_indexSpec;
+  RINOK(index.Extend(_virtPos));
+  
+  // we read only the data that is covered by index
+  const UInt64 end = index.IsFinished ? index.UnpackSize : index.Points.Back().UnpackPos;
+  if (_virtPos >= end)
+    return S_OK;
+  {
+    const UInt64 rem = end - _virtPos;
+    if (size > rem)
+      size = (UInt32)rem;
+  }
+
+  const CObjectVector<CCheckPoint> &points = index.Points;
+  const CCheckPoint &cp = points[FindCheckPoint(points, _virtPos)];
+  
+  if (!_decIsReady || index.StreamUser != this || _virtPos < _decPos || cp.UnpackPos > _decPos)
+  {
+    RINOK(Restart(cp));
+  }
+  
+  while (_decPos != _virtPos)
+  {
+    const UInt64 rem = _virtPos - _decPos;
+    UInt32 cur = kSkipBufSize;
+    if (cur > rem)
+      cur = (UInt32)rem;
+    RINOK(DecodeData(_skipBuf, cur, cur));
+    _decPos += cur;
+  }
+  
+  RINOK(DecodeData((Byte *)data, size, processed));
+  _decPos += processed;
+  _virtPos += processed;
+  return S_OK;
+}
+
+
+STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  COM_TRY_BEGIN
+
+  if (processedSize)
+    *processedSize = 0;
+  if (size == 0)
+    return S_OK;
+
+  HRESULT res;
+  UInt32 processed = 0;
+  try
+  {
+    res = ReadSpec(data, size, processed);
+  }
+  catch(const CInBufferException &e) { res = e.ErrorCode; }
+  
+  if (res != S_OK)
+    _decIsReady = false;
+  if (processedSize)
+    *processedSize = processed;
+  return res;
+
+  COM_TRY_END
+}
+
+
+STDMETHODIMP CInStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+{
+  switch (seekOrigin)
+  {
+    case STREAM_SEEK_SET: break;
+    case STREAM_SEEK_CUR: offset += _virtPos; break;
+    case STREAM_SEEK_END:
+    {
+      RINOK(_indexSpec->Extend((UInt64)(Int64)-1));
+      offset += _indexSpec->UnpackSize;
+      break;
+    }
+    default: return STG_E_INVALIDFUNCTION;
+  }
+  if (offset < 0)
+    return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+  _virtPos = offset;
+  if (newPosition)
+    *newPosition = offset;
+  return S_OK;
+}
+
+
+STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
+{
+  COM_TRY_BEGIN
+
+  *stream = NULL;
+
+  if (index != 0)
+    return E_INVALIDARG;
+
+  if (!_stream)
+    return S_FALSE;
+
+  if (!_indexSpec)
+  {
+    _indexSpec = new CCheckPointIndex;
+    _index = _indexSpec;
+    _indexSpec->Stream = _stream;
+    _indexSpec->PackSize = _packSize;
+    _indexSpec->Progress = _openProgress;
+  }
+
+  CMyComPtr<ISequentialInStream> specStream = new CInStream(_indexSpec);
+  *stream = specStream.Detach();
+  return S_OK;
+
+  COM_TRY_END
+}
+
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback)
 {
@@ -872,11 +1422,221 @@ static const Byte kHostOS =
   NHostOS::kUnix;
   #endif
 
+/*
+  If (memberSize != 0), the data is split to independent gzip members of (memberSize) bytes.
+  Each member is compressed by separate thread with own CRC.
+  Standard gzip decoders unpack such concatenated members as one stream.
+*/
+
+static const UInt64 kMemberSize_Default = (UInt64)1 << 24;
+static const UInt64 kMemberSize_Max = (UInt64)1 << 30;
+
+class CMemberEncoder
+{
+  NEncoder::CCOMCoder *_encoderSpec;
+  CMyComPtr<ICompressCoder> _encoder;
+  CBufInStream *_inStreamSpec;
+  CMyComPtr<ISequentialInStream> _inStream;
+public:
+  CByteBuffer InBuf;
+  size_t Size;
+  CItem Item;
+  CDynBufSeqOutStream *OutStreamSpec;
+  CMyComPtr<ISequentialOutStream> OutStream;
+
+  CMemberEncoder(): Size(0)
+  {
+    _encoderSpec = new NEncoder::CCOMCoder;
+    _encoder = _encoderSpec;
+    _inStreamSpec = new CBufInStream;
+    _inStream = _inStreamSpec;
+    OutStreamSpec = new CDynBufSeqOutStream;
+    OutStream = OutStreamSpec;
+  }
+
+  HRESULT Alloc(const CProps &props, size_t bufSize)
+  {
+    InBuf.Alloc(bufSize);
+    return props.SetCoderProps(_encoderSpec, NULL);
+  }
+
+  void SetItem(const CItem &item, bool isFirst)
+  {
+    Item.CopyMetaPropsFrom(item);
+    Item.ExtraFlags = item.ExtraFlags;
+    if (!isFirst)
+    {
+      // the name is stored only in the header of first member
+      Item.Flags &= ~NFlags::kName;
+      Item.Name.Empty();
+    }
+  }
+
+  HRESULT Encode();
+};
+
+HRESULT CMemberEncoder::Encode()
+{
+  OutStreamSpec->Init();
+  _inStreamSpec->Init(InBuf, Size);
+  RINOK(Item.WriteHeader(OutStream));
+  RINOK(_encoder->Code(_inStream, OutStream, NULL, NULL, NULL));
+  Item.Crc = CrcCalc(InBuf, Size);
+  Item.Size32 = (UInt32)Size;
+  return Item.WriteFooter(OutStream);
+}
+
+static HRESULT WriteMember(ISequentialOutStream *outStream, const CMemberEncoder &enc,
+    UInt64 &inPos, UInt64 &outPos, ICompressProgressInfo *progress)
+{
+  const size_t size = enc.OutStreamSpec->GetSize();
+  RINOK(WriteStream(outStream, enc.OutStreamSpec->GetBuffer(), size));
+  inPos += enc.Size;
+  outPos += size;
+  return progress->SetRatioInfo(&inPos, &outPos);
+}
+
+#ifndef _7ZIP_ST
+
+class CMemberThread: public CVirtThread
+{
+public:
+  CMemberEncoder Enc;
+  HRESULT Result;
+
+  CMemberThread(): Result(S_OK) {}
+  ~CMemberThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute()
+  {
+    try { Result = Enc.Encode(); }
+    catch(...) { Result = E_FAIL; }
+  }
+};
+
+static HRESULT WriteMembersMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const CItem &item, const CProps &props, size_t memberSize, unsigned numThreads,
+    ICompressProgressInfo *progress)
+{
+  CObjectVector<CMemberThread> threads;
+  threads.ClearAndReserve(numThreads);
+  
+  UInt64 numStarted = 0;
+  UInt64 numWritten = 0;
+  UInt64 inPos = 0;
+  UInt64 outPos = 0;
+  bool finished = false;
+  HRESULT res = S_OK;
+
+  for (;;)
+  {
+    while (numWritten != numStarted && (finished || numStarted - numWritten == numThreads))
+    {
+      CMemberThread &t = threads[(unsigned)(numWritten % numThreads)];
+      t.WaitExecuteFinish();
+      numWritten++;
+      res = t.Result;
+      if (res != S_OK)
+        break;
+      res = WriteMember(outStream, t.Enc, inPos, outPos, progress);
+      if (res != S_OK)
+        break;
+    }
+    if (res != S_OK || finished)
+      break;
+
+    const unsigned threadIndex = (unsigned)(numStarted % numThreads);
+    if (threadIndex == threads.Size())
+    {
+      CMemberThread &t = threads.AddNewInReserved();
+      res = t.Enc.Alloc(props, memberSize);
+      if (res == S_OK)
+        res = t.Create();
+      if (res != S_OK)
+      {
+        threads.DeleteBack();
+        break;
+      }
+    }
+
+    CMemberThread &t = threads[threadIndex];
+    size_t size = memberSize;
+    res = ReadStream(inStream, t.Enc.InBuf, &size);
+    if (res != S_OK)
+      break;
+    if (size == 0 && numStarted != 0)
+    {
+      finished = true;
+      continue;
+    }
+    t.Enc.Size = size;
+    t.Enc.SetItem(item, numStarted == 0);
+    t.Start();
+    numStarted++;
+    if (size != memberSize)
+      finished = true;
+  }
+
+  while (numWritten != numStarted)
+  {
+    threads[(unsigned)(numWritten % numThreads)].WaitExecuteFinish();
+    numWritten++;
+  }
+
+  return res;
+}
+
+#endif
+
+static HRESULT WriteMembers(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const CItem &item, const CMethodProps &props, UInt64 memberSize, UInt32 numThreads,
+    ICompressProgressInfo *progress)
+{
+  if (memberSize > kMemberSize_Max)
+    memberSize = kMemberSize_Max;
+
+  // each member is compressed by single-threaded encoder
+  CMethodProps memberProps = props;
+  memberProps.AddProp_NumThreads(1);
+
+  #ifndef _7ZIP_ST
+  {
+    UInt64 ramSize = (UInt64)(sizeof(size_t)) << 29;
+    NWindows::NSystem::GetRamSize(ramSize);
+    const UInt64 threadMem = memberSize * 2 + ((UInt64)1 << 24);
+    const UInt64 numThreadsMax = ramSize / 4 / threadMem;
+    if (numThreads > numThreadsMax)
+      numThreads = (UInt32)numThreadsMax;
+    if (numThreads > 1)
+      return WriteMembersMt(inStream, outStream, item, memberProps, (size_t)memberSize, numThreads, progress);
+  }
+  #endif
+
+  CMemberEncoder enc;
+  RINOK(enc.Alloc(memberProps, (size_t)memberSize));
+  UInt64 inPos = 0;
+  UInt64 outPos = 0;
+  
+  for (UInt64 i = 0;; i++)
+  {
+    size_t size = (size_t)memberSize;
+    RINOK(ReadStream(inStream, enc.InBuf, &size));
+    if (size == 0 && i != 0)
+      return S_OK;
+    enc.Size = size;
+    enc.SetItem(item, i == 0);
+    RINOK(enc.Encode());
+    RINOK(WriteMember(outStream, enc, inPos, outPos, progress));
+    if (size != memberSize)
+      return S_OK;
+  }
+}
+
 static HRESULT UpdateArchive(
     ISequentialOutStream *outStream,
     UInt64 unpackSize,
     CItem &item,
     const CSingleMethodProps &props,
+    UInt64 memberSize,
     IArchiveUpdateCallback *updateCallback)
 {
   UInt64 complexity = 0;
@@ -887,11 +1647,6 @@ static HRESULT UpdateArchive(
 
   RINOK(updateCallback->GetStream(0, &fileInStream));
 
-  CSequentialInStreamWithCRC *inStreamSpec = new CSequentialInStreamWithCRC;
-  CMyComPtr<ISequentialInStream> crcStream(inStreamSpec);
-  inStreamSpec->SetStream(fileInStream);
-  inStreamSpec->Init();
-
   CLocalProgress *lps = new CLocalProgress;
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(updateCallback, true);
@@ -902,11 +1657,31 @@ static HRESULT UpdateArchive(
 
   item.HostOS = kHostOS;
 
+  // both modes use the same number of threads: -mmt=N, or all CPUs by default
+  UInt32 numThreads = 1;
+  #ifndef _7ZIP_ST
+  numThreads = props._numThreads;
+  #endif
+
+  if (memberSize != 0)
+  {
+    RINOK(WriteMembers(fileInStream, outStream, item, props, memberSize, numThreads, progress));
+    return updateCallback->SetOperationResult(NUpdate::NOperationResult::kOK);
+  }
+
+  CSequentialInStreamWithCRC *inStreamSpec = new CSequentialInStreamWithCRC;
+  CMyComPtr<ISequentialInStream> crcStream(inStreamSpec);
+  inStreamSpec->SetStream(fileInStream);
+  inStreamSpec->Init();
+
   RINOK(item.WriteHeader(outStream));
 
+  CMethodProps coderProps = props;
+  coderProps.AddProp_NumThreads(numThreads);
+
   NEncoder::CCOMCoder *deflateEncoderSpec = new NEncoder::CCOMCoder;
   CMyComPtr<ICompressCoder> deflateEncoder = deflateEncoderSpec;
-  RINOK(props.SetCoderProps(deflateEncoderSpec, NULL));
+  RINOK(coderProps.SetCoderProps(deflateEncoderSpec, NULL));
   RINOK(deflateEncoder->Code(crcStream, outStream, NULL, NULL, progress));
 
   item.Crc = inStreamSpec->GetCRC();
@@ -989,7 +1764,7 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
         return E_INVALIDARG;
       size = prop.uhVal.QuadPart;
     }
-    return UpdateArchive(outStream, size, newItem, _props, updateCallback);
+    return UpdateArchive(outStream, size, newItem, _props, _memberSize, updateCallback);
   }
 
   if (indexInArchive != 0)
@@ -1026,9 +1801,86 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   COM_TRY_END
 }
 
+HRESULT CHandler::SetMemberSizeFromString(const UString &s)
+{
+  UString s2 = s;
+  s2.MakeLower_Ascii();
+  
+  const wchar_t *start = ((const wchar_t *)s2);
+  const wchar_t *end;
+  UInt64 v = ConvertStringToUInt64(start, &end);
+  if (start == end)
+    return E_INVALIDARG;
+  if ((unsigned)(end - start) + 1 != s2.Len())
+    return E_INVALIDARG;
+  unsigned numBits;
+  switch (*end)
+  {
+    case 'b': numBits =  0; break;
+    case 'k': numBits = 10; break;
+    case 'm': numBits = 20; break;
+    case 'g': numBits = 30; break;
+    default: return E_INVALIDARG;
+  }
+  _memberSize = (v << numBits);
+  return S_OK;
+}
+
+HRESULT CHandler::SetMemberSizeFromPROPVARIANT(const PROPVARIANT &value)
+{
+  bool isSolid;
+  switch (value.vt)
+  {
+    case VT_EMPTY: isSolid = true; break;
+    case VT_BOOL: isSolid = (value.boolVal != VARIANT_FALSE); break;
+    case VT_BSTR:
+      if (StringToBool(value.bstrVal, isSolid))
+        break;
+      return SetMemberSizeFromString(value.bstrVal);
+    default: return E_INVALIDARG;
+  }
+  _memberSize = (isSolid ? 0 : kMemberSize_Default);
+  return S_OK;
+}
+
 STDMETHODIMP CHandler::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps)
 {
-  return _props.SetProperties(names, values, numProps);
+  COM_TRY_BEGIN
+  
+  _memberSize = 0;
+  
+  // "s" (solid) property sets the size of gzip members. Other properties are for Deflate encoder.
+  CRecordVector<const wchar_t *> names2;
+  CRecordVector<PROPVARIANT> values2;
+  
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    UString name = names[i];
+    name.MakeLower_Ascii();
+    if (!name.IsEmpty() && name[0] == L's')
+    {
+      name.Delete(0);
+      if (name.IsEmpty())
+      {
+        RINOK(SetMemberSizeFromPROPVARIANT(values[i]));
+      }
+      else
+      {
+        if (values[i].vt != VT_EMPTY)
+          return E_INVALIDARG;
+        RINOK(SetMemberSizeFromString(name));
+      }
+      continue;
+    }
+    names2.Add(names[i]);
+    values2.Add(values[i]);
+  }
+  
+  if (names2.IsEmpty())
+    return _props.SetProperties(NULL, NULL, 0);
+  return _props.SetProperties(&names2.Front(), &values2.Front(), names2.Size());
+  
+  COM_TRY_END
 }
 
 static const Byte k_Signature[] = { kSignature_0, kSignature_1, kSignature_2 };
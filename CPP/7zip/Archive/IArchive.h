@@ -333,6 +333,31 @@ ARCHIVE_INTERFACE(IArchiveGetRootProps, 0x71)
   INTERFACE_IArchiveGetRootProps(PURE)
 };
 
+/*
+  IArchiveFindItem allows to find items by path without full scan of items.
+  (path) uses same form as kpidPath: OS path separators, no tail separator.
+
+  FindItem()
+    returns the first item (index >= startIndex) with (path).
+    The comparison is case insensitive. So the caller must check the path of item.
+    Result:
+      S_OK    : (*index) is the index of found item
+      S_FALSE : there are no more such items
+
+  IsDirPrefix()
+    (*isDirPrefix) = true, if some item can be located in (path) directory.
+    It can return true also for some other paths (hash collision).
+*/
+
+#define INTERFACE_IArchiveFindItem(x) \
+  STDMETHOD(FindItem)(const wchar_t *path, UInt32 startIndex, UInt32 *index) x; \
+  STDMETHOD(IsDirPrefix)(const wchar_t *path, Int32 *isDirPrefix) x; \
+
+ARCHIVE_INTERFACE(IArchiveFindItem, 0x72)
+{
+  INTERFACE_IArchiveFindItem(PURE)
+};
+
 ARCHIVE_INTERFACE(IArchiveOpenSeq, 0x61)
 {
   STDMETHOD(OpenSeq)(ISequentialInStream *stream) PURE;
@@ -451,22 +451,27 @@ HRESULT CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     }
     RINOK(extractCallback->PrepareOperation(askMode));
 
-    outStreamSpec->SetStream(realOutStream);
-    realOutStream.Release();
-    outStreamSpec->Init(skipMode ? 0 : unpackSize, true);
-
     Int32 opRes = NExtract::NOperationResult::kOK;
-    CMyComPtr<ISequentialInStream> inStream2;
-    if (!item->IsSparse())
-      inStream2 = inStream;
-    else
+
+    if (item->IsSparse())
     {
-      GetStream(index, &inStream2);
-      if (!inStream2)
-        return E_FAIL;
+      if (!seqMode)
+      {
+        RINOK(_stream->Seek(item->GetDataPosition(), STREAM_SEEK_SET, NULL));
+      }
+      streamSpec->Init(item->GetPackSizeAligned());
+      bool dataError;
+      RINOK(ExtractSparse(*item, inStream, realOutStream, lps, dataError));
+      realOutStream.Release();
+      if (dataError)
+        opRes = NExtract::NOperationResult::kDataError;
     }
-
+    else
     {
+      outStreamSpec->SetStream(realOutStream);
+      realOutStream.Release();
+      outStreamSpec->Init(skipMode ? 0 : unpackSize, true);
+
       if (item->IsSymLink())
       {
         RINOK(WriteStream(outStreamSpec, (const char *)item->LinkName, item->LinkName.Len()));
@@ -478,23 +483,100 @@ HRESULT CHandler::Extract(const UInt32 *indices, UInt32 numItems,
           RINOK(_stream->Seek(item->GetDataPosition(), STREAM_SEEK_SET, NULL));
         }
         streamSpec->Init(item->GetPackSizeAligned());
-        RINOK(copyCoder->Code(inStream2, outStream, NULL, NULL, progress));
+        RINOK(copyCoder->Code(inStream, outStream, NULL, NULL, progress));
       }
       if (outStreamSpec->GetRem() != 0)
         opRes = NExtract::NOperationResult::kDataError;
+      outStreamSpec->ReleaseStream();
     }
     if (seqMode)
     {
       _latestIsRead = false;
       _curIndex++;
     }
-    outStreamSpec->ReleaseStream();
     RINOK(extractCallback->SetOperationResult(opRes));
   }
   return S_OK;
   COM_TRY_END
 }
 
+static const size_t kZerosBufSize = 1 << 16;
+
+/* We read data blocks of sparse item sequentially, so it works in seq mode also.
+   Holes are skipped in output file, if (outStream) supports it. */
+
+HRESULT CHandler::ExtractSparse(const CItemEx &item, ISequentialInStream *inStream,
+    ISequentialOutStream *outStream, CLocalProgress *lps, bool &dataError)
+{
+  dataError = false;
+  CMyComPtr<IOutStreamWriteHole> holeStream;
+  if (outStream)
+    outStream->QueryInterface(IID_IOutStreamWriteHole, (void **)&holeStream);
+  CByteBuffer zeros;
+  
+  const UInt64 inStart = lps->InSize;
+  const UInt64 outStart = lps->OutSize;
+  UInt64 pos = 0;
+  UInt64 packPos = 0;
+  
+  for (unsigned i = 0;; i++)
+  {
+    const bool isLast = (i == item.SparseBlocks.Size());
+    const UInt64 next = isLast ? item.Size : item.SparseBlocks[i].Offset;
+    
+    if (outStream && next != pos)
+    {
+      UInt64 rem = next - pos;
+      HRESULT res = S_FALSE;
+      if (holeStream)
+        res = holeStream->WriteHole(rem);
+      if (res != S_FALSE)
+      {
+        RINOK(res);
+      }
+      else
+      {
+        if (zeros.Size() == 0)
+        {
+          zeros.Alloc(kZerosBufSize);
+          memset(zeros, 0, kZerosBufSize);
+        }
+        while (rem != 0)
+        {
+          size_t cur = kZerosBufSize;
+          if (cur > rem)
+            cur = (size_t)rem;
+          RINOK(WriteStream(outStream, zeros, cur));
+          rem -= cur;
+        }
+      }
+    }
+    
+    pos = next;
+    lps->InSize = inStart + packPos;
+    lps->OutSize = outStart + pos;
+    RINOK(lps->SetCur());
+    if (isLast)
+      break;
+    
+    const UInt64 size = item.SparseBlocks[i].Size;
+    RINOK(copyCoder->Code(inStream, outStream, NULL, &size, lps));
+    packPos += copyCoderSpec->TotalSize;
+    if (copyCoderSpec->TotalSize != size)
+    {
+      dataError = true;
+      return S_OK;
+    }
+    pos += size;
+  }
+
+  // we skip the data residual up to the end of aligned pack size
+  RINOK(copyCoder->Code(inStream, NULL, NULL, NULL, NULL));
+  if (packPos + copyCoderSpec->TotalSize != item.GetPackSizeAligned())
+    dataError = true;
+  return S_OK;
+}
+
 class CSparseStream:
   public IInStream,
   public CMyUnknownImp
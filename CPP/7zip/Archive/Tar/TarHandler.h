@@ -7,6 +7,8 @@
 
 #include "../../../Windows/PropVariant.h"
 
+#include "../../Common/ProgressUtils.h"
+
 #include "../../Compress/CopyCoder.h"
 
 #include "../IArchive.h"
@@ -54,6 +56,8 @@ private:
   HRESULT ReadItem2(ISequentialInStream *stream, bool &filled, CItemEx &itemInfo);
   HRESULT Open2(IInStream *stream, IArchiveOpenCallback *callback);
   HRESULT SkipTo(UInt32 index);
+  HRESULT ExtractSparse(const CItemEx &item, ISequentialInStream *inStream,
+      ISequentialOutStream *outStream, CLocalProgress *lps, bool &dataError);
   void TarStringToUnicode(const AString &s, NWindows::NCOM::CPropVariant &prop, bool toOs = false) const;
 public:
   MY_UNKNOWN_IMP5(
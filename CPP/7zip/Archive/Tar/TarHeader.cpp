@@ -18,6 +18,7 @@ namespace NFileHeader {
     // const char * const kGNUTar = "GNUtar "; // 7 chars and a null
     // const char * const kEmpty = "\0\0\0\0\0\0\0\0";
     const char kUsTar_00[8] = { 'u', 's', 't', 'a', 'r', 0, '0', '0' } ;
+    const char kGnuTar[8] = { 'u', 's', 't', 'a', 'r', ' ', ' ', 0 } ;
   }
 
 }}}
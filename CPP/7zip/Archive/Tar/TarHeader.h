@@ -76,6 +76,7 @@ namespace NFileHeader
     // extern const char * const kGNUTar; //  = "GNUtar "; // 7 chars and a null
     // extern const char * const kEmpty;  //  = "\0\0\0\0\0\0\0\0"
     extern const char kUsTar_00[8];
+    extern const char kGnuTar[8];   //  = "ustar  \0"; // OLDGNU_MAGIC
   }
 }
 
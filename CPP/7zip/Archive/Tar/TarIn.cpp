@@ -285,10 +285,9 @@ static HRESULT GetNextItemReal(ISequentialInStream *stream, bool &filled, CItemE
       RIF(ParseSize(p, sb.Offset));
       RIF(ParseSize(p + 12, sb.Size));
       item.SparseBlocks.Add(sb);
+      // the size of last block is not aligned for 512, if the file ends with data
       if (sb.Offset < min || sb.Offset > item.Size)
         return S_OK;
-      if ((sb.Offset & 0x1FF) != 0 || (sb.Size & 0x1FF) != 0)
-        return S_OK;
       min = sb.Offset + sb.Size;
       if (min < sb.Offset)
         return S_OK;
@@ -325,8 +324,6 @@ static HRESULT GetNextItemReal(ISequentialInStream *stream, bool &filled, CItemE
         item.SparseBlocks.Add(sb);
         if (sb.Offset < min || sb.Offset > item.Size)
           return S_OK;
-        if ((sb.Offset & 0x1FF) != 0 || (sb.Size & 0x1FF) != 0)
-          return S_OK;
         min = sb.Offset + sb.Size;
         if (min < sb.Offset)
           return S_OK;
@@ -355,13 +352,128 @@ static HRESULT ReadDataToString(ISequentialInStream *stream, CItemEx &item, AStr
   return S_OK;
 }
 
-static bool ParsePaxLongName(const AString &src, AString &dest)
+/*
+  GNU tar stores sparse map in pax records of regular file:
+    0.0 : GNU.sparse.size, GNU.sparse.numblocks and
+          (GNU.sparse.offset, GNU.sparse.numbytes) pair for each block
+    0.1 : GNU.sparse.size, GNU.sparse.numblocks, GNU.sparse.map=offset,size,...
+    1.0 : GNU.sparse.major=1, GNU.sparse.realsize, and the map is stored
+          at the start of file data (see ReadSparseMap).
+  GNU.sparse.name contains real name of file in all versions.
+*/
+
+struct CPaxInfo
+{
+  AString Path;
+  AString SparseName;
+  CRecordVector<CSparseBlock> SparseBlocks;
+  UInt64 SparseSize;
+  UInt64 SparseNumBlocks;
+  UInt64 SparseMajor;
+  bool SparseSize_Defined;
+  bool SparseNumBlocks_Defined;
+  bool SparseMajor_Defined;
+  bool SparseNumBytes_Expected;
+
+  CPaxInfo():
+      SparseSize_Defined(false),
+      SparseNumBlocks_Defined(false),
+      SparseMajor_Defined(false),
+      SparseNumBytes_Expected(false)
+      {}
+
+  bool IsSparse() const { return SparseSize_Defined || SparseMajor_Defined; }
+  bool ParseRecord(const AString &name, const AString &val);
+};
+
+static bool ParseDecimal(const char *s, UInt64 &val)
+{
+  const char *end;
+  val = ConvertStringToUInt64(s, &end);
+  return end != s && *end == 0;
+}
+
+bool CPaxInfo::ParseRecord(const AString &name, const AString &val)
 {
-  dest.Empty();
-  for (unsigned pos = 0;;)
+  if (name.IsEqualTo("path"))
+  {
+    Path = val;
+    return !Path.IsEmpty();
+  }
+  if (!name.IsPrefixedBy("GNU.sparse."))
+    return true;
+  const char *s = name.Ptr(11);
+  UInt64 v;
+  if (strcmp(s, "name") == 0)
+  {
+    SparseName = val;
+    return !SparseName.IsEmpty();
+  }
+  if (strcmp(s, "map") == 0)
+  {
+    SparseBlocks.Clear();
+    if (val.IsEmpty())
+      return true;
+    CSparseBlock sb;
+    for (const char *p = val;; p++)
+    {
+      const char *end;
+      sb.Offset = ConvertStringToUInt64(p, &end);
+      if (end == p || *end != ',')
+        return false;
+      p = end + 1;
+      sb.Size = ConvertStringToUInt64(p, &end);
+      if (end == p)
+        return false;
+      SparseBlocks.Add(sb);
+      if (*end == 0)
+        return true;
+      if (*end != ',')
+        return false;
+      p = end;
+    }
+  }
+  if (!ParseDecimal(val, v))
+    return false;
+  if (strcmp(s, "size") == 0 || strcmp(s, "realsize") == 0)
+  {
+    SparseSize = v;
+    SparseSize_Defined = true;
+  }
+  else if (strcmp(s, "numblocks") == 0)
+  {
+    SparseNumBlocks = v;
+    SparseNumBlocks_Defined = true;
+  }
+  else if (strcmp(s, "major") == 0)
   {
-    if (pos >= src.Len())
+    SparseMajor = v;
+    SparseMajor_Defined = true;
+  }
+  else if (strcmp(s, "offset") == 0)
+  {
+    if (SparseNumBytes_Expected)
       return false;
+    CSparseBlock sb;
+    sb.Offset = v;
+    sb.Size = 0;
+    SparseBlocks.Add(sb);
+    SparseNumBytes_Expected = true;
+  }
+  else if (strcmp(s, "numbytes") == 0)
+  {
+    if (!SparseNumBytes_Expected)
+      return false;
+    SparseBlocks.Back().Size = v;
+    SparseNumBytes_Expected = false;
+  }
+  return true;
+}
+
+static bool ParsePax(const AString &src, CPaxInfo &pax)
+{
+  for (unsigned pos = 0; pos < src.Len();)
+  {
     const char *start = src.Ptr(pos);
     const char *end;
     const UInt32 lineLen = ConvertStringToUInt32(start, &end);
@@ -371,27 +483,112 @@ static bool ParsePaxLongName(const AString &src, AString &dest)
       return false;
     if (lineLen > src.Len() - pos)
       return false;
-    unsigned offset = (unsigned)(end - start) + 1;
-    if (lineLen < offset)
+    const unsigned offset = (unsigned)(end - start) + 1;
+    if (lineLen <= offset)
+      return false;
+    if (src[pos + lineLen - 1] != '\n')
+      return false;
+    const AString rec = src.Mid(pos + offset, lineLen - offset - 1);
+    pos += lineLen;
+    const int eqPos = rec.Find('=');
+    if (eqPos <= 0)
+      return false;
+    if (!pax.ParseRecord(rec.Left(eqPos), rec.Mid(eqPos + 1, rec.Len() - eqPos - 1)))
       return false;
-    if (IsString1PrefixedByString2(src.Ptr(pos + offset), "path="))
+  }
+  return !pax.SparseNumBytes_Expected;
+}
+
+static bool CheckSparseBlocks(const CItemEx &item)
+{
+  UInt64 min = 0;
+  UInt64 packSize = 0;
+  FOR_VECTOR (i, item.SparseBlocks)
+  {
+    const CSparseBlock &sb = item.SparseBlocks[i];
+    if (sb.Offset < min || sb.Offset > item.Size)
+      return false;
+    min = sb.Offset + sb.Size;
+    if (min < sb.Offset || min > item.Size)
+      return false;
+    packSize += sb.Size;
+  }
+  return packSize <= item.PackSize;
+}
+
+/*
+  GNU sparse format 1.0 stores the map at the start of data in decimal numbers,
+  each followed by '\n': the number of blocks, then offset and size for each block.
+  The map is padded to 512 bytes. We move it from data to header.
+*/
+
+static HRESULT ReadSparseMap(ISequentialInStream *stream, CItemEx &item, EErrorType &error)
+{
+  error = k_ErrorType_Corrupted;
+  char buf[NFileHeader::kRecordSize];
+  CSparseBlock sb;
+  UInt64 numBlocks = 0;
+  UInt64 numValues = 0;
+  UInt64 val = 0;
+  unsigned numDigits = 0;
+  
+  for (;;)
+  {
+    if (item.PackSize < NFileHeader::kRecordSize)
+      return S_OK;
+    size_t processedSize = NFileHeader::kRecordSize;
+    RINOK(ReadStream(stream, buf, &processedSize));
+    if (processedSize != NFileHeader::kRecordSize)
     {
-      offset += 5; // "path="
-      dest = src.Mid(pos + offset, lineLen - offset);
-      if (dest.IsEmpty())
-        return false;
-      if (dest.Back() != '\n')
-        return false;
-      dest.DeleteBack();
-      return true;
+      error = k_ErrorType_UnexpectedEnd;
+      return S_OK;
+    }
+    item.HeaderSize += NFileHeader::kRecordSize;
+    item.PackSize -= NFileHeader::kRecordSize;
+
+    for (unsigned i = 0; i < NFileHeader::kRecordSize; i++)
+    {
+      const char c = buf[i];
+      if (c != '\n')
+      {
+        if (c < '0' || c > '9' || numDigits >= 19)
+          return S_OK;
+        val = val * 10 + (unsigned)(c - '0');
+        numDigits++;
+        continue;
+      }
+      if (numDigits == 0)
+        return S_OK;
+      if (numValues == 0)
+      {
+        // each block requires 4 bytes in map at least
+        if (val > (item.PackSize + NFileHeader::kRecordSize) / 4)
+          return S_OK;
+        numBlocks = val;
+      }
+      else if ((numValues & 1) != 0)
+        sb.Offset = val;
+      else
+      {
+        sb.Size = val;
+        item.SparseBlocks.Add(sb);
+      }
+      numValues++;
+      val = 0;
+      numDigits = 0;
+      if (numValues == numBlocks * 2 + 1)
+      {
+        error = k_ErrorType_OK;
+        return S_OK;
+      }
     }
-    pos += lineLen;
   }
 }
 
 HRESULT ReadItem(ISequentialInStream *stream, bool &filled, CItemEx &item, EErrorType &error)
 {
   item.HeaderSize = 0;
+  item.SparseBlocks.Clear();
 
   bool flagL = false;
   bool flagK = false;
@@ -441,7 +638,8 @@ HRESULT ReadItem(ISequentialInStream *stream, bool &filled, CItemEx &item, EErro
       case 'X':
       {
         // pax Extended Header
-        if (item.Name.IsPrefixedBy("PaxHeader/"))
+        if ((item.LinkFlag == 'x' || item.Name.IsPrefixedBy("PaxHeader/"))
+            && item.PackSize <= (1 << 24))
         {
           RINOK(ReadDataToString(stream, item, pax, error));
           if (error != k_ErrorType_OK)
@@ -482,11 +680,59 @@ HRESULT ReadItem(ISequentialInStream *stream, bool &filled, CItemEx &item, EErro
 
     if (!pax.IsEmpty())
     {
-      AString name;
-      if (ParsePaxLongName(pax, name))
-        item.Name = name;
-      else
+      CPaxInfo paxInfo;
+      const bool paxIsOK = ParsePax(pax, paxInfo);
+      if (!paxInfo.Path.IsEmpty())
+        item.Name = paxInfo.Path;
+      if (!paxInfo.SparseName.IsEmpty())
+        item.Name = paxInfo.SparseName;
+      if (!paxIsOK)
         error = k_ErrorType_Warning;
+      
+      if (paxIsOK && paxInfo.IsSparse())
+      {
+        filled = false;
+        if (!paxInfo.SparseSize_Defined ||
+            (item.LinkFlag != NFileHeader::NLinkFlag::kNormal &&
+             item.LinkFlag != NFileHeader::NLinkFlag::kOldNormal))
+        {
+          error = k_ErrorType_Corrupted;
+          return S_OK;
+        }
+        item.Size = paxInfo.SparseSize;
+        if (paxInfo.SparseMajor_Defined && paxInfo.SparseMajor != 0)
+        {
+          if (paxInfo.SparseMajor != 1)
+          {
+            error = k_ErrorType_Corrupted;
+            return S_OK;
+          }
+          EErrorType mapError;
+          RINOK(ReadSparseMap(stream, item, mapError));
+          if (mapError != k_ErrorType_OK)
+          {
+            error = mapError;
+            return S_OK;
+          }
+        }
+        else
+        {
+          item.SparseBlocks = paxInfo.SparseBlocks;
+          if (paxInfo.SparseNumBlocks_Defined && paxInfo.SparseNumBlocks != item.SparseBlocks.Size())
+          {
+            error = k_ErrorType_Corrupted;
+            return S_OK;
+          }
+        }
+        if (!CheckSparseBlocks(item))
+        {
+          error = k_ErrorType_Corrupted;
+          return S_OK;
+        }
+        // we store such item as GNU sparse item ('S'), if archive is updated
+        item.LinkFlag = NFileHeader::NLinkFlag::kSparse;
+        filled = true;
+      }
     }
 
     return S_OK;
@@ -106,7 +106,8 @@ HRESULT COutArchive::WriteHeaderReal(const CItem &item)
   RETURN_IF_NOT_TRUE(CopyString(cur, item.LinkName, NFileHeader::kNameSize));
   cur += NFileHeader::kNameSize;
 
-  memcpy(cur, item.Magic, 8);
+  // GNU tar reads sparse map of 'S' item only from header with GNU magic
+  memcpy(cur, item.IsSparse() ? NFileHeader::NMagic::kGnuTar : item.Magic, 8);
   cur += 8;
 
   RETURN_IF_NOT_TRUE(CopyString(cur, item.User, NFileHeader::kUserNameSize));
@@ -231,6 +232,21 @@ HRESULT COutArchive::FillDataResidual(UInt64 dataSize)
   return WriteBytes(buf, rem);
 }
 
+HRESULT COutArchive::WriteZeros(UInt64 size)
+{
+  Byte buf[NFileHeader::kRecordSize];
+  memset(buf, 0, NFileHeader::kRecordSize);
+  while (size != 0)
+  {
+    unsigned cur = NFileHeader::kRecordSize;
+    if (cur > size)
+      cur = (unsigned)size;
+    RINOK(WriteBytes(buf, cur));
+    size -= cur;
+  }
+  return S_OK;
+}
+
 HRESULT COutArchive::WriteFinishHeader()
 {
   Byte record[NFileHeader::kRecordSize];
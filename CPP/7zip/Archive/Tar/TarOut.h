@@ -28,6 +28,7 @@ public:
 
   HRESULT WriteHeader(const CItem &item);
   HRESULT FillDataResidual(UInt64 dataSize);
+  HRESULT WriteZeros(UInt64 size);
   HRESULT WriteFinishHeader();
 };
 
@@ -18,6 +18,59 @@ namespace NTar {
 HRESULT GetPropString(IArchiveUpdateCallback *callback, UInt32 index, PROPID propId,
     AString &res, UINT codePage, bool convertSlash = false);
 
+/* If the file has holes, we store it as GNU sparse item ('S'):
+   only data ranges are stored, and the map of ranges is stored in header. */
+
+static HRESULT GetSparseBlocks(ISequentialInStream *stream, CItem &item)
+{
+  CMyComPtr<IStreamGetDataRange> getRange;
+  stream->QueryInterface(IID_IStreamGetDataRange, (void **)&getRange);
+  CMyComPtr<IInStream> seekStream;
+  stream->QueryInterface(IID_IInStream, (void **)&seekStream);
+  if (!getRange || !seekStream)
+    return S_OK;
+
+  CRecordVector<CSparseBlock> blocks;
+  UInt64 packSize = 0;
+  
+  for (UInt64 pos = 0; pos < item.Size;)
+  {
+    CSparseBlock sb;
+    HRESULT res = getRange->GetDataRange(pos, &sb.Offset, &sb.Size);
+    if (res == S_FALSE)
+      return S_OK;
+    RINOK(res);
+    if (sb.Offset < pos)
+      return S_OK;
+    if (sb.Offset >= item.Size)
+      break;
+    if (sb.Size > item.Size - sb.Offset)
+      sb.Size = item.Size - sb.Offset;
+    if (sb.Size == 0)
+      return S_OK;
+    blocks.Add(sb);
+    packSize += sb.Size;
+    pos = sb.Offset + sb.Size;
+  }
+
+  if (packSize == item.Size)
+    return S_OK;
+  
+  // GNU tar adds empty block at the end, if the file ends with hole
+  if (blocks.IsEmpty() || blocks.Back().Offset + blocks.Back().Size != item.Size)
+  {
+    CSparseBlock sb;
+    sb.Offset = item.Size;
+    sb.Size = 0;
+    blocks.Add(sb);
+  }
+  
+  item.SparseBlocks = blocks;
+  item.PackSize = packSize;
+  item.LinkFlag = NFileHeader::NLinkFlag::kSparse;
+  return S_OK;
+}
+
 HRESULT UpdateArchive(IInStream *inStream, ISequentialOutStream *outStream,
     const CObjectVector<NArchive::NTar::CItemEx> &inputItems,
     const CObjectVector<CUpdateItem> &updateItems,
@@ -172,11 +225,32 @@ HRESULT UpdateArchive(IInStream *inStream, ISequentialOutStream *outStream,
         }
       }
 
+      if (needWrite && fileInStream && item.Size != 0)
+      {
+        RINOK(GetSparseBlocks(fileInStream, item));
+      }
+
       if (needWrite)
       {
         UInt64 fileHeaderStartPos = outArchive.Pos;
         RINOK(outArchive.WriteHeader(item));
-        if (fileInStream)
+        if (fileInStream && item.IsSparse())
+        {
+          CMyComPtr<IInStream> seekStream;
+          fileInStream.QueryInterface(IID_IInStream, &seekStream);
+          FOR_VECTOR (k, item.SparseBlocks)
+          {
+            const CSparseBlock &sb = item.SparseBlocks[k];
+            lps->InSize = lps->OutSize = complexity + sb.Offset;
+            RINOK(seekStream->Seek(sb.Offset, STREAM_SEEK_SET, NULL));
+            RINOK(copyCoder->Code(fileInStream, outStream, NULL, &sb.Size, progress));
+            outArchive.Pos += copyCoderSpec->TotalSize;
+            // the file was truncated after we had read the map. We write zeros, as GNU tar does.
+            RINOK(outArchive.WriteZeros(sb.Size - copyCoderSpec->TotalSize));
+          }
+          RINOK(outArchive.FillDataResidual(item.PackSize));
+        }
+        else if (fileInStream)
         {
           RINOK(copyCoder->Code(fileInStream, outStream, NULL, NULL, progress));
           outArchive.Pos += copyCoderSpec->TotalSize;
@@ -196,7 +270,7 @@ HRESULT UpdateArchive(IInStream *inStream, ISequentialOutStream *outStream,
         }
       }
       
-      complexity += item.PackSize;
+      complexity += (item.IsSparse() ? item.Size : item.PackSize);
       RINOK(updateCallback->SetOperationResult(NArchive::NUpdate::NOperationResult::kOK));
     }
     else
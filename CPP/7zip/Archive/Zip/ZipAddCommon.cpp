@@ -179,6 +179,7 @@ HRESULT CAddCommon::Set_Pre_CompressionResult(bool inSeqMode, bool outSeqMode, U
     case NCompressionMethod::kXz   : ver = NCompressionMethod::kExtractVersion_Xz; break;
     case NCompressionMethod::kPPMd : ver = NCompressionMethod::kExtractVersion_PPMd; break;
     case NCompressionMethod::kBZip2: ver = NCompressionMethod::kExtractVersion_BZip2; break;
+    case NCompressionMethod::kZstd : ver = NCompressionMethod::kExtractVersion_Zstd; break;
     case NCompressionMethod::kLZMA :
     {
       ver = NCompressionMethod::kExtractVersion_LZMA;
@@ -377,6 +378,10 @@ HRESULT CAddCommon::Compress(
               methodId = kMethodId_BZip2;
               _compressExtractVersion = NCompressionMethod::kExtractVersion_BZip2;
               break;
+            case NCompressionMethod::kZstd:
+              methodId = kMethodId_ZSTD;
+              _compressExtractVersion = NCompressionMethod::kExtractVersion_Zstd;
+              break;
             default:
               _compressExtractVersion = ((method == NCompressionMethod::kDeflate64) ?
                   NCompressionMethod::kExtractVersion_Deflate64 :
@@ -412,6 +417,17 @@ HRESULT CAddCommon::Compress(
               }
             }
           }
+          if (method == NCompressionMethod::kZstd)
+          {
+            // zip readers expect plain zstd frames without zstdmt skippable frames
+            CMyComPtr<ICompressSetCoderPropertiesOpt> optProps;
+            _compressEncoder->QueryInterface(IID_ICompressSetCoderPropertiesOpt, (void **)&optProps);
+            if (!optProps)
+              return E_NOTIMPL;
+            PROPID propID = NCoderPropID::kStandardFrame;
+            NWindows::NCOM::CPropVariant prop = true;
+            RINOK(optProps->SetCoderPropertiesOpt(&propID, &prop, 1));
+          }
           if (method == NCompressionMethod::kLZMA)
             _isLzmaEos = _lzmaEncoder->EncoderSpec->IsWriteEndMark();
         }
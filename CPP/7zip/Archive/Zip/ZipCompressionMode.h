@@ -16,6 +16,7 @@ namespace NZip {
 
 const CMethodId kMethodId_ZipBase = 0x040100;
 const CMethodId kMethodId_BZip2   = 0x040202;
+const CMethodId kMethodId_ZSTD    = 0x4F71101;
 
 struct CBaseProps: public CMultiMethodProps
 {
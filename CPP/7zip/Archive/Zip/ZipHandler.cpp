@@ -2,7 +2,10 @@
 
 #include "StdAfx.h"
 
+#include "../../../../C/Sort.h"
+
 #include "../../../Common/ComTry.h"
+#include "../../../Common/Defs.h"
 #include "../../../Common/StringConvert.h"
 
 #include "../../../Windows/PropVariant.h"
@@ -17,6 +20,12 @@
 #include "../../Common/StreamObjects.h"
 #include "../../Common/StreamUtils.h"
 
+#ifndef _7ZIP_ST
+#include "../../../Windows/System.h"
+
+#include "../../Common/VirtThread.h"
+#endif
+
 #include "../../Compress/CopyCoder.h"
 #include "../../Compress/LzmaDecoder.h"
 #include "../../Compress/ImplodeDecoder.h"
@@ -86,7 +95,9 @@ const char * const kMethodNames1[kNumMethodNames1] =
 
 const char * const kMethodNames2[kNumMethodNames2] =
 {
-    "xz"
+    "zstd"
+  , NULL // "MP3"
+  , "xz"
   , "Jpeg"
   , "WavPack"
   , "PPMd"
@@ -183,7 +194,7 @@ static const Byte kArcProps[] =
   kpidNumVolumes
 };
 
-CHandler::CHandler()
+CHandler::CHandler(): _itemIndex(-1)
 {
   InitMethodProps();
 }
@@ -315,15 +326,36 @@ STDMETHODIMP CHandler::GetArchiveProperty(PROPID propID, PROPVARIANT *value)
 
 STDMETHODIMP CHandler::GetNumberOfItems(UInt32 *numItems)
 {
-  *numItems = m_Items.Size();
+  // in sequential mode the number of items is unknown before extraction
+  *numItems = (m_Archive.IsSeqMode() ? (UInt32)(Int32)-1 : m_Items.Size());
   return S_OK;
 }
 
+const CItemEx &CHandler::GetItem(unsigned index)
+{
+  if (_itemIndex != (int)index)
+  {
+    _itemIndex = -1;
+    m_Items.Get(index, _item);
+    _itemIndex = index;
+  }
+  return _item;
+}
+
+void CHandler::GetItemPath(unsigned index, UString &path)
+{
+  const CItemEx &item = GetItem(index);
+  item.GetUnicodeString(path, item.Name, false, _forceCodePage, _specifiedCodePage);
+  NItemName::ReplaceToOsSlashes_Remove_TailSlash(path);
+}
+
 STDMETHODIMP CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *value)
 {
   COM_TRY_BEGIN
   NWindows::NCOM::CPropVariant prop;
-  const CItemEx &item = m_Items[index];
+  if (index >= m_Items.Size())
+    return E_INVALIDARG;
+  const CItemEx &item = GetItem(index);
   const CExtraBlock &extra = item.GetMainExtra();
   
   switch (propID)
@@ -331,8 +363,7 @@ STDMETHODIMP CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
     case kpidPath:
     {
       UString res;
-      item.GetUnicodeString(res, item.Name, false, _forceCodePage, _specifiedCodePage);
-      NItemName::ReplaceToOsSlashes_Remove_TailSlash(res);
+      GetItemPath(index, res);
       prop = res;
       break;
     }
@@ -623,14 +654,145 @@ STDMETHODIMP CHandler::Open(IInStream *inStream,
   COM_TRY_END
 }
 
+STDMETHODIMP CHandler::OpenSeq(ISequentialInStream *stream)
+{
+  COM_TRY_BEGIN
+  Close();
+  HRESULT res = m_Archive.OpenSeq(stream);
+  if (res != S_OK)
+    m_Archive.ClearRefs();
+  return res;
+  COM_TRY_END
+}
+
 STDMETHODIMP CHandler::Close()
 {
+  ClearNameIndex();
+  _itemIndex = -1;
   m_Items.Clear();
   m_Archive.Close();
   return S_OK;
 }
 
 
+/*
+  Name index: the chains of items with same hash of path.
+  Hash is case insensitive, and the hashes of directory prefixes of paths
+  are calculated in same pass. So exact path requests don't need full scan of items.
+*/
+
+static const UInt32 kPathHash_Init = 0x811C9DC5;
+
+static inline UInt32 PathHash_Update(UInt32 h, wchar_t c)
+{
+  return (h ^ (UInt32)MyCharUpper(c)) * 0x01000193;
+}
+
+static UInt32 GetPathHash(const wchar_t *s)
+{
+  UInt32 h = kPathHash_Init;
+  for (; *s != 0; s++)
+    h = PathHash_Update(h, *s);
+  return h;
+}
+
+void CHandler::ClearNameIndex()
+{
+  _nameIndexIsBuilt = false;
+  _nameHashHeads.Clear();
+  _nameHashNext.Clear();
+  _dirPrefixHashes.Clear();
+}
+
+void CHandler::BuildNameIndex()
+{
+  ClearNameIndex();
+  
+  const unsigned numItems = m_Items.Size();
+  unsigned numHeads = 1;
+  while (numHeads < numItems && numHeads < ((unsigned)1 << 30))
+    numHeads <<= 1;
+  _nameHashHeads.ClearAndSetSize(numHeads);
+  memset(&_nameHashHeads[0], 0, numHeads * sizeof(UInt32));
+  _nameHashNext.ClearAndSetSize(numItems);
+
+  UString path;
+  UInt32 prevDirHash = 0;
+  
+  // we add items in reverse order. So the items in each chain are sorted by index.
+  for (unsigned i = numItems; i != 0;)
+  {
+    i--;
+    GetItemPath(i, path);
+    UInt32 h = kPathHash_Init;
+    for (unsigned k = 0; k < path.Len(); k++)
+    {
+      const wchar_t c = path[k];
+      if (IS_PATH_SEPAR(c) && k != 0)
+      {
+        // neighbour items usually are in same directory
+        if (_dirPrefixHashes.IsEmpty() || h != prevDirHash)
+          _dirPrefixHashes.Add(h);
+        prevDirHash = h;
+      }
+      h = PathHash_Update(h, c);
+    }
+    UInt32 &head = _nameHashHeads[h & (numHeads - 1)];
+    _nameHashNext[i] = head;
+    head = (UInt32)i + 1;
+  }
+
+  {
+    const unsigned num = _dirPrefixHashes.Size();
+    if (num > 1)
+    {
+      HeapSort(&_dirPrefixHashes[0], num);
+      unsigned k = 1;
+      for (unsigned i = 1; i < num; i++)
+        if (_dirPrefixHashes[i] != _dirPrefixHashes[k - 1])
+          _dirPrefixHashes[k++] = _dirPrefixHashes[i];
+      _dirPrefixHashes.DeleteFrom(k);
+    }
+  }
+
+  _nameIndexIsBuilt = true;
+}
+
+STDMETHODIMP CHandler::FindItem(const wchar_t *path, UInt32 startIndex, UInt32 *index)
+{
+  COM_TRY_BEGIN
+  *index = (UInt32)(Int32)-1;
+  if (!_nameIndexIsBuilt)
+    BuildNameIndex();
+  const UInt32 h = GetPathHash(path);
+  UString itemPath;
+  for (UInt32 next = _nameHashHeads[h & (_nameHashHeads.Size() - 1)]; next != 0; next = _nameHashNext[next - 1])
+  {
+    const UInt32 i = next - 1;
+    if (i < startIndex)
+      continue;
+    GetItemPath(i, itemPath);
+    if (MyStringCompareNoCase(itemPath, path) == 0)
+    {
+      *index = i;
+      return S_OK;
+    }
+  }
+  return S_FALSE;
+  COM_TRY_END
+}
+
+STDMETHODIMP CHandler::IsDirPrefix(const wchar_t *path, Int32 *isDirPrefix)
+{
+  COM_TRY_BEGIN
+  if (!_nameIndexIsBuilt)
+    BuildNameIndex();
+  *isDirPrefix = BoolToInt(_dirPrefixHashes.FindInSorted(GetPathHash(path)) >= 0);
+  return S_OK;
+  COM_TRY_END
+}
+
+
 class CLzmaDecoder:
   public ICompressCoder,
   public ICompressSetFinishMode,
@@ -723,6 +885,9 @@ class CZipDecoder
 
   CLzmaDecoder *lzmaDecoderSpec;
 public:
+  // if (PackDataStream), packed data of item is read from that stream instead of archive
+  CMyComPtr<ISequentialInStream> PackDataStream;
+
   CZipDecoder():
       _zipCryptoDecoderSpec(0),
       _pkAesDecoderSpec(0),
@@ -782,6 +947,26 @@ HRESULT CZipDecoder::Decode(
   
   unsigned id = item.Method;
 
+  /* In sequential mode the size of packed data is unknown, if it's stored only
+     in data descriptor after packed data. Then the decoder must find the end of data. */
+  bool seqUnknownSize = (archive.IsSeqMode() && !PackDataStream
+      && item.HasDescriptor() && item.PackSize == 0);
+
+  if (seqUnknownSize && !item.IsEncrypted() && id == NFileHeader::NCompressionMethod::kStore)
+  {
+    // empty item: data descriptor follows local header
+    bool isDescriptor = false;
+    RINOK(archive.CheckSeqSignature(NSignature::kDataDescriptor, isDescriptor));
+    if (isDescriptor)
+      seqUnknownSize = false;
+  }
+
+  if (seqUnknownSize && (item.IsEncrypted() || id == NFileHeader::NCompressionMethod::kStore))
+  {
+    res = NExtract::NOperationResult::kUnsupportedMethod;
+    return S_OK;
+  }
+
   if (item.IsEncrypted())
   {
     if (item.IsStrongEncrypted())
@@ -822,14 +1007,19 @@ HRESULT CZipDecoder::Decode(
         return S_OK;
       packSize -= NCrypto::NWzAes::kMacSize;
     }
-    RINOK(archive.GetItemStream(item, true, packStream));
+    if (PackDataStream)
+      packStream = PackDataStream;
+    else
+    {
+      RINOK(archive.GetItemStream(item, true, packStream));
+    }
     if (!packStream)
     {
       res = NExtract::NOperationResult::kUnavailable;
       return S_OK;
     }
     limitedStreamSpec->SetStream(packStream);
-    limitedStreamSpec->Init(packSize);
+    limitedStreamSpec->Init(seqUnknownSize ? (UInt64)(Int64)-1 : packSize);
   }
 
   
@@ -952,6 +1142,8 @@ HRESULT CZipDecoder::Decode(
       CMethodId szMethodID;
       if (id == NFileHeader::NCompressionMethod::kBZip2)
         szMethodID = kMethodId_BZip2;
+      else if (id == NFileHeader::NCompressionMethod::kZstd)
+        szMethodID = kMethodId_ZSTD;
       else
       {
         if (id > 0xFF)
@@ -974,7 +1166,21 @@ HRESULT CZipDecoder::Decode(
   }
 
   ICompressCoder *coder = methodItems[m].Coder;
+
+  if (seqUnknownSize)
+  {
+    // we need the size of processed packed data to find data descriptor
+    CMyComPtr<ICompressGetInStreamProcessedSize> getInStreamProcessedSize;
+    coder->QueryInterface(IID_ICompressGetInStreamProcessedSize, (void **)&getInStreamProcessedSize);
+    if (!getInStreamProcessedSize)
+    {
+      res = NExtract::NOperationResult::kUnsupportedMethod;
+      return S_OK;
+    }
+  }
   
+  // the properties of zstd decoder are 7z coder properties (version and level), not zip flags
+  if (id != NFileHeader::NCompressionMethod::kZstd)
   {
     CMyComPtr<ICompressSetDecoderProperties2> setDecoderProperties;
     coder->QueryInterface(IID_ICompressSetDecoderProperties2, (void **)&setDecoderProperties);
@@ -1004,6 +1210,7 @@ HRESULT CZipDecoder::Decode(
   bool dataAfterEnd = false;
   bool truncatedError = false;
   bool lzmaEosError = false;
+  UInt64 packProcessed = (UInt64)(Int64)-1;
 
   {
     HRESULT result = S_OK;
@@ -1100,7 +1307,7 @@ HRESULT CZipDecoder::Decode(
       
       const UInt64 coderPackSize = limitedStreamSpec->GetRem();
 
-      bool useUnpackLimit = (id == 0
+      bool useUnpackLimit = !seqUnknownSize && (id == 0
           || !item.HasDescriptor()
           || item.Size >= ((UInt64)1 << 32)
           || item.LocalExtra.IsZip64
@@ -1121,6 +1328,7 @@ HRESULT CZipDecoder::Decode(
         {
           UInt64 processed;
           RINOK(getInStreamProcessedSize->GetInStreamProcessedSize(&processed));
+          packProcessed = processed;
           if (processed != (UInt64)(Int64)-1)
           {
             if (pkAesMode)
@@ -1169,8 +1377,6 @@ HRESULT CZipDecoder::Decode(
 
   bool crcOK = true;
   bool authOk = true;
-  if (needCRC)
-    crcOK = (outStreamSpec->GetCRC() == item.Crc);
   
   if (wzAesMode)
   {
@@ -1186,6 +1392,44 @@ HRESULT CZipDecoder::Decode(
       authOk = false;
   }
 
+  UInt32 crc = item.Crc;
+  bool seqHeadersError = false;
+
+  if (archive.IsSeqMode() && !PackDataStream)
+  {
+    // we move to the end of packed data and we read data descriptor
+    UInt64 packSize = item.PackSize;
+    if (seqUnknownSize)
+    {
+      if (packProcessed == (UInt64)(Int64)-1)
+        return S_OK;
+      packSize = packProcessed;
+    }
+    RINOK(archive.FinishSeqItem(item, packSize));
+    const CSeqItemInfo &seqItem = archive.SeqItem;
+    if (!seqItem.IsFinished)
+    {
+      res = NExtract::NOperationResult::kHeadersError;
+      return S_OK;
+    }
+    if (item.HasDescriptor())
+    {
+      if (!seqItem.DescriptorWasRead)
+      {
+        res = NExtract::NOperationResult::kUnexpectedEnd;
+        return S_OK;
+      }
+      crc = seqItem.Crc;
+      const UInt64 outSize = outStreamSpec->GetSize();
+      if (seqItem.DescriptorError
+          || seqItem.Size != (item.LocalExtra.IsZip64 ? outSize : (UInt32)outSize))
+        seqHeadersError = true;
+    }
+  }
+
+  if (needCRC)
+    crcOK = (outStreamSpec->GetCRC() == crc);
+
   res = NExtract::NOperationResult::kCRCError;
 
   if (crcOK && authOk)
@@ -1196,7 +1440,7 @@ HRESULT CZipDecoder::Decode(
       res = NExtract::NOperationResult::kDataAfterEnd;
     else if (truncatedError)
       res = NExtract::NOperationResult::kUnexpectedEnd;
-    else if (lzmaEosError)
+    else if (lzmaEosError || seqHeadersError)
       res = NExtract::NOperationResult::kHeadersError;
 
     // CheckDescriptor() supports only data descriptor with signature and
@@ -1212,10 +1456,289 @@ HRESULT CZipDecoder::Decode(
 }
 
 
+#ifndef _7ZIP_ST
+
+/*
+  Parallel extraction.
+  The main thread reads packed data of next items to memory,
+  and additional threads decode these items to memory.
+  The main thread writes decoded data and results to IArchiveExtractCallback
+  in original order. Encrypted items (they need password callback),
+  directories and items that are larger than memory limit are decoded
+  by main thread as before.
+  While the main thread waits for an item, it reports the progress
+  of the thread that decodes that item.
+*/
+
+static const DWORD kThreadProgressInterval = 200; // in ms
+
+class CItemDecodeThread;
+
+class CItemDecodeProgress:
+  public ICompressProgressInfo,
+  public CMyUnknownImp
+{
+public:
+  CItemDecodeThread *Thread;
+  MY_UNKNOWN_IMP1(ICompressProgressInfo)
+  STDMETHOD(SetRatioInfo)(const UInt64 *inSize, const UInt64 *outSize);
+};
+
+class CItemDecodeThread: public CVirtThread
+{
+public:
+  CZipDecoder Decoder;
+  CMyComPtr<ISequentialInStream> PackStream;
+  CBufInStream *PackStreamSpec;
+  CMyComPtr<ISequentialOutStream> OutStream;
+  CBufPtrSeqOutStream *OutStreamSpec;
+  
+  CByteBuffer PackBuf;
+  CByteBuffer OutBuf;
+  
+  CInArchive *Archive;
+  CItemEx Item;
+  bool HeadersError;
+  bool TestMode;
+  UInt32 ItemIndex; // index in (indices) list
+
+  HRESULT Result;
+  Int32 OpRes;
+
+  // the progress of decoding is protected by CS
+  NWindows::NSynchronization::CCriticalSection CS;
+  UInt64 InProcessed;
+  UInt64 OutProcessed;
+  bool Stop;
+  CMyComPtr<ICompressProgressInfo> Progress;
+
+  DECL_EXTERNAL_CODECS_LOC_VARS2;
+
+  CItemDecodeThread(): InProcessed(0), OutProcessed(0), Stop(false)
+  {
+    PackStreamSpec = new CBufInStream;
+    PackStream = PackStreamSpec;
+    OutStreamSpec = new CBufPtrSeqOutStream;
+    OutStream = OutStreamSpec;
+    CItemDecodeProgress *progressSpec = new CItemDecodeProgress;
+    Progress = progressSpec;
+    progressSpec->Thread = this;
+  }
+  ~CItemDecodeThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute();
+
+  UInt64 GetBufSize() const { return PackBuf.Size() + OutBuf.Size(); }
+  
+  void GetProgress(UInt64 &inSize, UInt64 &outSize)
+  {
+    NWindows::NSynchronization::CCriticalSectionLock lock(CS);
+    inSize = InProcessed;
+    outSize = OutProcessed;
+  }
+  
+  void SetStop()
+  {
+    NWindows::NSynchronization::CCriticalSectionLock lock(CS);
+    Stop = true;
+  }
+};
+
+STDMETHODIMP CItemDecodeProgress::SetRatioInfo(const UInt64 *inSize, const UInt64 *outSize)
+{
+  NWindows::NSynchronization::CCriticalSectionLock lock(Thread->CS);
+  if (inSize)
+    Thread->InProcessed = *inSize;
+  if (outSize)
+    Thread->OutProcessed = *outSize;
+  return Thread->Stop ? E_ABORT : S_OK;
+}
+
+void CItemDecodeThread::Execute()
+{
+  try
+  {
+    PackStreamSpec->Init(PackBuf, (size_t)Item.PackSize);
+    Decoder.PackDataStream = PackStream;
+    if (!TestMode)
+      OutStreamSpec->Init(OutBuf, (size_t)Item.Size);
+    OpRes = NExtract::NOperationResult::kDataError;
+    Result = Decoder.Decode(
+        EXTERNAL_CODECS_LOC_VARS
+        *Archive, Item,
+        TestMode ? NULL : (ISequentialOutStream *)OutStream,
+        NULL, // extractCallback is used only for encrypted items
+        Progress,
+        1,
+        OpRes);
+    Decoder.PackDataStream.Release();
+  }
+  catch(...)
+  {
+    Result = E_FAIL;
+  }
+}
+
+struct CItemDecodeThreads
+{
+  CObjectVector<CItemDecodeThread> Threads;
+  unsigned First;
+  unsigned NumRunning;
+  UInt32 NextItem;  // next item for planning
+  UInt64 MemUsage;  // the size of buffers of all threads (they are reused for next items)
+  UInt64 MaxMemUsage;
+
+  CItemDecodeThreads(): First(0), NumRunning(0), NextItem(0), MemUsage(0), MaxMemUsage(0) {}
+  ~CItemDecodeThreads()
+  {
+    // if extraction was aborted, we don't need the results of threads
+    FOR_VECTOR (i, Threads)
+      Threads[i].SetStop();
+  }
+
+  bool IsFirst(UInt32 item) const
+  {
+    return NumRunning != 0 && Threads[First].ItemIndex == item;
+  }
+
+  // we free the buffers that were allocated for big item to keep memory for other threads
+  void ReleaseBufs(CItemDecodeThread &thread)
+  {
+    const UInt64 bufSize = thread.GetBufSize();
+    if (bufSize > MaxMemUsage / Threads.Size())
+    {
+      MemUsage -= bufSize;
+      thread.PackBuf.Free();
+      thread.OutBuf.Free();
+    }
+  }
+};
+
+#endif
+
+
+/*
+  Sequential mode extraction (IArchiveOpenSeq).
+  Items are decoded in order of local headers, as they arrive in stream.
+  If the size of packed data is stored only in data descriptor,
+  we must decode item (even if it's not requested) to find the end of data.
+  (indices) must be sorted.
+*/
+
+HRESULT CHandler::ExtractSeq(const UInt32 *indices, UInt32 numItems,
+    Int32 testMode, IArchiveExtractCallback *extractCallback)
+{
+  CZipDecoder myDecoder;
+  const bool allFilesMode = (numItems == (UInt32)(Int32)-1);
+  UInt32 next = 0; // position in (indices)
+  UInt64 totalUnPacked = 0;
+  
+  CLocalProgress *lps = new CLocalProgress;
+  CMyComPtr<ICompressProgressInfo> progress = lps;
+  lps->Init(extractCallback, false);
+
+  for (;;)
+  {
+    lps->InSize = m_Archive.GetPhySize();
+    lps->OutSize = totalUnPacked;
+    RINOK(lps->SetCur());
+
+    if (!allFilesMode && next >= numItems)
+      break;
+
+    CItemEx item;
+    bool isLocal = false;
+    RINOK(m_Archive.ReadSeqLocalItem(item, isLocal));
+    if (!isLocal)
+    {
+      RINOK(m_Archive.ReadSeqCd(m_Items));
+      break;
+    }
+
+    m_Items.Add(item);
+    const UInt32 index = m_Items.Size() - 1;
+    bool isRequested = allFilesMode;
+    if (!allFilesMode && indices[next] == index)
+    {
+      isRequested = true;
+      next++;
+    }
+
+    CMyComPtr<ISequentialOutStream> realOutStream;
+    Int32 askMode = testMode ?
+        NExtract::NAskMode::kTest :
+        NExtract::NAskMode::kExtract;
+    
+    if (isRequested)
+    {
+      RINOK(extractCallback->GetStream(index, &realOutStream, askMode));
+      if (!testMode && !realOutStream && !item.IsDir())
+        askMode = NExtract::NAskMode::kSkip;
+      RINOK(extractCallback->PrepareOperation(askMode));
+    }
+
+    Int32 res = NExtract::NOperationResult::kOK;
+    const bool unknownSize = (item.HasDescriptor() && item.PackSize == 0 && !item.IsDir());
+
+    if (!item.IsDir() && (unknownSize || (isRequested && askMode != NExtract::NAskMode::kSkip)))
+    {
+      RINOK(myDecoder.Decode(
+          EXTERNAL_CODECS_VARS
+          m_Archive, item, realOutStream, extractCallback,
+          progress,
+          #ifndef _7ZIP_ST
+          1,
+          #endif
+          res));
+    }
+    realOutStream.Release();
+
+    // Decode() reads data descriptor, if item was decoded
+    if (!m_Archive.SeqItem.IsFinished && !unknownSize)
+    {
+      RINOK(m_Archive.FinishSeqItem(item, item.PackSize));
+      if (item.IsDir() && m_Archive.SeqItem.DescriptorError && res == NExtract::NOperationResult::kOK)
+        res = NExtract::NOperationResult::kHeadersError;
+    }
+
+    const CSeqItemInfo &seqItem = m_Archive.SeqItem;
+    if (seqItem.IsFinished)
+      item.PackSize = seqItem.PackSize;
+    if (seqItem.DescriptorWasRead)
+    {
+      item.Crc = seqItem.Crc;
+      item.Size = seqItem.Size;
+      item.DescriptorWasRead = true;
+    }
+    m_Items.Set(index, item);
+    if (_itemIndex == (int)index)
+      _itemIndex = -1;
+    totalUnPacked += item.Size;
+
+    if (isRequested)
+    {
+      RINOK(extractCallback->SetOperationResult(res));
+    }
+
+    if (!seqItem.IsFinished)
+    {
+      // we can't find the end of packed data, so we can't read next items
+      m_Archive.HeadersError = true;
+      break;
+    }
+  }
+
+  lps->InSize = m_Archive.GetPhySize();
+  lps->OutSize = totalUnPacked;
+  return lps->SetCur();
+}
+
+
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback)
 {
   COM_TRY_BEGIN
+  if (m_Archive.IsSeqMode())
+    return ExtractSeq(indices, numItems, testMode, extractCallback);
   CZipDecoder myDecoder;
   UInt64 totalUnPacked = 0, totalPacked = 0;
   bool allFilesMode = (numItems == (UInt32)(Int32)-1);
@@ -1226,7 +1749,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   UInt32 i;
   for (i = 0; i < numItems; i++)
   {
-    const CItemEx &item = m_Items[allFilesMode ? i : indices[i]];
+    const CCompactItem &item = m_Items[allFilesMode ? i : indices[i]];
     totalUnPacked += item.Size;
     totalPacked += item.PackSize;
   }
@@ -1239,6 +1762,35 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(extractCallback, false);
 
+  #ifndef _7ZIP_ST
+  
+  CItemDecodeThreads threads;
+  
+  if (_props._numThreads > 1 && numItems > 1)
+  {
+    UInt64 ramSize = (UInt64)(sizeof(size_t)) << 29;
+    NWindows::NSystem::GetRamSize(ramSize);
+    threads.MaxMemUsage = ramSize / 4;
+    
+    unsigned numThreads = _props._numThreads - 1;
+    if (numThreads > numItems - 1)
+      numThreads = numItems - 1;
+    threads.Threads.ClearAndReserve(numThreads);
+    
+    for (unsigned t = 0; t < numThreads; t++)
+    {
+      CItemDecodeThread &thread = threads.Threads.AddNewInReserved();
+      thread.Archive = &m_Archive;
+      thread.TestMode = (testMode != 0);
+      #ifdef EXTERNAL_CODECS
+      thread.__externalCodecs = EXTERNAL_CODECS_VARS2;
+      #endif
+      RINOK(thread.Create());
+    }
+  }
+  
+  #endif
+
   for (i = 0; i < numItems; i++,
       currentTotalUnPacked += currentItemUnPacked,
       currentTotalPacked += currentItemPacked)
@@ -1250,13 +1802,97 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     lps->OutSize = currentTotalUnPacked;
     RINOK(lps->SetCur());
 
+    #ifndef _7ZIP_ST
+    
+    if (threads.Threads.Size() != 0)
+    {
+      // we start decoding of next items that can be decoded to memory
+      
+      if (threads.NextItem <= i)
+        threads.NextItem = i + 1;
+      
+      while (threads.NumRunning < threads.Threads.Size() && threads.NextItem < numItems)
+      {
+        const UInt32 nextIndex = allFilesMode ? threads.NextItem : indices[threads.NextItem];
+        CItemEx nextItem;
+        m_Items.Get(nextIndex, nextItem);
+        
+        if (!nextItem.IsDir()
+            && !nextItem.IsEncrypted()
+            && nextItem.PackSize != 0
+            && m_Archive.IsLocalOffsetOK(nextItem))
+        {
+          CItemDecodeThread &thread = threads.Threads[(threads.First + threads.NumRunning) % threads.Threads.Size()];
+          const UInt64 memUsage = nextItem.PackSize + (testMode ? 0 : nextItem.Size);
+          const UInt64 bufSize = thread.GetBufSize();
+          const UInt64 newBufSize =
+              MyMax((UInt64)thread.PackBuf.Size(), nextItem.PackSize) +
+              (testMode ? thread.OutBuf.Size() : MyMax((UInt64)thread.OutBuf.Size(), nextItem.Size));
+          
+          if (newBufSize - bufSize > threads.MaxMemUsage - threads.MemUsage)
+          {
+            if (memUsage <= threads.MaxMemUsage)
+              break;
+          }
+          else
+          {
+            thread.Item = nextItem;
+            thread.HeadersError = false;
+            
+            bool isReady = true;
+            if (!thread.Item.FromLocal)
+            {
+              bool isAvail = true;
+              isReady = (m_Archive.ReadLocalItemAfterCdItem(thread.Item, isAvail, thread.HeadersError) == S_OK);
+            }
+            
+            if (isReady)
+            {
+              CMyComPtr<ISequentialInStream> packStream;
+              isReady = (m_Archive.GetItemStream(thread.Item, true, packStream) == S_OK && packStream);
+              if (isReady)
+              {
+                const size_t packSize = (size_t)thread.Item.PackSize;
+                threads.MemUsage -= thread.PackBuf.Size();
+                thread.PackBuf.AllocAtLeast(packSize);
+                threads.MemUsage += thread.PackBuf.Size();
+                size_t processed = packSize;
+                isReady = (ReadStream(packStream, thread.PackBuf, &processed) == S_OK && processed == packSize);
+              }
+            }
+            
+            // if item is not ready, the main thread will process it as usual
+            if (isReady)
+            {
+              if (!testMode)
+              {
+                threads.MemUsage -= thread.OutBuf.Size();
+                thread.OutBuf.AllocAtLeast((size_t)thread.Item.Size);
+                threads.MemUsage += thread.OutBuf.Size();
+              }
+              thread.ItemIndex = threads.NextItem;
+              thread.InProcessed = 0;
+              thread.OutProcessed = 0;
+              thread.Start();
+              threads.NumRunning++;
+            }
+          }
+        }
+        
+        threads.NextItem++;
+      }
+    }
+    
+    #endif
+
     CMyComPtr<ISequentialOutStream> realOutStream;
     Int32 askMode = testMode ?
         NExtract::NAskMode::kTest :
         NExtract::NAskMode::kExtract;
     UInt32 index = allFilesMode ? i : indices[i];
 
-    CItemEx item = m_Items[index];
+    CItemEx item;
+    m_Items.Get(index, item);
     bool isLocalOffsetOK = m_Archive.IsLocalOffsetOK(item);
     bool skip = !isLocalOffsetOK && !item.IsDir();
     if (skip)
@@ -1277,6 +1913,66 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
     bool headersError = false;
     
+    #ifndef _7ZIP_ST
+    
+    if (threads.IsFirst(i))
+    {
+      CItemDecodeThread &thread = threads.Threads[threads.First];
+      
+      for (;;)
+      {
+        const DWORD waitResult = ::WaitForSingleObject(thread.FinishedEvent, kThreadProgressInterval);
+        if (waitResult == WAIT_OBJECT_0)
+          break;
+        if (waitResult != WAIT_TIMEOUT)
+        {
+          const DWORD lastError = GetLastError();
+          return lastError != 0 ? lastError : E_FAIL;
+        }
+        UInt64 inSize, outSize;
+        thread.GetProgress(inSize, outSize);
+        lps->InSize = currentTotalPacked + inSize;
+        lps->OutSize = currentTotalUnPacked + outSize;
+        RINOK(lps->SetCur());
+      }
+      
+      threads.First = (threads.First + 1) % threads.Threads.Size();
+      threads.NumRunning--;
+      
+      if (!testMode && !realOutStream)
+      {
+        threads.ReleaseBufs(thread);
+        continue;
+      }
+      
+      item = thread.Item;
+      headersError = thread.HeadersError;
+
+      /* if the thread failed, we decode the item again in main thread.
+         So errors are reported in same way as without threads. */
+      
+      if (thread.Result == S_OK)
+      {
+        RINOK(extractCallback->PrepareOperation(askMode));
+        if (realOutStream)
+        {
+          RINOK(WriteStream(realOutStream, thread.OutBuf, thread.OutStreamSpec->GetPos()));
+          realOutStream.Release();
+        }
+        threads.ReleaseBufs(thread);
+        Int32 res = thread.OpRes;
+        if (res == NExtract::NOperationResult::kOK && headersError)
+          res = NExtract::NOperationResult::kHeadersError;
+        RINOK(extractCallback->SetOperationResult(res))
+        continue;
+      }
+      
+      threads.ReleaseBufs(thread);
+    }
+    else
+    
+    #endif
+    
     if (!item.FromLocal)
     {
       bool isAvail = true;
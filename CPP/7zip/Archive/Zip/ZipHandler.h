@@ -16,7 +16,7 @@ namespace NArchive {
 namespace NZip {
 
 const unsigned kNumMethodNames1 = NFileHeader::NCompressionMethod::kLZMA + 1;
-const unsigned kMethodNames2Start = NFileHeader::NCompressionMethod::kXz;
+const unsigned kMethodNames2Start = NFileHeader::NCompressionMethod::kZstd;
 const unsigned kNumMethodNames2 = NFileHeader::NCompressionMethod::kWzAES + 1 - kMethodNames2Start;
 
 extern const char * const kMethodNames1[kNumMethodNames1];
@@ -25,6 +25,8 @@ extern const char * const kMethodNames2[kNumMethodNames2];
 
 class CHandler:
   public IInArchive,
+  public IArchiveOpenSeq,
+  public IArchiveFindItem,
   public IOutArchive,
   public ISetProperties,
   PUBLIC_ISetCompressCodecsInfo
@@ -32,6 +34,8 @@ class CHandler:
 {
 public:
   MY_QUERYINTERFACE_BEGIN2(IInArchive)
+  MY_QUERYINTERFACE_ENTRY(IArchiveOpenSeq)
+  MY_QUERYINTERFACE_ENTRY(IArchiveFindItem)
   MY_QUERYINTERFACE_ENTRY(IOutArchive)
   MY_QUERYINTERFACE_ENTRY(ISetProperties)
   QUERY_ENTRY_ISetCompressCodecsInfo
@@ -39,6 +43,8 @@ public:
   MY_ADDREF_RELEASE
 
   INTERFACE_IInArchive(;)
+  STDMETHOD(OpenSeq)(ISequentialInStream *stream);
+  INTERFACE_IArchiveFindItem(;)
   INTERFACE_IOutArchive(;)
 
   STDMETHOD(SetProperties)(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps);
@@ -47,9 +53,28 @@ public:
 
   CHandler();
 private:
-  CObjectVector<CItemEx> m_Items;
+  CItems m_Items;
   CInArchive m_Archive;
 
+  // the last item restored from (m_Items) by GetItem()
+  int _itemIndex;
+  CItemEx _item;
+
+  const CItemEx &GetItem(unsigned index);
+
+  // hash index of item paths for IArchiveFindItem. It's created at first request.
+  bool _nameIndexIsBuilt;
+  CRecordVector<UInt32> _nameHashHeads; // (item index + 1) of first item in chain, or 0
+  CRecordVector<UInt32> _nameHashNext;  // (item index + 1) of next item in chain, or 0
+  CRecordVector<UInt32> _dirPrefixHashes; // sorted hashes of all directory prefixes of paths
+
+  void GetItemPath(unsigned index, UString &path);
+  void BuildNameIndex();
+  void ClearNameIndex();
+
+  HRESULT ExtractSeq(const UInt32 *indices, UInt32 numItems,
+      Int32 testMode, IArchiveExtractCallback *extractCallback);
+
   CBaseProps _props;
 
   int m_MainMethod;
@@ -74,6 +99,8 @@ private:
     m_ForceUtf8 = false;
     _forceCodePage = false;
     _specifiedCodePage = CP_OEMCP;
+    // item paths depend from code page
+    ClearNameIndex();
   }
 };
 
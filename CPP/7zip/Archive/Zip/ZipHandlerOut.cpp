@@ -131,7 +131,7 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
     bool existInArchive = (indexInArc != (UInt32)(Int32)-1);
     if (existInArchive)
     {
-      const CItemEx &inputItem = m_Items[indexInArc];
+      const CItemEx &inputItem = GetItem(indexInArc);
       if (inputItem.IsAesEncrypted())
         thereAreAesUpdates = true;
       if (!IntToBool(newProps))
@@ -354,6 +354,8 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
             return E_NOTIMPL;
           if (methodId == kMethodId_BZip2)
             mainMethod = NFileHeader::NCompressionMethod::kBZip2;
+          else if (methodId == kMethodId_ZSTD)
+            mainMethod = NFileHeader::NCompressionMethod::kZstd;
           else
           {
             if (methodId < kMethodId_ZipBase)
@@ -57,6 +57,8 @@ namespace NFileHeader
       kTerse = 18,
       kLz77 = 19,
       
+      kZstd = 93,
+      kMP3 = 94,
       kXz = 95,
       kJpeg = 96,
       kWavPack = 97,
@@ -77,6 +79,7 @@ namespace NFileHeader
     const Byte kExtractVersion_LZMA = 63;
     const Byte kExtractVersion_PPMd = 63;
     const Byte kExtractVersion_Xz = 20; // test it
+    const Byte kExtractVersion_Zstd = 63;
   }
 
   namespace NExtraID
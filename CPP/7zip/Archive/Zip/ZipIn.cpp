@@ -108,6 +108,197 @@ void CCdInfo::ParseEcd64e(const Byte *p)
 }
 
 
+static const size_t kItemsBlockSize = (size_t)1 << 20;
+
+void CItems::Clear()
+{
+  _records.Clear();
+  _blocks.Clear();
+  _blockPos = 0;
+}
+
+Byte *CItems::AllocData(size_t size, CCompactItem &rec)
+{
+  if (_blocks.IsEmpty() || _blocks.Back().Size() - _blockPos < size)
+  {
+    _blocks.AddNew().Alloc(MyMax(size, kItemsBlockSize));
+    _blockPos = 0;
+  }
+  rec.DataBlock = _blocks.Size() - 1;
+  rec.DataOffset = (UInt32)_blockPos;
+  _blockPos += size;
+  return (Byte *)_blocks.Back() + rec.DataOffset;
+}
+
+static unsigned GetExtraFlags(const CExtraBlock &extra)
+{
+  using namespace NCompactItemFlags;
+  return (extra.Error ? kExtraError : 0)
+      | (extra.MinorError ? kExtraMinorError : 0)
+      | (extra.IsZip64 ? kExtraIsZip64 : 0)
+      | (extra.IsZip64_Error ? kExtraIsZip64_Error : 0);
+}
+
+static void SetExtraFlags(CExtraBlock &extra, unsigned flags)
+{
+  using namespace NCompactItemFlags;
+  extra.Error = (flags & kExtraError) != 0;
+  extra.MinorError = (flags & kExtraMinorError) != 0;
+  extra.IsZip64 = (flags & kExtraIsZip64) != 0;
+  extra.IsZip64_Error = (flags & kExtraIsZip64_Error) != 0;
+}
+
+// subblocks are packed in same format as in zip headers: ID (16-bit), size (16-bit), data
+
+static Byte *PackExtra(const CExtraBlock &extra, Byte *p)
+{
+  FOR_VECTOR (i, extra.SubBlocks)
+  {
+    const CExtraSubBlock &sb = extra.SubBlocks[i];
+    const size_t size = sb.Data.Size();
+    SetUi16(p, (UInt16)sb.ID);
+    SetUi16(p + 2, (UInt16)size);
+    p += 4;
+    if (size != 0)
+      memcpy(p, sb.Data, size);
+    p += size;
+  }
+  return p;
+}
+
+static const Byte *UnpackExtra(const Byte *p, size_t size, CExtraBlock &extra)
+{
+  extra.SubBlocks.Clear();
+  const Byte *lim = p + size;
+  while (p != lim)
+  {
+    CExtraSubBlock &sb = extra.SubBlocks.AddNew();
+    sb.ID = Get16(p);
+    sb.Data.CopyFrom(p + 4, Get16(p + 2));
+    p += 4 + sb.Data.Size();
+  }
+  return p;
+}
+
+static void SetRecord(const CItemEx &item, CCompactItem &rec)
+{
+  rec.Size = item.Size;
+  rec.PackSize = item.PackSize;
+  rec.LocalHeaderPos = item.LocalHeaderPos;
+  rec.Time = item.Time;
+  rec.Crc = item.Crc;
+  rec.Disk = item.Disk;
+  rec.ExternalAttrib = item.ExternalAttrib;
+  rec.LocalFullHeaderSize = item.LocalFullHeaderSize;
+  
+  rec.NameLen = item.Name.Len();
+  rec.CommentLen = (UInt32)item.Comment.Size();
+  rec.LocalExtraSize = (UInt32)item.LocalExtra.GetSize();
+  rec.CentralExtraSize = (UInt32)item.CentralExtra.GetSize();
+  
+  rec.Flags = item.Flags;
+  rec.Method = item.Method;
+  rec.InternalAttrib = item.InternalAttrib;
+  rec.ExtractVersion = item.ExtractVersion;
+  rec.MadeByVersion = item.MadeByVersion;
+  
+  using namespace NCompactItemFlags;
+  rec.BoolFlags = (UInt16)(
+        (item.FromLocal ? kFromLocal : 0)
+      | (item.FromCentral ? kFromCentral : 0)
+      | (item.DescriptorWasRead ? kDescriptorWasRead : 0)
+      | GetExtraFlags(item.LocalExtra)
+      | (GetExtraFlags(item.CentralExtra) << kCentralShift));
+}
+
+static size_t GetDataSize(const CCompactItem &rec)
+{
+  return (size_t)rec.NameLen + rec.CommentLen + rec.LocalExtraSize + rec.CentralExtraSize;
+}
+
+void CItems::PackItem(const CItemEx &item, CCompactItem &rec, Byte *p)
+{
+  const size_t size = GetDataSize(rec);
+  if (size == 0)
+    return;
+  if (!p)
+    p = AllocData(size, rec);
+  memcpy(p, item.Name.Ptr(), rec.NameLen);
+  p += rec.NameLen;
+  if (rec.CommentLen != 0)
+    memcpy(p, item.Comment, rec.CommentLen);
+  p += rec.CommentLen;
+  p = PackExtra(item.LocalExtra, p);
+  PackExtra(item.CentralExtra, p);
+}
+
+void CItems::Add(const CItemEx &item)
+{
+  CCompactItem rec;
+  SetRecord(item, rec);
+  rec.DataBlock = 0;
+  rec.DataOffset = 0;
+  PackItem(item, rec, NULL);
+  _records.Add(rec);
+}
+
+void CItems::Set(unsigned index, const CItemEx &item)
+{
+  CCompactItem &rec = _records[index];
+  CCompactItem rec2;
+  SetRecord(item, rec2);
+  rec2.DataBlock = rec.DataBlock;
+  rec2.DataOffset = rec.DataOffset;
+  Byte *p = NULL;
+  if (rec2.NameLen == rec.NameLen
+      && rec2.CommentLen == rec.CommentLen
+      && rec2.LocalExtraSize == rec.LocalExtraSize
+      && rec2.CentralExtraSize == rec.CentralExtraSize
+      && GetDataSize(rec) != 0)
+    p = (Byte *)_blocks[rec.DataBlock] + rec.DataOffset;
+  PackItem(item, rec2, p);
+  rec = rec2;
+}
+
+void CItems::Get(unsigned index, CItemEx &item) const
+{
+  const CCompactItem &rec = _records[index];
+
+  item.Size = rec.Size;
+  item.PackSize = rec.PackSize;
+  item.LocalHeaderPos = rec.LocalHeaderPos;
+  item.Time = rec.Time;
+  item.Crc = rec.Crc;
+  item.Disk = rec.Disk;
+  item.ExternalAttrib = rec.ExternalAttrib;
+  item.LocalFullHeaderSize = rec.LocalFullHeaderSize;
+  
+  item.Flags = rec.Flags;
+  item.Method = rec.Method;
+  item.InternalAttrib = rec.InternalAttrib;
+  item.ExtractVersion = rec.ExtractVersion;
+  item.MadeByVersion = rec.MadeByVersion;
+  
+  using namespace NCompactItemFlags;
+  const unsigned flags = rec.BoolFlags;
+  item.FromLocal = (flags & kFromLocal) != 0;
+  item.FromCentral = (flags & kFromCentral) != 0;
+  item.DescriptorWasRead = (flags & kDescriptorWasRead) != 0;
+  SetExtraFlags(item.LocalExtra, flags);
+  SetExtraFlags(item.CentralExtra, flags >> kCentralShift);
+
+  const Byte *p = NULL;
+  if (GetDataSize(rec) != 0)
+    p = (const Byte *)_blocks[rec.DataBlock] + rec.DataOffset;
+  item.Name.SetFrom((const char *)p, rec.NameLen);
+  p += rec.NameLen;
+  item.Comment.CopyFrom(p, rec.CommentLen);
+  p += rec.CommentLen;
+  p = UnpackExtra(p, rec.LocalExtraSize, item.LocalExtra);
+  UnpackExtra(p, rec.CentralExtraSize, item.CentralExtra);
+}
+
+
 struct CLocator
 {
   UInt32 Ecd64Disk;
@@ -135,6 +326,7 @@ struct CLocator
 void CInArchive::ClearRefs()
 {
   StreamRef.Release();
+  _seqStream.Release();
   Stream = NULL;
   StartStream = NULL;
   Callback = NULL;
@@ -170,6 +362,7 @@ void CInArchive::Close()
   EcdVolIndex = 0;
   
   ArcInfo.Clear();
+  SeqItem.Clear();
 
   ClearRefs();
 }
@@ -263,7 +456,7 @@ HRESULT CInArchive::ReadFromCache(Byte *data, unsigned size, unsigned &processed
     if (_inBufMode)
     {
       UInt32 cur = 0;
-      result = Stream->Read(Buffer, (UInt32)Buffer.Size(), &cur);
+      result = StreamRead(Buffer, (UInt32)Buffer.Size(), &cur);
       _bufPos = 0;
       _bufCached = cur;
       _streamPos += cur;
@@ -277,7 +470,7 @@ HRESULT CInArchive::ReadFromCache(Byte *data, unsigned size, unsigned &processed
     else
     {
       UInt32 cur = 0;
-      result = Stream->Read(data, size, &cur);
+      result = StreamRead(data, size, &cur);
       data += cur;
       size -= cur;
       processed += cur;
@@ -817,7 +1010,7 @@ HRESULT CInArchive::LookAhead(size_t minRequired)
 
     const size_t pos = _bufCached;
     UInt32 processed = 0;
-    HRESULT res = Stream->Read(Buffer + pos, (UInt32)(Buffer.Size() - pos), &processed);
+    HRESULT res = StreamRead(Buffer + pos, (UInt32)(Buffer.Size() - pos), &processed);
     _streamPos += processed;
     _bufCached += processed;
 
@@ -1527,8 +1720,15 @@ HRESULT CInArchive::ReadCdItem(CItemEx &item)
   G32(38, item.LocalHeaderPos);
   ReadFileName(nameSize, item.Name);
   
+  // (item) can be reused for next items, so we clear old extra
+  CExtraBlock &extra = item.CentralExtra;
+  extra.Clear();
+  extra.Error = false;
+  extra.MinorError = false;
+  extra.IsZip64_Error = false;
+
   if (extraSize > 0)
-    ReadExtra(extraSize, item.CentralExtra, item.Size, item.PackSize, item.LocalHeaderPos, item.Disk);
+    ReadExtra(extraSize, extra, item.Size, item.PackSize, item.LocalHeaderPos, item.Disk);
 
   // May be these strings must be deleted
   /*
@@ -1726,9 +1926,13 @@ HRESULT CInArchive::FindCd(bool checkOffsetMode)
 }
 
 
-HRESULT CInArchive::TryReadCd(CObjectVector<CItemEx> &items, const CCdInfo &cdInfo, UInt64 cdOffset, UInt64 cdSize)
+HRESULT CInArchive::TryReadCd(CItems &items, const CCdInfo &cdInfo, UInt64 cdOffset, UInt64 cdSize)
 {
   items.Clear();
+  // we reserve records for all items, if (NumEntries) is consistent with (cdSize)
+  if (cdInfo.NumEntries <= cdSize / kCentralHeaderSize
+      && cdInfo.NumEntries < ((UInt32)1 << 30))
+    items.Reserve((unsigned)cdInfo.NumEntries);
 
   RINOK(SeekToVol(IsMultiVol ? cdInfo.CdDisk : -1, cdOffset));
 
@@ -1743,17 +1947,17 @@ HRESULT CInArchive::TryReadCd(CObjectVector<CItemEx> &items, const CCdInfo &cdIn
   const UInt64 *totalFilesPtr = &numFileExpected;
   bool isCorrect_NumEntries = (cdInfo.IsFromEcd64 || numFileExpected >= ((UInt32)1 << 16));
 
+  // we reuse the buffers of (cdItem) for all items
+  CItemEx cdItem;
+
   while (_cnt < cdSize)
   {
     CanStartNewVol = true;
     if (ReadUInt32() != NSignature::kCentralFileHeader)
       return S_FALSE;
     CanStartNewVol = false;
-    {
-      CItemEx cdItem;
-      RINOK(ReadCdItem(cdItem));
-      items.Add(cdItem);
-    }
+    RINOK(ReadCdItem(cdItem));
+    items.Add(cdItem);
     if (Callback && (items.Size() & 0xFFF) == 0)
     {
       const UInt64 numFiles = items.Size();
@@ -1778,7 +1982,7 @@ HRESULT CInArchive::TryReadCd(CObjectVector<CItemEx> &items, const CCdInfo &cdIn
 }
 
 
-HRESULT CInArchive::ReadCd(CObjectVector<CItemEx> &items, UInt32 &cdDisk, UInt64 &cdOffset, UInt64 &cdSize)
+HRESULT CInArchive::ReadCd(CItems &items, UInt32 &cdDisk, UInt64 &cdOffset, UInt64 &cdSize)
 {
   bool checkOffsetMode = true;
   
@@ -1827,7 +2031,7 @@ HRESULT CInArchive::ReadCd(CObjectVector<CItemEx> &items, UInt32 &cdDisk, UInt64
 }
 
 
-static int FindItem(const CObjectVector<CItemEx> &items, const CItemEx &item)
+static int FindItem(const CItems &items, const CItemEx &item)
 {
   unsigned left = 0, right = items.Size();
   for (;;)
@@ -1835,7 +2039,7 @@ static int FindItem(const CObjectVector<CItemEx> &items, const CItemEx &item)
     if (left >= right)
       return -1;
     unsigned index = (left + right) / 2;
-    const CItemEx &item2 = items[index];
+    const CCompactItem &item2 = items[index];
     if (item.Disk < item2.Disk)
       right = index;
     else if (item.Disk > item2.Disk)
@@ -1849,9 +2053,9 @@ static int FindItem(const CObjectVector<CItemEx> &items, const CItemEx &item)
   }
 }
 
-static bool IsStrangeItem(const CItem &item)
+static bool IsStrangeItem(const CCompactItem &item)
 {
-  return item.Name.Len() > (1 << 14) || item.Method > (1 << 8);
+  return item.NameLen > (1 << 14) || item.Method > (1 << 8);
 }
 
 
@@ -1889,7 +2093,7 @@ out:
       But we can use all filled CItemEx items.
 */
 
-HRESULT CInArchive::ReadLocals(CObjectVector<CItemEx> &items)
+HRESULT CInArchive::ReadLocals(CItems &items)
 {
   items.Clear();
 
@@ -2315,6 +2519,11 @@ STDMETHODIMP CVolStream::Read(void *data, UInt32 size, UInt32 *processedSize)
   return Vols->Read(data, size, processedSize);
 }
 
+STDMETHODIMP CSeqDataStream::Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  return Archive->ReadSeqData(data, size, processedSize);
+}
+
 
 
 
@@ -2322,7 +2531,7 @@ STDMETHODIMP CVolStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 #define COPY_ECD_ITEM_32(n) if (!isZip64 || !ZIP64_IS_32_MAX(ecd. n)) cdInfo. n = ecd. n;
 
 
-HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
+HRESULT CInArchive::ReadHeaders(CItems &items)
 {
   if (Buffer.Size() < kSeqBufferSize)
   {
@@ -2474,9 +2683,12 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
       {
         firstItem.LocalHeaderPos = ArcInfo.MarkerPos2 - ArcInfo.Base;
         int index = FindItem(items, firstItem);
+        CItemEx cdItem;
+        if (index != -1)
+          items.Get(index, cdItem);
         if (index == -1)
           res = S_FALSE;
-        else if (!AreItemsEqual(firstItem, items[index]))
+        else if (!AreItemsEqual(firstItem, cdItem))
           res = S_FALSE;
         else
         {
@@ -2490,7 +2702,7 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
 
 
 
-  CObjectVector<CItemEx> cdItems;
+  CItems cdItems;
 
   bool needSetBase = false; // we set needSetBase only for LOCALS_CD_MODE
   unsigned numCdItems = items.Size();
@@ -2576,10 +2788,10 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
 
     const UInt64 processedCnt_start = _cnt;
 
+    CItemEx cdItem;
+
     for (;;)
     {
-      CItemEx cdItem;
-      
       RINOK(ReadCdItem(cdItem));
       
       cdItems.Add(cdItem);
@@ -2837,6 +3049,9 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
 
     LocalsCenterMerged = true;
 
+    CItemEx cdItem;
+    CItemEx item;
+
     FOR_VECTOR (i, cdItems)
     {
       if (Callback)
@@ -2846,7 +3061,7 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
         RINOK(Callback->SetCompleted(&numFiles64, &_cnt));
       }
 
-      const CItemEx &cdItem = cdItems[i];
+      cdItems.Get(i, cdItem);
       
       int index = -1;
       
@@ -2854,10 +3069,10 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
       {
         if ((unsigned)nextLocalIndex < items.Size())
         {
-          CItemEx &item = items[nextLocalIndex];
-          if (item.Disk == cdItem.Disk &&
-              (item.LocalHeaderPos == cdItem.LocalHeaderPos
-              || Overflow32bit && (UInt32)item.LocalHeaderPos == cdItem.LocalHeaderPos))
+          const CCompactItem &localItem = items[nextLocalIndex];
+          if (localItem.Disk == cdItem.Disk &&
+              (localItem.LocalHeaderPos == cdItem.LocalHeaderPos
+              || Overflow32bit && (UInt32)localItem.LocalHeaderPos == cdItem.LocalHeaderPos))
             index = nextLocalIndex++;
           else
             nextLocalIndex = -1;
@@ -2876,7 +3091,7 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
         continue;
       }
 
-      CItemEx &item = items[index];
+      items.Get(index, item);
       if (item.Name != cdItem.Name
           // || item.Name.Len() != cdItem.Name.Len()
           || item.PackSize != cdItem.PackSize
@@ -2896,10 +3111,14 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
       item.ExternalAttrib = cdItem.ExternalAttrib;
       item.Comment = cdItem.Comment;
       item.FromCentral = cdItem.FromCentral;
+      items.Set(index, item);
     }
 
     FOR_VECTOR (k, items2)
-      items.Add(cdItems[items2[k]]);
+    {
+      cdItems.Get(items2[k], cdItem);
+      items.Add(cdItem);
+    }
   }
 
   if (ecd.NumEntries < ecd.NumEntries_in_ThisDisk)
@@ -2971,7 +3190,7 @@ HRESULT CInArchive::ReadHeaders(CObjectVector<CItemEx> &items)
 
 
 HRESULT CInArchive::Open(IInStream *stream, const UInt64 *searchLimit,
-    IArchiveOpenCallback *callback, CObjectVector<CItemEx> &items)
+    IArchiveOpenCallback *callback, CItems &items)
 {
   items.Clear();
   
@@ -3144,10 +3363,347 @@ HRESULT CInArchive::Open(IInStream *stream, const UInt64 *searchLimit,
 }
 
 
+// ---------- Sequential mode ----------
+
+static const size_t kSeqStreamBufferSize = (size_t)1 << 16;
+
+/* ReadSeqData() keeps the end of processed data in Buffer, so
+   we can return the data that was read by decoder after the end of packed data.
+   Decoders read new input data only after all previous input data was used,
+   so it's enough to keep some small part of previous data. */
+
+static const size_t kSeqKeepSize = (size_t)1 << 10;
+
+
+HRESULT CInArchive::OpenSeq(ISequentialInStream *stream)
+{
+  Close();
+  _seqStream = stream;
+  Buffer.AllocAtLeast(kSeqStreamBufferSize);
+  _inBufMode = true;
+  InitBuf();
+  _streamPos = 0;
+
+  RINOK(LookAhead(kLocalHeaderSize));
+  if (GetAvail() < 4)
+    return S_FALSE;
+  UInt32 sig = Get32(Buffer + _bufPos);
+  if (sig == NSignature::kSpan || sig == NSignature::kNoSpan)
+  {
+    SkipLookahed(4);
+    ArcInfo.MarkerPos2 = 4;
+    if (GetAvail() < 4)
+      return S_FALSE;
+    sig = Get32(Buffer + _bufPos);
+  }
+  if (sig != NSignature::kLocalFileHeader
+      && sig != NSignature::kEcd)
+    return S_FALSE;
+
+  IsArc = true;
+  MarkerIsFound = true;
+  LocalsWereRead = true;
+  IsArcOpen = true;
+  return S_OK;
+}
+
+
+HRESULT CInArchive::ReadSeqLocalItem(CItemEx &item, bool &isLocal)
+{
+  isLocal = false;
+  SeqItem.Clear();
+  try
+  {
+    RINOK(LookAhead(4));
+    if (GetAvail() < 4)
+    {
+      UnexpectedEnd = true;
+      return S_OK;
+    }
+    if (Get32(Buffer + _bufPos) != NSignature::kLocalFileHeader)
+      return S_OK;
+    item.LocalHeaderPos = _cnt;
+    item.FromLocal = true;
+    SkipLookahed(4);
+    if (!ReadLocalItem(item))
+    {
+      HeadersError = true;
+      return S_OK;
+    }
+    if (item.LocalExtra.IsZip64)
+      IsZip64 = true;
+    isLocal = true;
+  }
+  catch (const CSystemException &e) { return e.ErrorCode; }
+  catch (const CUnexpectEnd &) { UnexpectedEnd = true; }
+  return S_OK;
+}
+
+
+HRESULT CInArchive::ReadSeqData(void *data, UInt32 size, UInt32 *processedSize)
+{
+  if (processedSize)
+    *processedSize = 0;
+  if (size == 0)
+    return S_OK;
+  
+  if (GetAvail() == 0)
+  {
+    size_t keep = _bufPos;
+    if (keep > kSeqKeepSize)
+      keep = kSeqKeepSize;
+    if (keep != 0 && keep != _bufPos)
+      memmove(Buffer, Buffer + _bufPos - keep, keep);
+    _bufPos = keep;
+    _bufCached = keep;
+    
+    UInt32 cur = 0;
+    HRESULT res = StreamRead(Buffer + keep, (UInt32)(Buffer.Size() - keep), &cur);
+    _streamPos += cur;
+    _bufCached += cur;
+    RINOK(res);
+  }
+  
+  size_t cur = GetAvail();
+  if (cur > size)
+    cur = size;
+  memcpy(data, Buffer + _bufPos, cur);
+  SkipLookahed(cur);
+  if (processedSize)
+    *processedSize = (UInt32)cur;
+  return S_OK;
+}
+
+
+HRESULT CInArchive::CheckSeqSignature(UInt32 signature, bool &isSame)
+{
+  RINOK(LookAhead(4));
+  isSame = (GetAvail() >= 4 && Get32(Buffer + _bufPos) == signature);
+  return S_OK;
+}
+
+
+bool CInArchive::UnreadSeqData(UInt64 size)
+{
+  if (size > _bufPos)
+    return false;
+  _bufPos -= (size_t)size;
+  _cnt -= size;
+  return true;
+}
+
+
+HRESULT CInArchive::SkipSeqData(UInt64 size)
+{
+  while (size != 0)
+  {
+    RINOK(LookAhead(1));
+    size_t cur = GetAvail();
+    if (cur == 0)
+    {
+      UnexpectedEnd = true;
+      return S_OK;
+    }
+    if (cur > size)
+      cur = (size_t)size;
+    SkipLookahed(cur);
+    size -= cur;
+  }
+  return S_OK;
+}
+
+
+HRESULT CInArchive::ReadSeqDescriptor(bool isZip64)
+{
+  try
+  {
+    Byte buf[kDataDescriptorSize64];
+    const unsigned size = (isZip64 ? kDataDescriptorSize64 : kDataDescriptorSize32) - 4;
+    SafeRead(buf, 4);
+    if (Get32(buf) == NSignature::kDataDescriptor)
+      SafeRead(buf, size);
+    else
+    {
+      // pkzip's data descriptor without signature
+      SafeRead(buf + 4, size - 4);
+    }
+    
+    UInt64 packSize;
+    SeqItem.Crc = Get32(buf);
+    if (isZip64)
+    {
+      packSize = Get64(buf + 4);
+      SeqItem.Size = Get64(buf + 12);
+    }
+    else
+    {
+      packSize = Get32(buf + 4);
+      SeqItem.Size = Get32(buf + 8);
+    }
+    SeqItem.DescriptorWasRead = true;
+    if (isZip64 ?
+        packSize != SeqItem.PackSize :
+        packSize != (UInt32)SeqItem.PackSize)
+      SeqItem.DescriptorError = true;
+  }
+  catch (const CSystemException &e) { return e.ErrorCode; }
+  catch (const CUnexpectEnd &) { UnexpectedEnd = true; }
+  return S_OK;
+}
+
+
+/* FinishSeqItem() moves to the end of packed data of item and reads data descriptor.
+   If decoder has read data after the end of packed data, and we can't return
+   these data back, (SeqItem.IsFinished) stays false, and we can't read next items. */
+
+HRESULT CInArchive::FinishSeqItem(const CItemEx &item, UInt64 packSize)
+{
+  const UInt64 dataEnd = item.GetDataPosition() + packSize;
+  if (_cnt > dataEnd)
+  {
+    if (!UnreadSeqData(_cnt - dataEnd))
+      return S_OK;
+  }
+  else
+  {
+    RINOK(SkipSeqData(dataEnd - _cnt));
+  }
+  SeqItem.IsFinished = true;
+  SeqItem.PackSize = packSize;
+  if (item.HasDescriptor())
+    return ReadSeqDescriptor(item.LocalExtra.IsZip64);
+  return S_OK;
+}
+
+
+HRESULT CInArchive::ReadSeqCd(const CItems &items)
+{
+  try
+  {
+    const UInt64 cdOffset = _cnt;
+    unsigned numCdItems = 0;
+    UInt32 sig;
+    CItemEx cdItem;
+    CItemEx item;
+    
+    for (;;)
+    {
+      RINOK(LookAhead(4));
+      if (GetAvail() < 4)
+      {
+        UnexpectedEnd = true;
+        return S_OK;
+      }
+      sig = Get32(Buffer + _bufPos);
+      if (sig != NSignature::kCentralFileHeader)
+        break;
+      SkipLookahed(4);
+      
+      RINOK(ReadCdItem(cdItem));
+      if (cdItem.CentralExtra.IsZip64)
+        IsZip64 = true;
+      
+      if (numCdItems >= items.Size())
+        HeadersError = true;
+      else
+      {
+        items.Get(numCdItems, item);
+        if (cdItem.LocalHeaderPos != item.LocalHeaderPos
+            || !AreItemsEqual(item, cdItem))
+          HeadersError = true;
+        else if (item.DescriptorWasRead)
+        {
+          if (cdItem.PackSize != item.PackSize
+              || cdItem.Size != item.Size
+              || cdItem.Crc != item.Crc)
+            HeadersError = true;
+        }
+      }
+      numCdItems++;
+    }
+
+    if (numCdItems != items.Size())
+    {
+      if (numCdItems == 0)
+        NoCentralDir = true;
+      HeadersError = true;
+    }
+
+    const UInt64 cdSize = _cnt - cdOffset;
+    CCdInfo cdInfo;
+
+    if (sig == NSignature::kEcd64)
+    {
+      Byte buf[kEcd64_FullSize];
+      SafeRead(buf, kEcd64_FullSize);
+      const UInt64 recSize = Get64(buf + 4);
+      if (recSize < kEcd64_MainSize)
+      {
+        HeadersError = true;
+        return S_OK;
+      }
+      cdInfo.ParseEcd64e(buf + 12);
+      RINOK(SkipSeqData(recSize - kEcd64_MainSize));
+      IsZip64 = true;
+      
+      RINOK(LookAhead(4));
+      if (GetAvail() >= 4 && Get32(Buffer + _bufPos) == NSignature::kEcd64Locator)
+        Skip(kEcd64Locator_Size);
+      RINOK(LookAhead(4));
+      if (GetAvail() < 4)
+      {
+        UnexpectedEnd = true;
+        return S_OK;
+      }
+      sig = Get32(Buffer + _bufPos);
+    }
+
+    if (sig != NSignature::kEcd)
+    {
+      HeadersError = true;
+      return S_OK;
+    }
+
+    Byte buf[kEcdSize];
+    SafeRead(buf, kEcdSize);
+    CEcd ecd;
+    ecd.Parse(buf + 4);
+    ReadBuffer(ArcInfo.Comment, ecd.CommentSize);
+    
+    if (!cdInfo.IsFromEcd64)
+      cdInfo.ParseEcd32(buf);
+    
+    if (cdInfo.IsFromEcd64 ?
+          (cdInfo.NumEntries != numCdItems
+          || cdInfo.Size != cdSize
+          || cdInfo.Offset != cdOffset) :
+          (ecd.NumEntries != (UInt16)numCdItems
+          || ecd.Size != (UInt32)cdSize
+          || (ecd.Offset != (UInt32)cdOffset && !ZIP64_IS_32_MAX(ecd.Offset))))
+      HeadersError = true;
+
+    ArcInfo.CdWasRead = true;
+    LocalsCenterMerged = true;
+  }
+  catch (const CSystemException &e) { return e.ErrorCode; }
+  catch (const CUnexpectEnd &) { UnexpectedEnd = true; }
+  return S_OK;
+}
+
+
 HRESULT CInArchive::GetItemStream(const CItemEx &item, bool seekPackData, CMyComPtr<ISequentialInStream> &stream)
 {
   stream.Release();
 
+  if (IsSeqMode())
+  {
+    // in sequential mode the stream is positioned at packed data of current item
+    CSeqDataStream *seqStreamSpec = new CSeqDataStream;
+    seqStreamSpec->Archive = this;
+    stream = seqStreamSpec;
+    return S_OK;
+  }
+
   UInt64 pos = item.LocalHeaderPos;
   if (seekPackData)
     pos += item.LocalFullHeaderSize;
@@ -23,7 +23,7 @@ public:
   
   bool DescriptorWasRead;
 
-  CItemEx(): DescriptorWasRead(false) {}
+  CItemEx(): LocalFullHeaderSize(0), DescriptorWasRead(false) {}
 
   UInt64 GetLocalFullSize() const
     { return LocalFullHeaderSize + GetPackSizeWithDescriptor(); }
@@ -32,6 +32,81 @@ public:
 };
 
 
+/*
+  CItems : compact storage for items of opened archive.
+  The fixed-size fields of item are stored in one record of (_records),
+  and the variable-size data (name, comment, extra subblocks) of all items
+  are stored in big shared blocks. So we don't need heap allocations for each item.
+  Get() restores full CItemEx object from compact data.
+*/
+
+namespace NCompactItemFlags
+{
+  const unsigned kFromLocal = 1 << 0;
+  const unsigned kFromCentral = 1 << 1;
+  const unsigned kDescriptorWasRead = 1 << 2;
+  
+  // flags of CExtraBlock. The flags of CentralExtra are shifted by kCentralShift
+  const unsigned kExtraError = 1 << 3;
+  const unsigned kExtraMinorError = 1 << 4;
+  const unsigned kExtraIsZip64 = 1 << 5;
+  const unsigned kExtraIsZip64_Error = 1 << 6;
+  const unsigned kCentralShift = 4;
+}
+
+struct CCompactItem
+{
+  UInt64 Size;
+  UInt64 PackSize;
+  UInt64 LocalHeaderPos;
+  UInt32 Time;
+  UInt32 Crc;
+  UInt32 Disk;
+  UInt32 ExternalAttrib;
+  UInt32 LocalFullHeaderSize;
+
+  UInt32 DataBlock;   // index of data block
+  UInt32 DataOffset;  // offset of item data in data block
+  UInt32 NameLen;
+  UInt32 CommentLen;
+  UInt32 LocalExtraSize;   // the size of packed subblocks of extra
+  UInt32 CentralExtraSize;
+
+  UInt16 Flags;
+  UInt16 Method;
+  UInt16 InternalAttrib;
+  UInt16 BoolFlags;        // NCompactItemFlags
+  CVersion ExtractVersion;
+  CVersion MadeByVersion;
+};
+
+
+class CItems
+{
+  CRecordVector<CCompactItem> _records;
+  CObjectVector<CByteBuffer> _blocks;
+  size_t _blockPos; // size of used data in last block
+
+  Byte *AllocData(size_t size, CCompactItem &rec);
+  void PackItem(const CItemEx &item, CCompactItem &rec, Byte *data);
+public:
+  CItems(): _blockPos(0) {}
+
+  unsigned Size() const { return _records.Size(); }
+  bool IsEmpty() const { return _records.IsEmpty(); }
+  void Clear();
+  void Reserve(unsigned num) { _records.Reserve(num); }
+  
+  const CCompactItem &operator[](unsigned index) const { return _records[index]; }
+  CCompactItem &operator[](unsigned index) { return _records[index]; }
+
+  void Add(const CItemEx &item);
+  void Get(unsigned index, CItemEx &item) const;
+  // Set() reuses the place of old data, if the sizes of variable fields were not changed
+  void Set(unsigned index, const CItemEx &item);
+};
+
+
 struct CInArchiveInfo
 {
   Int64 Base; /* Base offset of start of archive in stream.
@@ -236,6 +311,29 @@ public:
 };
 
 
+// the state of current item in sequential mode (IArchiveOpenSeq)
+
+struct CSeqItemInfo
+{
+  bool IsFinished;        // packed data and data descriptor of item were read
+  bool DescriptorWasRead;
+  bool DescriptorError;   // pack size in data descriptor doesn't match real size of packed data
+  UInt32 Crc;             // from data descriptor
+  UInt64 PackSize;        // real size of packed data
+  UInt64 Size;            // from data descriptor
+
+  void Clear()
+  {
+    IsFinished = false;
+    DescriptorWasRead = false;
+    DescriptorError = false;
+    Crc = 0;
+    PackSize = 0;
+    Size = 0;
+  }
+};
+
+
 class CInArchive
 {
   CMidBuffer Buffer;
@@ -270,6 +368,16 @@ class CInArchive
   IInStream *StartStream;
   IArchiveOpenCallback *Callback;
 
+  // if (_seqStream), archive is read in sequential mode, and (Stream) is not used
+  CMyComPtr<ISequentialInStream> _seqStream;
+
+  HRESULT StreamRead(void *data, UInt32 size, UInt32 *processedSize)
+  {
+    if (_seqStream)
+      return _seqStream->Read(data, size, processedSize);
+    return Stream->Read(data, size, processedSize);
+  }
+
   HRESULT Seek_SavePos(UInt64 offset);
   HRESULT SeekToVol(int volIndex, UInt64 offset);
 
@@ -304,14 +412,18 @@ class CInArchive
   HRESULT ReadCdItem(CItemEx &item);
   HRESULT TryEcd64(UInt64 offset, CCdInfo &cdInfo);
   HRESULT FindCd(bool checkOffsetMode);
-  HRESULT TryReadCd(CObjectVector<CItemEx> &items, const CCdInfo &cdInfo, UInt64 cdOffset, UInt64 cdSize);
-  HRESULT ReadCd(CObjectVector<CItemEx> &items, UInt32 &cdDisk, UInt64 &cdOffset, UInt64 &cdSize);
-  HRESULT ReadLocals(CObjectVector<CItemEx> &localItems);
+  HRESULT TryReadCd(CItems &items, const CCdInfo &cdInfo, UInt64 cdOffset, UInt64 cdSize);
+  HRESULT ReadCd(CItems &items, UInt32 &cdDisk, UInt64 &cdOffset, UInt64 &cdSize);
+  HRESULT ReadLocals(CItems &localItems);
 
-  HRESULT ReadHeaders(CObjectVector<CItemEx> &items);
+  HRESULT ReadHeaders(CItems &items);
 
   HRESULT GetVolStream(unsigned vol, UInt64 pos, CMyComPtr<ISequentialInStream> &stream);
 
+  bool UnreadSeqData(UInt64 size);
+  HRESULT SkipSeqData(UInt64 size);
+  HRESULT ReadSeqDescriptor(bool isZip64);
+
 public:
   CInArchiveInfo ArcInfo;
   
@@ -336,11 +448,15 @@ public:
   UInt32 EcdVolIndex;
 
   CVols Vols;
+
+  CSeqItemInfo SeqItem;
  
   CInArchive(): Stream(NULL), StartStream(NULL), Callback(NULL), IsArcOpen(false) {}
 
   UInt64 GetPhySize() const
   {
+    if (IsSeqMode())
+      return _cnt;
     if (IsMultiVol)
       return ArcInfo.FinishPos;
     else
@@ -358,9 +474,21 @@ public:
   
   void ClearRefs();
   void Close();
-  HRESULT Open(IInStream *stream, const UInt64 *searchLimit, IArchiveOpenCallback *callback, CObjectVector<CItemEx> &items);
+  HRESULT Open(IInStream *stream, const UInt64 *searchLimit, IArchiveOpenCallback *callback, CItems &items);
 
   bool IsOpen() const { return IsArcOpen; }
+
+  /* Sequential mode: local headers are read in order of stream, and
+     packed data of each item must be read (or skipped) before next local header.
+     Central directory is read after last local item and it's used only for checking. */
+
+  bool IsSeqMode() const { return _seqStream != NULL; }
+  HRESULT OpenSeq(ISequentialInStream *stream);
+  HRESULT ReadSeqLocalItem(CItemEx &item, bool &isLocal);
+  HRESULT ReadSeqData(void *data, UInt32 size, UInt32 *processedSize);
+  HRESULT CheckSeqSignature(UInt32 signature, bool &isSame);
+  HRESULT FinishSeqItem(const CItemEx &item, UInt64 packSize);
+  HRESULT ReadSeqCd(const CItems &items);
   
   bool AreThereErrors() const
   {
@@ -397,6 +525,7 @@ public:
   bool CanUpdate() const
   {
     if (AreThereErrors()
+       || IsSeqMode()
        || IsMultiVol
        || ArcInfo.Base < 0
        || (Int64)ArcInfo.MarkerPos2 < ArcInfo.Base
@@ -410,6 +539,19 @@ public:
     return true;
   }
 };
+
+
+class CSeqDataStream:
+  public ISequentialInStream,
+  public CMyUnknownImp
+{
+public:
+  CInArchive *Archive;
+  
+  MY_UNKNOWN_IMP1(ISequentialInStream)
+
+  STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+};
   
 }}
   
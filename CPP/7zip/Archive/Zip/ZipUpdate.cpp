@@ -44,6 +44,10 @@ static const Byte kExtractHostOS = kHostOS;
 
 static const Byte kMethodForDirectory = NFileHeader::NCompressionMethod::kStore;
 
+#ifndef _7ZIP_ST
+static const UInt64 kZstdJobSize = (UInt64)1 << 23; // approximate size of job in multi-threaded zstd
+#endif
+
 
 static void AddAesExtra(CItem &item, Byte aesKeyMode, UInt16 method)
 {
@@ -478,7 +482,7 @@ static HRESULT Update2St(
     DECL_EXTERNAL_CODECS_LOC_VARS
     COutArchive &archive,
     CInArchive *inArchive,
-    const CObjectVector<CItemEx> &inputItems,
+    const CItems &inputItems,
     CObjectVector<CUpdateItem> &updateItems,
     const CCompressionMethodMode *options, bool outSeqMode,
     const CByteBuffer *comment,
@@ -508,7 +512,7 @@ static HRESULT Update2St(
     {
       // Note: for (ui.NewProps && !ui.NewData) it copies Props from old archive,
       // But we will rewrite all important properties later. But we can keep some properties like Comment
-      itemEx = inputItems[ui.IndexInArc];
+      inputItems.Get(ui.IndexInArc, itemEx);
       if (inArchive->ReadLocalItemAfterCdItemFull(itemEx) != S_OK)
         return E_NOTIMPL;
       (CItem &)item = itemEx;
@@ -611,7 +615,7 @@ static HRESULT Update2(
     DECL_EXTERNAL_CODECS_LOC_VARS
     COutArchive &archive,
     CInArchive *inArchive,
-    const CObjectVector<CItemEx> &inputItems,
+    const CItems &inputItems,
     CObjectVector<CUpdateItem> &updateItems,
     const CCompressionMethodMode &options, bool outSeqMode,
     const CByteBuffer *comment,
@@ -645,7 +649,8 @@ static HRESULT Update2(
     }
     else
     {
-      CItemEx inputItem = inputItems[ui.IndexInArc];
+      CItemEx inputItem;
+      inputItems.Get(ui.IndexInArc, inputItem);
       if (inArchive->ReadLocalItemAfterCdItemFull(inputItem) != S_OK)
         return E_NOTIMPL;
       complexity += inputItem.GetLocalFullSize();
@@ -778,6 +783,23 @@ static HRESULT Update2(
       }
       numThreads /= (unsigned)numXzThreads;
     }
+    else if (method == NFileHeader::NCompressionMethod::kZstd)
+    {
+      int numZstdThreads = oneMethodMain->Get_NumThreads();
+      if (numZstdThreads < 0)
+      {
+        // multi-threaded zstd splits data to jobs. So small files need only one thread
+        const UInt64 averageSize = numBytesToCompress / numFilesToCompress;
+        const UInt64 averageNumberOfJobs = averageSize / kZstdJobSize + 1;
+        UInt32 t = numThreads;
+        if (t > averageNumberOfJobs)
+          t = (UInt32)averageNumberOfJobs;
+        oneMethodMain->AddProp_NumThreads(t);
+        numZstdThreads = (int)t;
+      }
+      if (numZstdThreads > 1)
+        numThreads /= (unsigned)numZstdThreads;
+    }
     else if (method == NFileHeader::NCompressionMethod::kLZMA)
     {
       // we suppose that default LZMA is 2 thread. So we don't change it
@@ -876,7 +898,7 @@ static HRESULT Update2(
       }
       else
       {
-        itemEx = inputItems[ui.IndexInArc];
+        inputItems.Get(ui.IndexInArc, itemEx);
         if (inArchive->ReadLocalItemAfterCdItemFull(itemEx) != S_OK)
           return E_NOTIMPL;
         (CItem &)item = itemEx;
@@ -968,7 +990,7 @@ static HRESULT Update2(
     
     if (!ui.NewProps || !ui.NewData)
     {
-      itemEx = inputItems[ui.IndexInArc];
+      inputItems.Get(ui.IndexInArc, itemEx);
       if (inArchive->ReadLocalItemAfterCdItemFull(itemEx) != S_OK)
         return E_NOTIMPL;
       (CItem &)item = itemEx;
@@ -1119,10 +1141,12 @@ static const size_t kCacheMask = (kCacheSize - 1);
 
 class CCacheOutStream:
   public IOutStream,
+  public IOutStreamCopyFrom,
   public CMyUnknownImp
 {
   CMyComPtr<IOutStream> _stream;
   CMyComPtr<ISequentialOutStream> _seqStream;
+  CMyComPtr<IOutStreamCopyFrom> _copyFrom;
   Byte *_cache;
   UInt64 _virtPos;
   UInt64 _virtSize;
@@ -1143,11 +1167,12 @@ public:
   bool Allocate();
   HRESULT Init(ISequentialOutStream *seqStream, IOutStream *stream);
   
-  MY_UNKNOWN_IMP
+  MY_UNKNOWN_IMP1(IOutStreamCopyFrom)
 
   STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
   STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
   STDMETHOD(SetSize)(UInt64 newSize);
+  STDMETHOD(CopyFrom)(ISequentialInStream *inStream, UInt64 size, UInt64 *processedSize);
 };
 
 bool CCacheOutStream::Allocate()
@@ -1164,6 +1189,8 @@ HRESULT CCacheOutStream::Init(ISequentialOutStream *seqStream, IOutStream *strea
   _virtSize = 0;
   _seqStream = seqStream;
   _stream = stream;
+  _copyFrom.Release();
+  _seqStream.QueryInterface(IID_IOutStreamCopyFrom, &_copyFrom);
   if (_stream)
   {
     RINOK(_stream->Seek(0, STREAM_SEEK_CUR, &_virtPos));
@@ -1339,10 +1366,34 @@ STDMETHODIMP CCacheOutStream::SetSize(UInt64 newSize)
   return S_OK;
 }
 
+STDMETHODIMP CCacheOutStream::CopyFrom(ISequentialInStream *inStream, UInt64 size, UInt64 *processedSize)
+{
+  *processedSize = 0;
+  // we pass data to real stream only for simple case of appending to the end of stream
+  if (!_copyFrom || _virtPos != _virtSize)
+    return S_OK;
+  RINOK(FlushCache());
+  if (_phySize != _virtPos)
+    return S_OK;
+  if (_phyPos != _virtPos)
+  {
+    if (!_stream)
+      return S_OK;
+    RINOK(_stream->Seek(_virtPos, STREAM_SEEK_SET, &_phyPos));
+  }
+  HRESULT res = _copyFrom->CopyFrom(inStream, size, processedSize);
+  _phyPos += *processedSize;
+  _phySize = _phyPos;
+  _virtPos = _phyPos;
+  _virtSize = _phyPos;
+  _cachedPos = _phyPos;
+  return res;
+}
+
 
 HRESULT Update(
     DECL_EXTERNAL_CODECS_LOC_VARS
-    const CObjectVector<CItemEx> &inputItems,
+    const CItems &inputItems,
     CObjectVector<CUpdateItem> &updateItems,
     ISequentialOutStream *seqOutStream,
     CInArchive *inArchive, bool removeSfx,
@@ -60,7 +60,7 @@ struct CUpdateItem
 
 HRESULT Update(
     DECL_EXTERNAL_CODECS_LOC_VARS
-    const CObjectVector<CItemEx> &inputItems,
+    const CItems &inputItems,
     CObjectVector<CUpdateItem> &updateItems,
     ISequentialOutStream *seqOutStream,
     CInArchive *inArchive, bool removeSfx,
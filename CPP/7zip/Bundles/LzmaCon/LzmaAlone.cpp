@@ -68,7 +68,8 @@ static const char * const kHelpString =
     "  -mt{N} : set number of CPU threads\n"
     "  -eos   : write end of stream marker\n"
     "  -si    : read data from stdin\n"
-    "  -so    : write data to stdout\n";
+    "  -so    : write data to stdout\n"
+    "  -slp   : set Large Pages mode\n";
 
 
 static const char * const kCantAllocate = "Can not allocate memory";
@@ -95,7 +96,8 @@ enum Enum
   kEOS,
   kStdIn,
   kStdOut,
-  kFilter86
+  kFilter86,
+  kLargePages
 };
 }
 
@@ -117,7 +119,8 @@ static const CSwitchForm kSwitchForms[] =
   { "EOS", NSwitchType::kSimple, false },
   { "SI",  NSwitchType::kSimple, false },
   { "SO",  NSwitchType::kSimple, false },
-  { "F86",  NSwitchType::kChar, false, 0, "+" }
+  { "F86",  NSwitchType::kChar, false, 0, "+" },
+  { "SLP",  NSwitchType::kSimple, false }
 };
 
 
@@ -369,6 +372,12 @@ static int main2(int numArgs, const char *args[])
   if (!stdOutMode)
     PrintTitle();
 
+  if (parser[NKey::kLargePages].ThereIs)
+  {
+    SetLargePageSize();
+    g_LargePagesMode = true;
+  }
+
   const UStringVector &params = parser.NonSwitchStrings;
 
   unsigned paramIndex = 0;
@@ -6,6 +6,11 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
 #endif
 
 #ifdef SUPPORT_DEVICE_FILE
@@ -328,6 +333,60 @@ STDMETHODIMP CInFileStream::GetProps2(CStreamFileProps *props)
   return GetLastError();
 }
 
+#else
+
+STDMETHODIMP CInFileStream::GetFd(int *fd)
+{
+  *fd = File.GetHandle();
+  return S_OK;
+}
+
+STDMETHODIMP CInFileStream::GetDataRange(UInt64 pos, UInt64 *dataPos, UInt64 *dataSize)
+{
+  *dataPos = pos;
+  *dataSize = 0;
+
+  #if defined(SEEK_DATA) && defined(SEEK_HOLE)
+
+  const int fd = File.GetHandle();
+  const off_t cur = lseek(fd, 0, SEEK_CUR);
+  if (cur == -1)
+    return S_FALSE;
+  HRESULT res = S_FALSE;
+  const off_t start = lseek(fd, (off_t)pos, SEEK_DATA);
+  if (start != -1)
+  {
+    const off_t end = lseek(fd, start, SEEK_HOLE);
+    if (end != -1 && end >= start)
+    {
+      *dataPos = (UInt64)start;
+      *dataSize = (UInt64)(end - start);
+      res = S_OK;
+    }
+  }
+  else if (errno == ENXIO)
+  {
+    // there is no data after (pos)
+    const off_t end = lseek(fd, 0, SEEK_END);
+    if (end != -1)
+    {
+      if ((UInt64)end > pos)
+        *dataPos = (UInt64)end;
+      res = S_OK;
+    }
+  }
+  // EINVAL: file system doesn't support SEEK_DATA
+  if (lseek(fd, cur, SEEK_SET) == -1)
+    return E_FAIL;
+  return res;
+
+  #else
+
+  return S_FALSE;
+
+  #endif
+}
+
 #endif
 
 //////////////////////////
@@ -413,6 +472,121 @@ HRESULT COutFileStream::GetSize(UInt64 *size)
   return ConvertBoolToHRESULT(File.GetLength(*size));
 }
 
+STDMETHODIMP COutFileStream::Flush()
+{
+  return ConvertBoolToHRESULT(File.Flush());
+}
+
+#ifndef USE_WIN_FILE
+
+/* We copy with copy_file_range() (in-kernel copy that can share extents on
+   some file systems) and with sendfile(), if copy_file_range() is not supported
+   for that pair of files. If both calls fail, we return S_OK with partial
+   (*processedSize), and the caller copies the remaining data via buffers. */
+
+static const size_t kCopyFromChunkSize = (size_t)1 << 30;
+
+STDMETHODIMP COutFileStream::CopyFrom(ISequentialInStream *inStream, UInt64 size, UInt64 *processedSize)
+{
+  *processedSize = 0;
+  
+  #ifdef __linux__
+  
+  CMyComPtr<IStreamGetFd> getFd;
+  inStream->QueryInterface(IID_IStreamGetFd, (void **)&getFd);
+  if (!getFd)
+    return S_OK;
+  int inFd = -1;
+  RINOK(getFd->GetFd(&inFd));
+  const int outFd = File.GetHandle();
+  if (inFd < 0 || outFd < 0)
+    return S_OK;
+
+  #ifdef __NR_copy_file_range
+  bool useCopyRange = true;
+  #endif
+
+  while (size != 0)
+  {
+    size_t cur = kCopyFromChunkSize;
+    if (cur > size)
+      cur = (size_t)size;
+    ssize_t res;
+    #ifdef __NR_copy_file_range
+    if (useCopyRange)
+    {
+      res = (ssize_t)syscall(__NR_copy_file_range, inFd, (loff_t *)NULL, outFd, (loff_t *)NULL, cur, 0u);
+      if (res < 0 && errno != EINTR)
+      {
+        // EXDEV, ENOSYS, EINVAL, EOPNOTSUPP: sendfile() still can work
+        useCopyRange = false;
+        continue;
+      }
+    }
+    else
+    #endif
+    {
+      res = sendfile(outFd, inFd, NULL, cur);
+      if (res < 0 && errno != EINTR)
+        return S_OK;
+    }
+    if (res < 0)
+      continue;
+    if (res == 0)
+      break;
+    size -= (size_t)res;
+    *processedSize += (size_t)res;
+    ProcessedSize += (size_t)res;
+  }
+  
+  #else
+
+  UNUSED_VAR(inStream);
+  UNUSED_VAR(size);
+
+  #endif
+
+  return S_OK;
+}
+
+/* The area after the end of file is extended with ftruncate(), so it's a hole.
+   If the area already exists in file (preallocated file), we punch a hole there. */
+
+STDMETHODIMP COutFileStream::WriteHole(UInt64 size)
+{
+  const int fd = File.GetHandle();
+  const off_t cur = lseek(fd, 0, SEEK_CUR);
+  struct stat st;
+  if (cur == -1 || fstat(fd, &st) != 0)
+    return S_FALSE;
+  const UInt64 pos = (UInt64)cur;
+  const UInt64 end = (UInt64)st.st_size;
+  const UInt64 newPos = pos + size;
+  if (newPos < pos || (off_t)newPos < 0)
+    return S_FALSE;
+  
+  if (pos < end)
+  {
+    #if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    const UInt64 len = (newPos < end ? newPos : end) - pos;
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, cur, (off_t)len) != 0)
+      return S_FALSE;
+    #else
+    return S_FALSE;
+    #endif
+  }
+  
+  if (newPos > end)
+    if (ftruncate(fd, (off_t)newPos) != 0)
+      return S_FALSE;
+  if (lseek(fd, (off_t)newPos, SEEK_SET) == -1)
+    return E_FAIL;
+  ProcessedSize += size;
+  return S_OK;
+}
+
+#endif
+
 #ifdef UNDER_CE
 
 STDMETHODIMP CStdOutFileStream::Write(const void *data, UInt32 size, UInt32 *processedSize)
@@ -37,6 +37,9 @@ class CInFileStream:
   #ifdef USE_WIN_FILE
   public IStreamGetProps,
   public IStreamGetProps2,
+  #else
+  public IStreamGetFd,
+  public IStreamGetDataRange,
   #endif
   public CMyUnknownImp
 {
@@ -80,6 +83,9 @@ public:
   #ifdef USE_WIN_FILE
   MY_QUERYINTERFACE_ENTRY(IStreamGetProps)
   MY_QUERYINTERFACE_ENTRY(IStreamGetProps2)
+  #else
+  MY_QUERYINTERFACE_ENTRY(IStreamGetFd)
+  MY_QUERYINTERFACE_ENTRY(IStreamGetDataRange)
   #endif
   MY_QUERYINTERFACE_END
   MY_ADDREF_RELEASE
@@ -91,6 +97,9 @@ public:
   #ifdef USE_WIN_FILE
   STDMETHOD(GetProps)(UInt64 *size, FILETIME *cTime, FILETIME *aTime, FILETIME *mTime, UInt32 *attrib);
   STDMETHOD(GetProps2)(CStreamFileProps *props);
+  #else
+  STDMETHOD(GetFd)(int *fd);
+  STDMETHOD(GetDataRange)(UInt64 pos, UInt64 *dataPos, UInt64 *dataSize);
   #endif
 };
 
@@ -107,6 +116,11 @@ public:
 
 class COutFileStream:
   public IOutStream,
+  #ifndef USE_WIN_FILE
+  public IOutStreamCopyFrom,
+  public IOutStreamWriteHole,
+  #endif
+  public IOutStreamFlush,
   public CMyUnknownImp
 {
 public:
@@ -140,11 +154,20 @@ public:
   #endif
 
 
-  MY_UNKNOWN_IMP1(IOutStream)
+  #ifdef USE_WIN_FILE
+  MY_UNKNOWN_IMP2(IOutStream, IOutStreamFlush)
+  #else
+  MY_UNKNOWN_IMP4(IOutStream, IOutStreamCopyFrom, IOutStreamWriteHole, IOutStreamFlush)
+  #endif
 
   STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
   STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
   STDMETHOD(SetSize)(UInt64 newSize);
+  #ifndef USE_WIN_FILE
+  STDMETHOD(CopyFrom)(ISequentialInStream *inStream, UInt64 size, UInt64 *processedSize);
+  STDMETHOD(WriteHole)(UInt64 size);
+  #endif
+  STDMETHOD(Flush)();
 
   HRESULT GetSize(UInt64 *size);
 };
@@ -79,6 +79,11 @@ public:
   
   size_t ReadBytes(Byte *buf, size_t size);
   size_t Skip(size_t size);
+
+  // for fast decoders that read data directly from buffer
+  const Byte *GetPtr() const { return _buf; }
+  const Byte *GetLim() const { return _bufLim; }
+  void SetPtr(const Byte *p) { _buf = _bufBase + (p - _bufBase); }
 };
 
 class CInBuffer: public CInBufferBase
@@ -84,6 +84,7 @@ class CDynBufSeqOutStream:
 public:
   CDynBufSeqOutStream(): _size(0) {}
   void Init() { _size = 0;  }
+  void Free() { _buffer.Free(); _size = 0; }
   size_t GetSize() const { return _size; }
   const Byte *GetBuffer() const { return _buffer; }
   void CopyToBuffer(CByteBuffer &dest) const;
@@ -139,6 +139,31 @@ public:
     MovePos(8);
     return b;
   }
+
+  /* the functions for fast decoding loops that read bytes directly from buffer of (TInByte).
+     Such loop gets the bits from (GetBits()), and then it returns unused bits via SetBits(). */
+
+  TInByte &GetStream() { return this->_stream; }
+  unsigned GetNumBits() const { return kNumBigValueBits - this->_bitPos; }
+  UInt32 GetBits() const { return _normalValue; }
+  
+  // (numBits <= 32)
+  void SetBits(UInt32 bits, unsigned numBits)
+  {
+    this->_bitPos = kNumBigValueBits - numBits;
+    _normalValue = 0;
+    this->_value = 0;
+    if (numBits != 0)
+    {
+      bits &= ((UInt32)0xFFFFFFFF >> (kNumBigValueBits - numBits));
+      _normalValue = bits;
+      this->_value = (
+            ((UInt32)kInvertTable[bits & 0xFF] << 24)
+          | ((UInt32)kInvertTable[(bits >> 8) & 0xFF] << 16)
+          | ((UInt32)kInvertTable[(bits >> 16) & 0xFF] << 8)
+          | ((UInt32)kInvertTable[bits >> 24])) >> (kNumBigValueBits - numBits);
+    }
+  }
 };
 
 }
@@ -9,6 +9,7 @@
 namespace NCompress {
 
 static const UInt32 kBufSize = 1 << 17;
+static const UInt64 kCopyFromStep = (UInt64)1 << 26;
 
 CCopyCoder::~CCopyCoder()
 {
@@ -33,6 +34,34 @@ STDMETHODIMP CCopyCoder::Code(ISequentialInStream *inStream,
   }
 
   TotalSize = 0;
+
+  if (outStream && outSize)
+  {
+    // (outStream) can copy from file descriptor of (inStream) without our buffer.
+    CMyComPtr<IOutStreamCopyFrom> copyFrom;
+    outStream->QueryInterface(IID_IOutStreamCopyFrom, (void **)&copyFrom);
+    if (copyFrom)
+    {
+      for (;;)
+      {
+        UInt64 cur = *outSize - TotalSize;
+        if (cur > kCopyFromStep)
+          cur = kCopyFromStep;
+        if (cur == 0)
+          return S_OK;
+        UInt64 processed = 0;
+        HRESULT res = copyFrom->CopyFrom(inStream, cur, &processed);
+        TotalSize += processed;
+        RINOK(res);
+        if (progress && processed != 0)
+        {
+          RINOK(progress->SetRatioInfo(&TotalSize, &TotalSize));
+        }
+        if (processed != cur)
+          break;
+      }
+    }
+  }
   
   for (;;)
   {
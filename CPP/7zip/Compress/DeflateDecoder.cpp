@@ -2,6 +2,8 @@
 
 #include "StdAfx.h"
 
+#include "../../../C/CpuArch.h"
+
 #include "DeflateDecoder.h"
 
 namespace NCompress {
@@ -144,7 +146,325 @@ bool CCoder::ReadTables(void)
     memcpy(levels.distLevels, tmpLevels + numLitLenLevels, _numDistLevels);
   }
   RIF(m_MainDecoder.Build(levels.litLenLevels));
-  return m_DistDecoder.Build(levels.distLevels);
+  RIF(m_DistDecoder.Build(levels.distLevels));
+  if (!_deflate64Mode)
+    BuildFastTables(levels);
+  return true;
+}
+
+
+/*
+  Entries of fast tables:
+    _fastMain : bits 0-3 : number of bits of code(s)
+                bits 4-5 : kind of entry
+       kFast_Lit      : bits 8-15  : literal
+       kFast_Lit2     : bits 8-15  : first literal, bits 16-23 : second literal
+       kFast_Len      : bits 8-15  : number of extra bits, bits 16-31 : base length
+       kFast_Other    : bit 8 is set for end of block.
+                        Otherwise the code is longer than kNumFastMainBits or it's unused.
+    _fastDist : bits 0-3   : number of bits of code (0 for long or unused code)
+                bits 4-7   : number of extra bits
+                bits 16-31 : base distance
+*/
+
+static const unsigned kFast_NumBitsMask = 0xF;
+static const UInt32 kFast_KindMask = (3 << 4);
+static const UInt32 kFast_Lit   = (0 << 4);
+static const UInt32 kFast_Lit2  = (1 << 4);
+static const UInt32 kFast_Len   = (2 << 4);
+static const UInt32 kFast_Other = (3 << 4);
+static const UInt32 kFast_EndOfBlockFlag = (1 << 8);
+
+// it writes canonical Huffman codes in reversed bit order (the order of bits in stream)
+
+static void Huffman_GetReversedCodes(const Byte *lens, unsigned numSymbols, UInt32 *codes)
+{
+  UInt32 counts[kNumHuffmanBits + 1];
+  UInt32 next[kNumHuffmanBits + 1];
+  unsigned i;
+  
+  for (i = 0; i <= kNumHuffmanBits; i++)
+    counts[i] = 0;
+  for (i = 0; i < numSymbols; i++)
+    counts[lens[i]]++;
+  counts[0] = 0;
+  
+  UInt32 code = 0;
+  next[0] = 0;
+  for (i = 1; i <= kNumHuffmanBits; i++)
+  {
+    code = (code + counts[i - 1]) << 1;
+    next[i] = code;
+  }
+  
+  for (i = 0; i < numSymbols; i++)
+  {
+    const unsigned len = lens[i];
+    UInt32 c = next[len]++;
+    UInt32 rev = 0;
+    for (unsigned k = 0; k < len; k++)
+    {
+      rev = (rev << 1) | (c & 1);
+      c >>= 1;
+    }
+    codes[i] = rev;
+  }
+}
+
+void CCoder::BuildFastTables(const CLevels &levels)
+{
+  UInt32 codes[kFixedMainTableSize];
+  UInt32 single[1 << kNumFastMainBits];
+  const UInt32 kNumMain = (UInt32)1 << kNumFastMainBits;
+  const UInt32 kNumDist = (UInt32)1 << kNumFastDistBits;
+  UInt32 i;
+  
+  Huffman_GetReversedCodes(levels.litLenLevels, kFixedMainTableSize, codes);
+  
+  for (i = 0; i < kNumMain; i++)
+    single[i] = kFast_Other;
+  
+  for (i = 0; i < kMainTableSize; i++)
+  {
+    const unsigned len = levels.litLenLevels[i];
+    if (len == 0 || len > kNumFastMainBits)
+      continue;
+    UInt32 e;
+    if (i < 0x100)
+      e = kFast_Lit | (i << 8);
+    else if (i == kSymbolEndOfBlock)
+      e = kFast_Other | kFast_EndOfBlockFlag;
+    else
+    {
+      const unsigned slot = i - kSymbolMatch;
+      e = kFast_Len | ((UInt32)kLenDirectBits32[slot] << 8) | ((UInt32)(kLenStart32[slot] + kMatchMinLen) << 16);
+    }
+    e |= len;
+    for (UInt32 k = codes[i]; k < kNumMain; k += ((UInt32)1 << len))
+      single[k] = e;
+  }
+  
+  // we join two literals to one entry, if both codes are in kNumFastMainBits
+  
+  for (i = 0; i < kNumMain; i++)
+  {
+    UInt32 e = single[i];
+    if ((e & kFast_KindMask) == kFast_Lit)
+    {
+      const unsigned n1 = (unsigned)e & kFast_NumBitsMask;
+      const UInt32 e2 = single[i >> n1];
+      const unsigned n2 = (unsigned)e2 & kFast_NumBitsMask;
+      if ((e2 & kFast_KindMask) == kFast_Lit && n1 + n2 <= kNumFastMainBits)
+        e = kFast_Lit2 | (n1 + n2) | (e & 0xFF00) | ((e2 & 0xFF00) << 8);
+    }
+    _fastMain[i] = e;
+  }
+  
+  Huffman_GetReversedCodes(levels.distLevels, kFixedDistTableSize, codes);
+  
+  for (i = 0; i < kNumDist; i++)
+    _fastDist[i] = 0;
+  
+  for (i = 0; i < _numDistLevels; i++)
+  {
+    const unsigned len = levels.distLevels[i];
+    if (len == 0 || len > kNumFastDistBits)
+      continue;
+    const UInt32 e = len | ((UInt32)kDistDirectBits[i] << 4) | (kDistStart[i] << 16);
+    for (UInt32 k = codes[i]; k < kNumDist; k += ((UInt32)1 << len))
+      _fastDist[k] = e;
+  }
+}
+
+
+/*
+  DecodeFast() is fast decoding loop for Huffman blocks of Deflate (not Deflate64).
+  It uses 64-bit bit buffer that is filled by unaligned word reads directly
+  from buffer of CInBuffer, and it writes directly to buffer of CLzOutWindow.
+  It works only while there are enough bytes in input buffer and
+  there is enough free space in output window.
+  Then CodeSpec() continues with slow code that reads new input blocks and flushes output.
+  If end of block is reached, it sets (_needReadTable).
+*/
+
+static const unsigned kFastInputMargin = 16;
+static const UInt32 kFastOutputMargin = kMatchMaxLen32 + 1;
+
+#define FAST_MOVE_POS(n) { bits >>= (n); numBits -= (n); }
+
+// next 15 bits in order that is required for NHuffman::CDecoder
+#define FAST_GET_VALUE_15 ( \
+    ((UInt32)NBitl::kInvertTable[(unsigned)bits & 0xFF] << 7) | \
+    ((UInt32)NBitl::kInvertTable[(unsigned)(bits >> 8) & 0xFF] >> 1))
+
+HRESULT CCoder::DecodeFast(UInt32 &curSize)
+{
+  CInBuffer &inStream = m_InBitStream.GetStream();
+  const Byte *p = inStream.GetPtr();
+  const Byte *lim = inStream.GetLim();
+  UInt32 outRem = m_OutWindowStream.GetRem();
+  if (outRem > curSize)
+    outRem = curSize;
+  if ((size_t)(lim - p) < kFastInputMargin || outRem < kFastOutputMargin)
+    return S_OK;
+  lim -= kFastInputMargin;
+  
+  const Byte *pStart = p;
+  Byte *win = m_OutWindowStream.GetBuf();
+  const UInt32 winSize = m_OutWindowStream.GetBufSize();
+  const bool overDict = m_OutWindowStream.IsOverDict();
+  UInt32 pos = m_OutWindowStream.GetPos();
+  const UInt32 posStart = pos;
+  const UInt32 posLim = pos + (outRem - kFastOutputMargin);
+  
+  UInt64 bits = m_InBitStream.GetBits();
+  unsigned numBits = m_InBitStream.GetNumBits();
+  HRESULT res = S_OK;
+  
+  do
+  {
+    // refill: (numBits >= 56) after that
+    bits |= GetUi64(p) << numBits;
+    p += (63 - numBits) >> 3;
+    numBits |= 56;
+
+    UInt32 len;
+    {
+      const UInt32 e = _fastMain[(size_t)bits & (((UInt32)1 << kNumFastMainBits) - 1)];
+      const unsigned n = (unsigned)e & kFast_NumBitsMask;
+      const UInt32 kind = e & kFast_KindMask;
+      
+      if (kind == kFast_Lit)
+      {
+        FAST_MOVE_POS(n)
+        win[pos++] = (Byte)(e >> 8);
+        continue;
+      }
+      
+      if (kind == kFast_Lit2)
+      {
+        FAST_MOVE_POS(n)
+        win[pos] = (Byte)(e >> 8);
+        win[(size_t)pos + 1] = (Byte)(e >> 16);
+        pos += 2;
+        continue;
+      }
+      
+      if (kind == kFast_Len)
+      {
+        FAST_MOVE_POS(n)
+        const unsigned numExtra = (unsigned)(e >> 8) & 0xFF;
+        len = (e >> 16) + ((UInt32)bits & (((UInt32)1 << numExtra) - 1));
+        FAST_MOVE_POS(numExtra)
+      }
+      else if (e & kFast_EndOfBlockFlag)
+      {
+        FAST_MOVE_POS(n)
+        _needReadTable = true;
+        break;
+      }
+      else
+      {
+        unsigned numCodeBits;
+        UInt32 sym = m_MainDecoder.DecodeValue(FAST_GET_VALUE_15, numCodeBits);
+        if (sym >= kMainTableSize)
+        {
+          res = S_FALSE;
+          break;
+        }
+        FAST_MOVE_POS(numCodeBits)
+        if (sym < 0x100)
+        {
+          win[pos++] = (Byte)sym;
+          continue;
+        }
+        if (sym == kSymbolEndOfBlock)
+        {
+          _needReadTable = true;
+          break;
+        }
+        sym -= kSymbolMatch;
+        const unsigned numExtra = kLenDirectBits32[sym];
+        len = kLenStart32[sym] + kMatchMinLen + ((UInt32)bits & (((UInt32)1 << numExtra) - 1));
+        FAST_MOVE_POS(numExtra)
+      }
+    }
+    
+    // (numBits >= 36) here. It's enough for distance code and extra bits
+    
+    UInt32 distance;
+    {
+      const UInt32 e = _fastDist[(size_t)bits & (((UInt32)1 << kNumFastDistBits) - 1)];
+      unsigned n = (unsigned)e & kFast_NumBitsMask;
+      unsigned numExtra;
+      if (n != 0)
+      {
+        numExtra = (unsigned)(e >> 4) & 0xF;
+        distance = e >> 16;
+      }
+      else
+      {
+        const UInt32 sym = m_DistDecoder.DecodeValue(FAST_GET_VALUE_15, n);
+        if (sym >= _numDistLevels)
+        {
+          res = S_FALSE;
+          break;
+        }
+        numExtra = kDistDirectBits[sym];
+        distance = kDistStart[sym];
+      }
+      FAST_MOVE_POS(n)
+      distance += (UInt32)bits & (((UInt32)1 << numExtra) - 1);
+      FAST_MOVE_POS(numExtra)
+    }
+    
+    {
+      UInt32 src = pos - distance - 1;
+      if (distance >= pos)
+      {
+        if (!overDict || distance >= winSize)
+        {
+          res = S_FALSE;
+          break;
+        }
+        src += winSize;
+      }
+      Byte *dest = win + pos;
+      pos += len;
+      if (winSize - src > len)
+      {
+        const Byte *s = win + src;
+        if (distance >= 7)
+          for (; len >= 8; len -= 8, s += 8, dest += 8)
+            SetUi64(dest, GetUi64(s));
+        for (; len != 0; len--)
+          *dest++ = *s++;
+      }
+      else do
+      {
+        if (src == winSize)
+          src = 0;
+        *dest++ = win[src++];
+      }
+      while (--len != 0);
+    }
+  }
+  while (p <= lim && pos <= posLim);
+
+  m_OutWindowStream.SetPos(pos);
+  curSize -= pos - posStart;
+
+  // we return unused bytes to input buffer. No more than 32 bits can stay in bit buffer.
+  {
+    size_t numBytes = numBits >> 3;
+    if (numBytes > (size_t)(p - pStart))
+      numBytes = (size_t)(p - pStart);
+    p -= numBytes;
+    numBits -= (unsigned)numBytes * 8;
+  }
+  inStream.SetPtr(p);
+  m_InBitStream.SetBits((UInt32)bits, numBits);
+  return res;
 }
 
 
@@ -237,6 +557,17 @@ HRESULT CCoder::CodeSpec(UInt32 curSize, bool finishInputStream, UInt32 inputPro
       if (m_InBitStream.ExtraBitsWereRead_Fast())
         return S_FALSE;
 
+      if (!_deflate64Mode
+          && curSize >= kFastOutputMargin
+          && m_OutWindowStream.GetRem() >= kFastOutputMargin
+          && (size_t)(m_InBitStream.GetStream().GetLim() - m_InBitStream.GetStream().GetPtr()) >= kFastInputMargin)
+      {
+        RINOK(DecodeFast(curSize));
+        if (_needReadTable)
+          break;
+        continue;
+      }
+
       UInt32 sym = m_MainDecoder.Decode(&m_InBitStream);
 
       if (sym < 0x100)
@@ -506,4 +837,77 @@ HRESULT CCoder::CodeResume(ISequentialOutStream *outStream, const UInt64 *outSiz
   return CodeReal(outStream, progress);
 }
 
+
+HRESULT CCoder::CodeToBlockStart(ISequentialOutStream *outStream, UInt64 minSize)
+{
+  HRESULT res;
+  
+  DEFLATE_TRY_BEGIN
+  
+  m_OutWindowStream.SetStream(outStream);
+  CCoderReleaser flusher(this);
+
+  const UInt64 start = GetOutProcessedCur();
+
+  for (;;)
+  {
+    UInt32 curSize = 1 << 20;
+    UInt32 inputLimit = 0;
+    const UInt64 processed = GetOutProcessedCur() - start;
+    if (processed < minSize)
+    {
+      if (curSize > minSize - processed)
+        curSize = (UInt32)(minSize - processed);
+    }
+    else
+    {
+      if (IsBlockStart())
+        break;
+      // CodeSpec() stops at the start of next block, if some input was processed
+      inputLimit = 1;
+    }
+    
+    RINOK(CodeSpec(curSize, false, inputLimit));
+    
+    if (_remainLen == kLenIdFinished)
+      break;
+  }
+  
+  flusher.NeedFlush = false;
+  res = Flush();
+  if (res == S_OK && InputEofError())
+    return S_FALSE;
+  
+  DEFLATE_TRY_END(res)
+  
+  return res;
+}
+
+
+HRESULT CCoder::InitFromBlockStart(ISequentialInStream *inStream, unsigned numSkipBits, const Byte *dict, UInt32 dictSize)
+{
+  if (!m_OutWindowStream.Create(_deflate64Mode ? kHistorySize64: kHistorySize32))
+    return E_OUTOFMEMORY;
+  m_OutWindowStream.SetStream(NULL);
+  m_OutWindowStream.SetMemStream(NULL);
+  m_OutWindowStream.Init(false);
+  for (UInt32 i = 0; i < dictSize; i++)
+    m_OutWindowStream.PutByte(dict[i]);
+  RINOK(m_OutWindowStream.Flush());
+
+  SetInStream(inStream);
+  RINOK(InitInStream(true));
+  if (numSkipBits != 0)
+    ReadBits(numSkipBits);
+
+  _outSizeDefined = false;
+  _outSize = 0;
+  _outStartPos = m_OutWindowStream.GetProcessedSize();
+  
+  m_FinalBlock = false;
+  _remainLen = 0;
+  _needReadTable = true;
+  return S_OK;
+}
+
 }}}
@@ -21,6 +21,9 @@ namespace NDecoder {
 const int kLenIdFinished = -1;
 const int kLenIdNeedInit = -2;
 
+const unsigned kNumFastMainBits = 11;
+const unsigned kNumFastDistBits = 9;
+
 class CCoder:
   public ICompressCoder,
   public ICompressSetFinishMode,
@@ -39,6 +42,10 @@ class CCoder:
   NCompress::NHuffman::CDecoder<kNumHuffmanBits, kFixedDistTableSize> m_DistDecoder;
   NCompress::NHuffman::CDecoder7b<kLevelTableSize> m_LevelDecoder;
 
+  // tables for DecodeFast(). They are indexed by next bits in stream order.
+  UInt32 _fastMain[1 << kNumFastMainBits];
+  UInt32 _fastDist[1 << kNumFastDistBits];
+
   UInt32 m_StoredBlockSize;
 
   UInt32 _numDistLevels;
@@ -59,13 +66,14 @@ class CCoder:
   UInt64 _outSize;
   UInt64 _outStartPos;
 
-  void SetOutStreamSizeResume(const UInt64 *outSize);
   UInt64 GetOutProcessedCur() const { return m_OutWindowStream.GetProcessedSize() - _outStartPos; }
 
   UInt32 ReadBits(unsigned numBits);
 
   bool DecodeLevels(Byte *levels, unsigned numSymbols);
   bool ReadTables();
+  void BuildFastTables(const CLevels &levels);
+  HRESULT DecodeFast(UInt32 &curSize);
   
   HRESULT Flush() { return m_OutWindowStream.Flush(); }
   class CCoderReleaser
@@ -128,8 +136,21 @@ public:
   STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
   #endif
 
+  void SetOutStreamSizeResume(const UInt64 *outSize);
   HRESULT CodeResume(ISequentialOutStream *outStream, const UInt64 *outSize, ICompressProgressInfo *progress);
 
+  /* The functions for random access (index of block starts):
+     CodeToBlockStart() decodes at least (minSize) bytes, and then it stops at the start
+       of next block or at the end of stream. Call SetOutStreamSizeResume(NULL) before
+       the first call for new stream.
+     InitFromBlockStart() prepares the decoder to continue decoding from the block that
+       starts after (numSkipBits) bits of (inStream). (dict) is the history data. */
+
+  HRESULT CodeToBlockStart(ISequentialOutStream *outStream, UInt64 minSize);
+  HRESULT InitFromBlockStart(ISequentialInStream *inStream, unsigned numSkipBits, const Byte *dict, UInt32 dictSize);
+  bool IsBlockStart() const { return _remainLen == 0 && _needReadTable && !m_FinalBlock; }
+  UInt64 GetInputProcessedBits() const { return m_InBitStream.GetStreamSize() * 8 - m_InBitStream.GetNumBits(); }
+
   HRESULT InitInStream(bool needInit);
 
   void AlignToByte() { m_InBitStream.AlignToByte(); }
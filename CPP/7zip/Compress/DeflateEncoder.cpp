@@ -9,6 +9,12 @@
 
 #include "../Common/CWrappers.h"
 
+#ifndef _7ZIP_ST
+#include "../Common/StreamObjects.h"
+#include "../Common/StreamUtils.h"
+#include "../Common/VirtThread.h"
+#endif
+
 #include "DeflateEncoder.h"
 
 #undef NO_INLINE
@@ -36,6 +42,10 @@ static const UInt32 kMatchArrayLimit = kMatchArraySize - kMatchMaxLen * 4 * size
 static const UInt32 kBlockUncompressedSizeThreshold = kMaxUncompressedBlockSize -
     kMatchMaxLen - kNumOpts;
 
+#ifndef _7ZIP_ST
+static const UInt32 kMtBlockSize = (1 << 20); // input size of one block in multithreaded mode
+#endif
+
 static const unsigned kMaxCodeBitLength = 11;
 static const unsigned kMaxLevelBitLength = 7;
 
@@ -97,6 +107,7 @@ void CCoder::SetProps(const CEncProps *props2)
 {
   CEncProps props = *props2;
   props.Normalize();
+  _props = props;
 
   m_MatchFinderCycles = props.mc;
   {
@@ -136,6 +147,9 @@ CCoder::CCoder(bool deflate64Mode):
   m_NumLenCombinations = deflate64Mode ? kNumLenSymbols64 : kNumLenSymbols32;
   m_LenStart = deflate64Mode ? kLenStart64 : kLenStart32;
   m_LenDirectBits = deflate64Mode ? kLenDirectBits64 : kLenDirectBits32;
+  #ifndef _7ZIP_ST
+  _numThreads = 1;
+  #endif
   {
     CEncProps props;
     SetProps(&props);
@@ -217,7 +231,11 @@ HRESULT CCoder::BaseSetEncoderProperties2(const PROPID *propIDs, const PROPVARIA
       case NCoderPropID::kMatchFinderCycles: props.mc = v; break;
       case NCoderPropID::kAlgorithm: props.algo = v; break;
       case NCoderPropID::kLevel: props.Level = v; break;
-      case NCoderPropID::kNumThreads: break;
+      case NCoderPropID::kNumThreads:
+        #ifndef _7ZIP_ST
+        _numThreads = v;
+        #endif
+        break;
       default: return E_INVALIDARG;
     }
   }
@@ -926,8 +944,16 @@ void CCoder::CodeBlock(unsigned tableIndex, bool finalBlock)
 }
 
 
-HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream,
-    const UInt64 * /* inSize */ , const UInt64 * /* outSize */ , ICompressProgressInfo *progress)
+/*
+  (dictSize != 0) : the first (dictSize) bytes of (inStream) are not encoded.
+      They are used only as history for matches of next bytes.
+  (finalStream == false) : the last block is not marked as final, and
+      the stream is terminated by empty stored block to align it to byte boundary.
+      So such streams can be concatenated.
+*/
+
+HRESULT CCoder::CodeStream(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    UInt32 dictSize, bool finalStream, ICompressProgressInfo *progress)
 {
   m_CheckStatic = (m_NumPasses != 1 || m_NumDivPasses != 1);
   m_IsMultiPass = (m_CheckStatic || (m_NumPasses != 1 || m_NumDivPasses != 1));
@@ -945,6 +971,13 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
   _lzInWindow.stream = &_seqInStream.vt;
 
   MatchFinder_Init(&_lzInWindow);
+  if (dictSize != 0)
+  {
+    if (_btMode)
+      Bt3Zip_MatchFinder_Skip(&_lzInWindow, dictSize);
+    else
+      Hc3Zip_MatchFinder_Skip(&_lzInWindow, dictSize);
+  }
   m_OutStream.SetStream(outStream);
   m_OutStream.Init();
 
@@ -960,7 +993,7 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
     t.BlockSizeRes = kBlockUncompressedSizeThreshold;
     m_SecondPass = false;
     GetBlockPrice(1, m_NumDivPasses);
-    CodeBlock(1, Inline_MatchFinder_GetNumAvailableBytes(&_lzInWindow) == 0);
+    CodeBlock(1, finalStream && Inline_MatchFinder_GetNumAvailableBytes(&_lzInWindow) == 0);
     nowPos += m_Tables[1].BlockSizeRes;
     if (progress != NULL)
     {
@@ -971,9 +1004,193 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
   while (Inline_MatchFinder_GetNumAvailableBytes(&_lzInWindow) != 0);
   if (_lzInWindow.result != SZ_OK)
     return SResToHRESULT(_lzInWindow.result);
+  if (!finalStream)
+    WriteStoreBlock(0, 0, false);
   return m_OutStream.Flush();
 }
 
+
+#ifndef _7ZIP_ST
+
+/*
+  Multithreaded mode (pigz-like):
+  The input is split to blocks of (kMtBlockSize) bytes. Each block is encoded
+  by separate thread to separate Deflate stream, and the last (dictSize) bytes
+  of previous block are used as history. Each stream (except of last) is
+  terminated by empty stored block, so the streams are byte aligned,
+  and the concatenation of streams is one correct Deflate stream.
+*/
+
+class CEncoderThread: public CVirtThread
+{
+public:
+  CCoder *Coder;
+  CByteBuffer InBuf;
+  UInt32 DictSize;
+  size_t Size;
+  bool Final;
+  
+  CBufInStream *InStreamSpec;
+  CMyComPtr<ISequentialInStream> InStream;
+  CDynBufSeqOutStream *OutStreamSpec;
+  CMyComPtr<ISequentialOutStream> OutStream;
+
+  HRESULT Result;
+
+  CEncoderThread(): Coder(NULL)
+  {
+    InStreamSpec = new CBufInStream;
+    InStream = InStreamSpec;
+    OutStreamSpec = new CDynBufSeqOutStream;
+    OutStream = OutStreamSpec;
+  }
+  ~CEncoderThread()
+  {
+    CVirtThread::WaitThreadFinish();
+    delete Coder;
+  }
+  virtual void Execute();
+};
+
+void CEncoderThread::Execute()
+{
+  InStreamSpec->Init(InBuf, DictSize + Size);
+  OutStreamSpec->Init();
+  try { Result = Coder->CodeStream(InStream, OutStream, DictSize, Final, NULL); }
+  catch(const COutBufferException &e) { Result = e.ErrorCode; }
+  catch(...) { Result = E_FAIL; }
+}
+
+HRESULT CCoder::CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
+  const UInt32 dictSize = m_Deflate64Mode ? kHistorySize64 : kHistorySize32;
+  const unsigned numThreads = (unsigned)_numThreads;
+
+  if (_threads.Size() > numThreads)
+    _threads.Clear();
+  
+  UInt64 numStarted = 0;  // number of started jobs
+  UInt64 numWritten = 0;  // number of finished and written jobs
+  bool prevIsReady = false; // the job (numStarted) was read, but it was not started
+  UInt64 inPos = 0;
+  UInt64 outPos = 0;
+  HRESULT res = S_OK;
+
+  for (;;)
+  {
+    const UInt64 readIndex = numStarted + (prevIsReady ? 1 : 0);
+    
+    while (numWritten + numThreads <= readIndex)
+    {
+      CEncoderThread &t = _threads[(unsigned)(numWritten % numThreads)];
+      t.WaitExecuteFinish();
+      numWritten++;
+      res = t.Result;
+      if (res != S_OK)
+        break;
+      const size_t size = t.OutStreamSpec->GetSize();
+      res = WriteStream(outStream, t.OutStreamSpec->GetBuffer(), size);
+      if (res != S_OK)
+        break;
+      inPos += t.Size;
+      outPos += size;
+      if (progress)
+      {
+        res = progress->SetRatioInfo(&inPos, &outPos);
+        if (res != S_OK)
+          break;
+      }
+    }
+    if (res != S_OK)
+      break;
+    
+    const unsigned threadIndex = (unsigned)(readIndex % numThreads);
+    if (threadIndex == _threads.Size())
+    {
+      CEncoderThread &t = _threads.AddNew();
+      t.Coder = new CCoder(m_Deflate64Mode);
+      t.InBuf.Alloc(dictSize + kMtBlockSize);
+      res = t.Create();
+      if (res != S_OK)
+      {
+        _threads.DeleteBack();
+        break;
+      }
+    }
+    
+    CEncoderThread &t = _threads[threadIndex];
+    t.Coder->SetProps(&_props);
+    t.DictSize = 0;
+    if (readIndex != 0)
+    {
+      // the previous job is not finished (or not started), but its InBuf is not changed by thread.
+      const CEncoderThread &prev = _threads[(unsigned)((readIndex - 1) % numThreads)];
+      t.DictSize = dictSize;
+      memcpy(t.InBuf, prev.InBuf + prev.DictSize + prev.Size - dictSize, dictSize);
+    }
+    size_t size = kMtBlockSize;
+    res = ReadStream(inStream, t.InBuf + t.DictSize, &size);
+    if (res != S_OK)
+      break;
+    t.Size = size;
+
+    if (prevIsReady)
+    {
+      CEncoderThread &prev = _threads[(unsigned)(numStarted % numThreads)];
+      prev.Final = (size == 0);
+      prev.Start();
+      numStarted++;
+      prevIsReady = false;
+      if (size == 0)
+        break;
+    }
+    
+    if (size != kMtBlockSize)
+    {
+      t.Final = true;
+      t.Start();
+      numStarted++;
+      break;
+    }
+    prevIsReady = true;
+  }
+
+  while (numWritten != numStarted)
+  {
+    CEncoderThread &t = _threads[(unsigned)(numWritten % numThreads)];
+    t.WaitExecuteFinish();
+    numWritten++;
+    if (res != S_OK)
+      continue;
+    res = t.Result;
+    if (res != S_OK)
+      continue;
+    const size_t size = t.OutStreamSpec->GetSize();
+    res = WriteStream(outStream, t.OutStreamSpec->GetBuffer(), size);
+    if (res != S_OK)
+      continue;
+    inPos += t.Size;
+    outPos += size;
+    if (progress)
+      res = progress->SetRatioInfo(&inPos, &outPos);
+  }
+
+  return res;
+}
+
+#endif
+
+
+HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */ , const UInt64 * /* outSize */ , ICompressProgressInfo *progress)
+{
+  #ifndef _7ZIP_ST
+  if (_numThreads > 1)
+    return CodeMt(inStream, outStream, progress);
+  #endif
+  return CodeStream(inStream, outStream, 0, true, progress);
+}
+
 HRESULT CCoder::BaseCode(ISequentialInStream *inStream, ISequentialOutStream *outStream,
     const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress)
 {
@@ -6,6 +6,7 @@
 #include "../../../C/LzFind.h"
 
 #include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
 
 #include "../ICoder.h"
 
@@ -36,6 +37,10 @@ const UInt32 kNumOpts = kNumOptsBase + kMatchMaxLen;
 
 class CCoder;
 
+#ifndef _7ZIP_ST
+class CEncoderThread;
+#endif
+
 struct CTables: public CLevels
 {
   bool UseSubBlocks;
@@ -162,6 +167,18 @@ public:
   void CodeBlock(unsigned tableIndex, bool finalBlock);
 
   void SetProps(const CEncProps *props2);
+
+  CEncProps _props;
+
+  HRESULT CodeStream(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      UInt32 dictSize, bool finalStream, ICompressProgressInfo *progress);
+
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  CObjectVector<CEncoderThread> _threads;
+
+  HRESULT CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
+  #endif
 public:
   CCoder(bool deflate64Mode = false);
   ~CCoder();
@@ -185,6 +185,27 @@ public:
     UInt32 index = _poses[numBits] + ((val - _limits[(size_t)numBits - 1]) >> (kNumBitsMax - numBits));
     return _symbols[index];
   }
+
+  
+  // (val) contains next (kNumBitsMax) bits. It returns 0xFFFFFFFF for unused code.
+  MY_FORCE_INLINE
+  UInt32 DecodeValue(UInt32 val, unsigned &numBits) const
+  {
+    if (val < _limits[kNumTableBits])
+    {
+      UInt32 pair = _lens[val >> (kNumBitsMax - kNumTableBits)];
+      numBits = (unsigned)(pair & kPairLenMask);
+      return pair >> kNumPairLenBits;
+    }
+
+    for (numBits = kNumTableBits + 1; val >= _limits[numBits]; numBits++);
+    
+    if (numBits > kNumBitsMax)
+      return 0xFFFFFFFF;
+
+    UInt32 index = _poses[numBits] + ((val - _limits[(size_t)numBits - 1]) >> (kNumBitsMax - numBits));
+    return _symbols[index];
+  }
 };
 
 
@@ -64,6 +64,15 @@ public:
       pos += _bufSize;
     return _buf[pos];
   }
+
+  /* for fast decoders that write data directly to buffer:
+     (GetRem()) bytes can be written after (GetPos()) without flushing */
+  Byte *GetBuf() const { return _buf; }
+  UInt32 GetPos() const { return _pos; }
+  UInt32 GetRem() const { return _limitPos - _pos; }
+  UInt32 GetBufSize() const { return _bufSize; }
+  bool IsOverDict() const { return _overDict; }
+  void SetPos(UInt32 pos) { _pos = pos; }
 };
 
 #endif
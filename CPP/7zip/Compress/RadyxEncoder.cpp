@@ -38,6 +38,13 @@ STDMETHODIMP CEncoder::SetCoderProperties(const PROPID *propIDs,
 
 	for (UInt32 i = 0; i < numProps; i++)
 	{
+		// Memory budget for pipelined match table building
+		if (propIDs[i] == NCoderPropID::kUsedMemorySize) {
+			if (coderProps[i].vt != VT_UI4)
+				return E_INVALIDARG;
+			params.pipeline_memory = coderProps[i].ulVal;
+			continue;
+		}
 		RINOK(NLzma2::SetLzma2Prop(propIDs[i], coderProps[i], lzma2Props));
 	}
 
@@ -1,6 +1,9 @@
 // (C) 2016 Tino Reichardt
 
 #include "StdAfx.h"
+
+#include "../../../C/CpuArch.h"
+
 #include "ZstdDecoder.h"
 
 int ZstdRead(void *arg, ZSTDCB_Buffer * in)
@@ -74,7 +77,8 @@ CDecoder::CDecoder():
   _processedIn(0),
   _processedOut(0),
   _inputSize(0),
-  _numThreads(NWindows::NSystem::GetNumberOfProcessors())
+  _numThreads(NWindows::NSystem::GetNumberOfProcessors()),
+  _finishMode(false)
 {
   _props.clear();
 }
@@ -129,6 +133,137 @@ STDMETHODIMP CDecoder::SetOutStreamSize(const UInt64 * outSize)
   return S_OK;
 }
 
+STDMETHODIMP CDecoder::SetFinishMode(UInt32 finishMode)
+{
+  _finishMode = (finishMode != 0);
+  return S_OK;
+}
+
+STDMETHODIMP CDecoder::GetInStreamProcessedSize(UInt64 *value)
+{
+  *value = _processedIn;
+  return S_OK;
+}
+
+static bool IsZstdFrameSignature(const Byte *p)
+{
+  const UInt32 v = GetUi32(p);
+  return v == ZSTD_MAGICNUMBER
+      || (v & 0xFFFFFFF0) == ZSTD_MAGIC_SKIPPABLE_START;
+}
+
+/*
+  CodeFrames() is used in finish mode, if the size of input stream is unknown
+  (sequential extraction of zip item with data descriptor).
+  The caller needs the exact size of zstd data, and the data after it.
+  So we decode the frames in this thread, and we read only the number
+  of bytes that ZSTD_decompressStream() requests for next step.
+  After the end of frame we read 4 bytes: if it's not the signature of
+  zstd frame or skippable frame, the stream is finished, and these bytes
+  are not included to processed size.
+*/
+
+HRESULT CDecoder::CodeFrames(ISequentialInStream * inStream,
+  ISequentialOutStream * outStream, ICompressProgressInfo * progress)
+{
+  const size_t kInBufSize = ZSTD_DStreamInSize();
+  const size_t kOutBufSize = ZSTD_DStreamOutSize();
+  if (_inBuf.Size() < kInBufSize)
+    _inBuf.Alloc(kInBufSize);
+  if (_outBuf.Size() < kOutBufSize)
+    _outBuf.Alloc(kOutBufSize);
+
+  ZSTD_DStream *zds = ZSTD_createDStream();
+  if (!zds)
+    return E_OUTOFMEMORY;
+
+  HRESULT res = S_OK;
+  size_t need = ZSTD_initDStream(zds);
+  bool frameEnd = false;
+
+  ZSTD_inBuffer zIn;
+  zIn.src = _inBuf;
+  zIn.size = 0;
+  zIn.pos = 0;
+
+  for (;;)
+  {
+    if (ZSTD_isError(need))
+    {
+      res = S_FALSE;
+      break;
+    }
+
+    if (frameEnd)
+    {
+      // we check the signature of next frame
+      size_t rem = zIn.size - zIn.pos;
+      memmove(_inBuf, (const Byte *)_inBuf + zIn.pos, rem);
+      if (rem < 4)
+      {
+        size_t size = 4 - rem;
+        res = ReadStream(inStream, (Byte *)_inBuf + rem, &size);
+        _processedIn += size;
+        rem += size;
+      }
+      zIn.size = rem;
+      zIn.pos = 0;
+      if (res != S_OK || rem < 4 || !IsZstdFrameSignature(_inBuf))
+        break;
+      frameEnd = false;
+      ZSTD_resetDStream(zds);
+    }
+    else if (zIn.pos == zIn.size)
+    {
+      size_t size = need;
+      if (size > kInBufSize)
+        size = kInBufSize;
+      res = ReadStream(inStream, _inBuf, &size);
+      _processedIn += size;
+      zIn.size = size;
+      zIn.pos = 0;
+      if (res != S_OK)
+        break;
+      if (size == 0)
+      {
+        // unexpected end of input stream
+        res = S_FALSE;
+        break;
+      }
+    }
+
+    ZSTD_outBuffer zOut;
+    zOut.dst = _outBuf;
+    zOut.size = kOutBufSize;
+    zOut.pos = 0;
+
+    need = ZSTD_decompressStream(zds, &zOut, &zIn);
+
+    if (zOut.pos != 0)
+    {
+      res = WriteStream(outStream, _outBuf, zOut.pos);
+      if (res != S_OK)
+        break;
+      _processedOut += zOut.pos;
+      if (progress)
+      {
+        res = progress->SetRatioInfo(&_processedIn, &_processedOut);
+        if (res != S_OK)
+          break;
+      }
+    }
+
+    if (need == 0)
+      frameEnd = true;
+  }
+
+  ZSTD_freeDStream(zds);
+
+  // unused bytes after the end of zstd stream
+  _processedIn -= zIn.size - zIn.pos;
+  return res;
+}
+
 HRESULT CDecoder::CodeSpec(ISequentialInStream * inStream,
   ISequentialOutStream * outStream, ICompressProgressInfo * progress)
 {
@@ -171,9 +306,11 @@ HRESULT CDecoder::CodeSpec(ISequentialInStream * inStream,
 }
 
 STDMETHODIMP CDecoder::Code(ISequentialInStream * inStream, ISequentialOutStream * outStream,
-  const UInt64 * /*inSize */, const UInt64 *outSize, ICompressProgressInfo * progress)
+  const UInt64 * inSize, const UInt64 *outSize, ICompressProgressInfo * progress)
 {
   SetOutStreamSize(outSize);
+  if (_finishMode && !inSize)
+    return CodeFrames(inStream, outStream, progress);
   return CodeSpec(inStream, outStream, progress);
 }
 
@@ -8,6 +8,7 @@
 
 #include "../../Windows/System.h"
 #include "../../Common/Common.h"
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
 #include "../ICoder.h"
 #include "../Common/StreamUtils.h"
@@ -47,6 +48,8 @@ struct DProps
 
 class CDecoder:public ICompressCoder,
   public ICompressSetDecoderProperties2,
+  public ICompressSetFinishMode,
+  public ICompressGetInStreamProcessedSize,
   public ICompressSetCoderMt,
   public CMyUnknownImp
 {
@@ -58,15 +61,22 @@ class CDecoder:public ICompressCoder,
   UInt64 _processedOut;
   UInt32 _inputSize;
   UInt32 _numThreads;
+  bool _finishMode;
+
+  CByteBuffer _inBuf;
+  CByteBuffer _outBuf;
 
   HRESULT CDecoder::ErrorOut(size_t code);
   HRESULT CodeSpec(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
+  HRESULT CodeFrames(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
   HRESULT SetOutStreamSizeResume(const UInt64 *outSize);
 
 public:
 
   MY_QUERYINTERFACE_BEGIN2(ICompressCoder)
   MY_QUERYINTERFACE_ENTRY(ICompressSetDecoderProperties2)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetFinishMode)
+  MY_QUERYINTERFACE_ENTRY(ICompressGetInStreamProcessedSize)
 #ifndef NO_READ_FROM_CODER
   MY_QUERYINTERFACE_ENTRY(ICompressSetInStream)
 #endif
@@ -77,6 +87,8 @@ public:
   STDMETHOD (Code)(ISequentialInStream *inStream, ISequentialOutStream *outStream, const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress);
   STDMETHOD (SetDecoderProperties2)(const Byte *data, UInt32 size);
   STDMETHOD (SetOutStreamSize)(const UInt64 *outSize);
+  STDMETHOD (SetFinishMode)(UInt32 finishMode);
+  STDMETHOD (GetInStreamProcessedSize)(UInt64 *value);
   STDMETHOD (SetNumberOfThreads)(UInt32 numThreads);
 
 #ifndef NO_READ_FROM_CODER
@@ -9,11 +9,13 @@ namespace NCompress {
 namespace NZSTD {
 
 CEncoder::CEncoder():
+  _standardFrame(false),
   _processedIn(0),
   _processedOut(0),
   _inputSize(0),
+  _numThreads(NWindows::NSystem::GetNumberOfProcessors()),
   _ctx(NULL),
-  _numThreads(NWindows::NSystem::GetNumberOfProcessors())
+  _cctx(NULL)
 {
   _props.clear();
 }
@@ -22,6 +24,8 @@ CEncoder::~CEncoder()
 {
   if (_ctx)
     ZSTDCB_freeCCtx(_ctx);
+  if (_cctx)
+    ZSTD_freeCCtx(_cctx);
 }
 
 HRESULT CEncoder::ErrorOut(size_t code)
@@ -75,15 +79,125 @@ STDMETHODIMP CEncoder::SetCoderProperties(const PROPID * propIDs, const PROPVARI
   return S_OK;
 }
 
+STDMETHODIMP CEncoder::SetCoderPropertiesOpt(const PROPID * propIDs, const PROPVARIANT * coderProps, UInt32 numProps)
+{
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const PROPVARIANT & prop = coderProps[i];
+    if (propIDs[i] == NCoderPropID::kStandardFrame)
+    {
+      if (prop.vt != VT_BOOL)
+        return E_INVALIDARG;
+      _standardFrame = (prop.boolVal != VARIANT_FALSE);
+    }
+  }
+  return S_OK;
+}
+
 STDMETHODIMP CEncoder::WriteCoderProperties(ISequentialOutStream * outStream)
 {
   return WriteStream(outStream, &_props, sizeof (_props));
 }
 
+/*
+  Standard frame mode (zip): all data is written as one zstd frame
+  without the skippable frames of zstdmt, so any zstd decoder can read it.
+  Multi-threading is done by libzstd (ZSTD_p_nbThreads), if it was
+  compiled with ZSTD_MULTITHREAD. Otherwise one thread is used.
+*/
+
+HRESULT CEncoder::CodeStandardFrame(ISequentialInStream *inStream,
+  ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
+  const size_t kInBufSize = ZSTD_CStreamInSize();
+  const size_t kOutBufSize = ZSTD_CStreamOutSize();
+  if (_inBuf.Size() < kInBufSize)
+    _inBuf.Alloc(kInBufSize);
+  if (_outBuf.Size() < kOutBufSize)
+    _outBuf.Alloc(kOutBufSize);
+
+  if (!_cctx)
+  {
+    _cctx = ZSTD_createCCtx();
+    if (!_cctx)
+      return E_OUTOFMEMORY;
+  }
+
+  size_t result = ZSTD_CCtx_setParameter(_cctx, ZSTD_p_compressionLevel, _props._level);
+  if (!ZSTD_isError(result) && _numThreads > 1)
+  {
+    // the error is ignored: libzstd without ZSTD_MULTITHREAD supports one thread only
+    ZSTD_CCtx_setParameter(_cctx, ZSTD_p_nbThreads, _numThreads);
+  }
+
+  _processedIn = 0;
+  _processedOut = 0;
+  HRESULT res = S_OK;
+  ZSTD_EndDirective mode = ZSTD_e_continue;
+
+  while (!ZSTD_isError(result) && mode != ZSTD_e_end)
+  {
+    size_t size = kInBufSize;
+    res = ReadStream(inStream, _inBuf, &size);
+    if (res != S_OK)
+      break;
+    if (size != kInBufSize)
+      mode = ZSTD_e_end;
+    _processedIn += size;
+
+    ZSTD_inBuffer zIn;
+    zIn.src = _inBuf;
+    zIn.size = size;
+    zIn.pos = 0;
+
+    for (;;)
+    {
+      ZSTD_outBuffer zOut;
+      zOut.dst = _outBuf;
+      zOut.size = kOutBufSize;
+      zOut.pos = 0;
+      result = ZSTD_compress_generic(_cctx, &zOut, &zIn, mode);
+      if (ZSTD_isError(result))
+        break;
+      if (zOut.pos != 0)
+      {
+        res = WriteStream(outStream, _outBuf, zOut.pos);
+        if (res != S_OK)
+          break;
+        _processedOut += zOut.pos;
+      }
+      if (mode == ZSTD_e_end ? result == 0 : zIn.pos == zIn.size)
+        break;
+    }
+    if (res != S_OK)
+      break;
+
+    if (progress)
+    {
+      res = progress->SetRatioInfo(&_processedIn, &_processedOut);
+      if (res != S_OK)
+        break;
+    }
+  }
+
+  if (res == S_OK && ZSTD_isError(result))
+    res = (ZSTD_getErrorCode(result) == ZSTD_error_memory_allocation) ? E_OUTOFMEMORY : E_FAIL;
+  if (res != S_OK)
+  {
+    // the context is in the middle of frame, so we create new context for next stream
+    ZSTD_freeCCtx(_cctx);
+    _cctx = NULL;
+  }
+  return res;
+}
+
 STDMETHODIMP CEncoder::Code(ISequentialInStream *inStream,
   ISequentialOutStream *outStream, const UInt64 * /*inSize*/ ,
   const UInt64 * /*outSize */, ICompressProgressInfo *progress)
 {
+  if (_standardFrame)
+    return CodeStandardFrame(inStream, outStream, progress);
+
   ZSTDCB_RdWr_t rdwr;
   size_t result;
   HRESULT res = S_OK;
@@ -4,9 +4,11 @@
 #include "../../../C/Alloc.h"
 #include "../../../C/Threads.h"
 #include "../../../C/zstd/zstd.h"
+#include "../../../C/zstd/zstd_errors.h"
 #include "../../../C/zstdmt/zstd-mt.h"
 
 #include "../../Common/Common.h"
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
 #include "../ICoder.h"
 #include "../Common/StreamUtils.h"
@@ -36,10 +38,12 @@ class CEncoder:
   public ICompressCoder,
   public ICompressSetCoderMt,
   public ICompressSetCoderProperties,
+  public ICompressSetCoderPropertiesOpt,
   public ICompressWriteCoderProperties,
   public CMyUnknownImp
 {
   CProps _props;
+  bool _standardFrame;
 
   UInt64 _processedIn;
   UInt64 _processedOut;
@@ -47,18 +51,27 @@ class CEncoder:
   UInt32 _numThreads;
 
   ZSTDCB_CCtx *_ctx;
+
+  // standard frame mode
+  ZSTD_CCtx *_cctx;
+  CByteBuffer _inBuf;
+  CByteBuffer _outBuf;
+
   HRESULT CEncoder::ErrorOut(size_t code);
+  HRESULT CodeStandardFrame(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
 
 public:
   MY_QUERYINTERFACE_BEGIN2(ICompressCoder)
   MY_QUERYINTERFACE_ENTRY(ICompressSetCoderMt)
   MY_QUERYINTERFACE_ENTRY(ICompressSetCoderProperties)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetCoderPropertiesOpt)
   MY_QUERYINTERFACE_ENTRY(ICompressWriteCoderProperties)
   MY_QUERYINTERFACE_END
   MY_ADDREF_RELEASE
 
   STDMETHOD (Code)(ISequentialInStream *inStream, ISequentialOutStream *outStream, const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress);
   STDMETHOD (SetCoderProperties)(const PROPID *propIDs, const PROPVARIANT *props, UInt32 numProps);
+  STDMETHOD (SetCoderPropertiesOpt)(const PROPID *propIDs, const PROPVARIANT *props, UInt32 numProps);
   STDMETHOD (WriteCoderProperties)(ISequentialOutStream *outStream);
   STDMETHOD (SetNumberOfThreads)(UInt32 numThreads);
 
@@ -129,7 +129,11 @@ namespace NCoderPropID
 
     kBlockSize2,        // VT_UI4 or VT_UI8
     kCheckSize,         // VT_UI4 : size of digest in bytes
-    kFilter             // VT_BSTR
+    kFilter,            // VT_BSTR
+
+    kStandardFrame      // VT_BOOL : for ICompressSetCoderPropertiesOpt :
+                        //   zstd encoder writes one standard zstd frame
+                        //   without zstdmt skippable frames (zip method 93)
   };
 }
 
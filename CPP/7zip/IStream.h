@@ -124,4 +124,69 @@ STREAM_INTERFACE(IStreamGetProps2, 0x09)
   STDMETHOD(GetProps2)(CStreamFileProps *props) PURE;
 };
 
+/*
+IStreamGetFd::GetFd() returns POSIX file descriptor of stream,
+  or (-1), if stream is not backed by file descriptor.
+  The position of file descriptor is current position of stream.
+*/
+
+STREAM_INTERFACE(IStreamGetFd, 0x0A)
+{
+  STDMETHOD(GetFd)(int *fd) PURE;
+};
+
+/*
+IOutStreamCopyFrom::CopyFrom()
+  copies up to (size) bytes from current position of (inStream) to
+  current position of out stream without user-space buffers, if possible.
+  *processedSize - the number of bytes that were copied.
+  The positions of both streams are advanced by (*processedSize).
+  If (*processedSize < size) and (S_OK) is returned,
+  the caller must copy the remaining data in usual way.
+*/
+
+STREAM_INTERFACE(IOutStreamCopyFrom, 0x0B)
+{
+  STDMETHOD(CopyFrom)(ISequentialInStream *inStream, UInt64 size, UInt64 *processedSize) PURE;
+};
+
+/*
+IStreamGetDataRange::GetDataRange()
+  finds the first range at or after (pos) that is not a hole in sparse file.
+  *dataPos  - start of range. It's the size of stream, if there is no data after (pos).
+  *dataSize - size of range.
+  returns S_FALSE, if the stream can't report holes.
+  The current position of stream is not changed.
+*/
+
+STREAM_INTERFACE(IStreamGetDataRange, 0x0C)
+{
+  STDMETHOD(GetDataRange)(UInt64 pos, UInt64 *dataPos, UInt64 *dataSize) PURE;
+};
+
+/*
+IOutStreamWriteHole::WriteHole()
+  advances the position of out stream by (size) zero bytes,
+  and it leaves a hole in file instead of writing these zeros.
+  returns S_FALSE, if the hole was not created and the position was not changed.
+  Then the caller must write zeros in usual way.
+*/
+
+STREAM_INTERFACE(IOutStreamWriteHole, 0x0D)
+{
+  STDMETHOD(WriteHole)(UInt64 size) PURE;
+};
+
+/*
+IOutStreamFlush::Flush()
+  writes all data that was written to stream before to the storage device
+  (FlushFileBuffers() in Windows, fsync() in POSIX).
+  The caller uses it, if the order of writes to the storage is important.
+*/
+
+STREAM_INTERFACE(IOutStreamFlush, 0x0E)
+{
+  STDMETHOD(Flush)() PURE;
+};
+
 #endif
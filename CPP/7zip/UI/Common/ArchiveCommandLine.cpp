@@ -142,7 +142,8 @@ enum Enum
   kNameTrailReplace,
 
   kDeleteAfterCompressing,
-  kSetArcMTime
+  kSetArcMTime,
+  kAppendMode
 
   #ifndef _NO_CRYPTO
   , kPassword
@@ -263,7 +264,8 @@ static const CSwitchForm kSwitchForms[] =
   { "snt", NSwitchType::kMinus },
   
   { "sdel" },
-  { "stl" }
+  { "stl" },
+  { "sap" }
 
   #ifndef _NO_CRYPTO
   , { "p",  NSwitchType::kString }
@@ -1324,6 +1326,7 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
 
     updateOptions.DeleteAfterCompressing = parser[NKey::kDeleteAfterCompressing].ThereIs;
     updateOptions.SetArcMTime = parser[NKey::kSetArcMTime].ThereIs;
+    updateOptions.AppendMode = parser[NKey::kAppendMode].ThereIs;
 
     if (updateOptions.StdOutMode && updateOptions.EMailMode)
       throw CArcCmdLineException("stdout mode and email mode cannot be combined");
@@ -20,6 +20,14 @@
 #define USE_ALLOCA
 #endif
 
+#ifdef __linux__
+#define USE_BENCH_MEM_COUNTERS
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
 #ifdef USE_ALLOCA
 #ifdef _WIN32
 #include <malloc.h>
@@ -1886,6 +1894,66 @@ AString GetProcessThreadsInfo(const NSystem::CProcessAffinity &ti)
 extern bool g_LargePagesMode;
 
 
+#ifdef USE_BENCH_MEM_COUNTERS
+
+/* page faults and data TLB misses of all threads of this process.
+   They show the effect of large pages (-slp) for big dictionaries.
+   TLB misses are not available, if perf events are not allowed (perf_event_paranoid). */
+
+struct CBenchMemCounters
+{
+  int TlbFd;
+  UInt64 Faults;
+  
+  CBenchMemCounters(): TlbFd(-1), Faults(0) {}
+  ~CBenchMemCounters() { if (TlbFd >= 0) close(TlbFd); }
+
+  static UInt64 GetFaults()
+  {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+      return 0;
+    return (UInt64)ru.ru_minflt + (UInt64)ru.ru_majflt;
+  }
+
+  void Start()
+  {
+    struct perf_event_attr pe;
+    memset(&pe, 0, sizeof(pe));
+    pe.type = PERF_TYPE_HW_CACHE;
+    pe.size = sizeof(pe);
+    pe.config = PERF_COUNT_HW_CACHE_DTLB
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.inherit = 1;
+    TlbFd = (int)syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+    Faults = GetFaults();
+  }
+
+  void Print(IBenchPrintCallback &f) const
+  {
+    f.Print("Page faults:");
+    PrintNumber(f, GetFaults() - Faults, 12);
+    if (TlbFd >= 0)
+    {
+      UInt64 v = 0;
+      if (read(TlbFd, &v, sizeof(v)) == (ssize_t)sizeof(v))
+      {
+        f.Print("    dTLB misses:");
+        PrintNumber(f, v, 15);
+      }
+    }
+    if (g_LargePagesMode)
+      f.Print("    LP");
+    f.NewLine();
+  }
+};
+
+#endif
+
+
 static void PrintRequirements(IBenchPrintCallback &f, const char *sizeString,
     bool size_Defined, UInt64 size, const char *threadsString, UInt32 numThreads)
 {
@@ -3257,6 +3325,10 @@ HRESULT Bench(
   if (specifiedFreq != 0)
     cpuFreq = specifiedFreq;
 
+  #ifdef USE_BENCH_MEM_COUNTERS
+  CBenchMemCounters memCounters;
+  memCounters.Start();
+  #endif
 
   if (totalBenchMode)
   {
@@ -3434,6 +3506,10 @@ HRESULT Bench(
   PrintTotals(f, showFreq, cpuFreq, midRes);
   f.NewLine();
 
+  #ifdef USE_BENCH_MEM_COUNTERS
+  memCounters.Print(f);
+  #endif
+
   }
   return S_OK;
 }
@@ -19,6 +19,109 @@ using namespace NWindows;
 using namespace NFile;
 using namespace NDir;
 
+/* GetCensorExactPaths() returns false, if censor contains items
+   that can't be checked by exact path (wildcards, recursion, exclude items) */
+
+static bool GetCensorExactPaths(const NWildcard::CCensorNode &node, const UString &prefix, UStringVector &paths)
+{
+  if (!node.ExcludeItems.IsEmpty())
+    return false;
+  
+  FOR_VECTOR (i, node.IncludeItems)
+  {
+    const NWildcard::CItem &item = node.IncludeItems[i];
+    if (item.Recursive || item.PathParts.IsEmpty())
+      return false;
+    UString path = prefix;
+    FOR_VECTOR (k, item.PathParts)
+    {
+      const UString &part = item.PathParts[k];
+      if (part.IsEmpty() || part == L"." || part == L"..")
+        return false;
+      if (item.WildcardMatching && DoesNameContainWildcard(part))
+        return false;
+      if (k != 0)
+        path.Add_PathSepar();
+      path += part;
+    }
+    paths.Add(path);
+  }
+  
+  FOR_VECTOR (i, node.SubNodes)
+  {
+    const NWildcard::CCensorNode &subNode = node.SubNodes[i];
+    if (subNode.Name.IsEmpty() || DoesNameContainWildcard(subNode.Name))
+      return false;
+    UString prefix2 = prefix;
+    prefix2 += subNode.Name;
+    prefix2.Add_PathSepar();
+    if (!GetCensorExactPaths(subNode, prefix2, paths))
+      return false;
+  }
+  
+  return true;
+}
+
+/* FindItemsByExactPaths() uses IArchiveFindItem interface of handler to get
+   the indices of items without full scan of archive items.
+   (found) = false, if full scan is required. */
+
+static HRESULT FindItemsByExactPaths(
+    const CArc &arc,
+    const NWildcard::CCensorNode &wildcardCensor,
+    const CExtractOptions &options,
+    CRecordVector<UInt32> &realIndices,
+    bool &found)
+{
+  found = false;
+  
+  CMyComPtr<IArchiveFindItem> findItem;
+  arc.Archive->QueryInterface(IID_IArchiveFindItem, (void **)&findItem);
+  if (!findItem)
+    return S_OK;
+  
+  UStringVector paths;
+  if (!GetCensorExactPaths(wildcardCensor, UString(), paths) || paths.IsEmpty())
+    return S_OK;
+
+  // the items in directory can be selected by path of directory
+  FOR_VECTOR (i, paths)
+  {
+    Int32 isDirPrefix = 0;
+    RINOK(findItem->IsDirPrefix(paths[i], &isDirPrefix));
+    if (isDirPrefix)
+      return S_OK;
+  }
+
+  CReadArcItem item;
+  
+  FOR_VECTOR (i, paths)
+  {
+    for (UInt32 startIndex = 0;;)
+    {
+      UInt32 index;
+      HRESULT res = findItem->FindItem(paths[i], startIndex, &index);
+      if (res == S_FALSE)
+        break;
+      RINOK(res);
+      startIndex = index + 1;
+      
+      RINOK(arc.GetItem(index, item));
+      
+      #ifdef SUPPORT_ALT_STREAMS
+      if (!options.NtOptions.AltStreams.Val && item.IsAltStream)
+        continue;
+      #endif
+      
+      if (CensorNode_CheckPath(wildcardCensor, item))
+        realIndices.AddToUniqueSorted(index);
+    }
+  }
+
+  found = true;
+  return S_OK;
+}
+
 static HRESULT DecompressArchive(
     CCodecs *codecs,
     const CArchiveLink &arcLink,
@@ -82,6 +185,13 @@ static HRESULT DecompressArchive(
     
     CReadArcItem item;
 
+    bool indicesAreFound = false;
+    if (!elimIsPossible && !allFilesAreAllowed)
+    {
+      RINOK(FindItemsByExactPaths(arc, wildcardCensor, options, realIndices, indicesAreFound));
+    }
+
+    if (!indicesAreFound)
     for (UInt32 i = 0; i < numItems; i++)
     {
       if (elimIsPossible || !allFilesAreAllowed)
@@ -514,6 +514,7 @@ int FindAltStreamColon_in_Path(const wchar_t *path);
 static HRESULT Compress(
     const CUpdateOptions &options,
     bool isUpdatingItself,
+    bool appendInPlace,
     CCodecs *codecs,
     const CActionSet &actionSet,
     const CArc *arc,
@@ -775,6 +776,10 @@ static HRESULT Compress(
   CStdOutFileStream *stdOutFileStreamSpec = NULL;
   COutMultiVolStream *volStreamSpec = NULL;
 
+  if (appendInPlace)
+    if (options.SfxMode || options.VolumesSizes.Size() != 0 || (arc && arc->ArcStreamOffset != 0))
+      return E_NOTIMPL;
+
   if (options.VolumesSizes.Size() == 0)
   {
     if (options.StdOutMode)
@@ -790,6 +795,13 @@ static HRESULT Compress(
       bool isOK = false;
       FString realPath;
       
+      if (appendInPlace)
+      {
+        // it's not temp file, so we don't delete it, if there is some error
+        realPath = us2fs(archivePath.GetFinalPath());
+        isOK = outStreamSpec->Open(realPath, OPEN_EXISTING);
+      }
+      else
       for (unsigned i = 0; i < (1 << 16); i++)
       {
         if (archivePath.Temp)
@@ -843,7 +855,21 @@ static HRESULT Compress(
     */
   }
 
-  RINOK(SetProperties(outArchive, options.MethodMode.Properties));
+  if (appendInPlace)
+  {
+    // the handler writes new data after the end of archive
+    CObjectVector<CProperty> props = options.MethodMode.Properties;
+    props.AddNew().Name = "ap";
+    HRESULT res = SetProperties(outArchive, props);
+    // the handler doesn't know "ap" property: we update the archive via temp file
+    if (res == E_INVALIDARG)
+      return E_NOTIMPL;
+    RINOK(res);
+  }
+  else
+  {
+    RINOK(SetProperties(outArchive, options.MethodMode.Properties));
+  }
 
   if (options.SfxMode)
   {
@@ -901,8 +927,19 @@ static HRESULT Compress(
   }
 
 
+  UInt64 appendStartSize = 0;
+  if (appendInPlace)
+  {
+    RINOK(outStreamSpec->GetSize(&appendStartSize));
+  }
+
   HRESULT result = outArchive->UpdateItems(tailStream, updatePairs2.Size(), updateCallback);
   // callback->Finalize();
+  if (result != S_OK && appendInPlace)
+  {
+    // start header was not changed, so we can remove new data
+    outStreamSpec->SetSize(appendStartSize);
+  }
   RINOK(result);
 
   if (!updateCallbackSpec->AreAllFilesClosed())
@@ -1071,6 +1108,18 @@ static unsigned GetNumSlashes(const FChar *s)
   }
 }
 
+// the archive is written to temp file that replaces the archive after update
+
+static void SetTempArchivePath(const CUpdateOptions &options, CArchivePath &ap)
+{
+  ap.Temp = true;
+  if (!options.WorkingDir.IsEmpty())
+    ap.TempPrefix = options.WorkingDir;
+  else
+    ap.TempPrefix = us2fs(ap.Prefix);
+  NormalizeDirPathPrefix(ap.TempPrefix);
+}
+
 #ifdef _WIN32
 void ConvertToLongNames(NWildcard::CCensor &censor);
 #endif
@@ -1214,6 +1263,17 @@ HRESULT UpdateArchive(
       op.stream = NULL;
       op.filePath = arcPath;
 
+      CMyComPtr<IInStream> arcStream;
+      if (options.AppendMode)
+      {
+        // archive file will be opened for writing also
+        CInFileStream *arcStreamSpec = new CInFileStream;
+        arcStream = arcStreamSpec;
+        if (!arcStreamSpec->OpenShared(us2fs(arcPath), true))
+          return errorInfo.SetFromLastError("cannot open file", us2fs(arcPath));
+        op.stream = arcStream;
+      }
+
       RINOK(callback->StartOpenArchive(arcPath));
 
       HRESULT result = arcLink.Open_Strict(op, openCallback);
@@ -1377,20 +1437,31 @@ HRESULT UpdateArchive(
 
   bool createTempFile = false;
 
+  /* in append mode the archive is updated in place without temp file.
+     Only 7z handler supports it. Archives of other formats, SFX archives,
+     volumes and archives with some prefix data are updated in usual way via temp file. */
+  bool appendInPlace = (options.AppendMode && thereIsInArchive
+      && !options.StdOutMode && options.UpdateArchiveItself && !usesTempDir
+      && !options.SfxMode && options.VolumesSizes.Size() == 0);
+  if (appendInPlace)
+  {
+    const CArc &arc = *arcLink.GetArc();
+    if (arc.ArcStreamOffset != 0
+        || arc.FormatIndex < 0
+        || !codecs->Formats[arc.FormatIndex].Name.IsEqualTo_Ascii_NoCase("7z"))
+      appendInPlace = false;
+  }
+
   if (!options.StdOutMode && options.UpdateArchiveItself)
   {
     CArchivePath &ap = options.Commands[0].ArchivePath;
     ap = options.ArchivePath;
     // if ((archive != 0 && !usesTempDir) || !options.WorkingDir.IsEmpty())
-    if ((thereIsInArchive || !options.WorkingDir.IsEmpty()) && !usesTempDir && options.VolumesSizes.Size() == 0)
+    if ((thereIsInArchive || !options.WorkingDir.IsEmpty()) && !usesTempDir && options.VolumesSizes.Size() == 0
+        && !appendInPlace)
     {
       createTempFile = true;
-      ap.Temp = true;
-      if (!options.WorkingDir.IsEmpty())
-        ap.TempPrefix = options.WorkingDir;
-      else
-        ap.TempPrefix = us2fs(ap.Prefix);
-      NormalizeDirPathPrefix(ap.TempPrefix);
+      SetTempArchivePath(options, ap);
     }
   }
 
@@ -1407,7 +1478,7 @@ HRESULT UpdateArchive(
       // ap.TempPrefix = tempDirPrefix;
     }
     if (!options.StdOutMode &&
-        (ci > 0 || !createTempFile))
+        (ci > 0 || (!createTempFile && !appendInPlace)))
     {
       const FString path = us2fs(ap.GetFinalPath());
       if (NFind::DoesFileOrDirExist(path))
@@ -1476,20 +1547,40 @@ HRESULT UpdateArchive(
 
     CFinishArchiveStat st;
 
-    RINOK(Compress(options,
-        isUpdating,
-        codecs,
-        command.ActionSet,
-        arc,
-        command.ArchivePath,
-        arcItems,
-        options.DeleteAfterCompressing ? (Byte *)processedItems : NULL,
-
-        dirItems,
-        parentDirItem_Ptr,
+    bool appendThis = (isUpdating && appendInPlace);
 
-        tempFiles,
-        errorInfo, callback, st));
+    for (;;)
+    {
+      HRESULT res = Compress(options,
+          isUpdating,
+          appendThis,
+          codecs,
+          command.ActionSet,
+          arc,
+          command.ArchivePath,
+          arcItems,
+          options.DeleteAfterCompressing ? (Byte *)processedItems : NULL,
+
+          dirItems,
+          parentDirItem_Ptr,
+
+          tempFiles,
+          errorInfo, callback, st);
+      
+      /* E_NOTIMPL in append mode: the handler can't append to that archive
+         (for example, the data of archive doesn't follow the signature header).
+         The handler returns it before any write to the archive,
+         so we update the archive in usual way via temp file. */
+      if (res == E_NOTIMPL && appendThis)
+      {
+        appendThis = false;
+        createTempFile = true;
+        SetTempArchivePath(options, command.ArchivePath);
+        continue;
+      }
+      RINOK(res);
+      break;
+    }
 
     RINOK(callback->FinishArchive(st));
   }
@@ -113,6 +113,7 @@ struct CUpdateOptions
   bool DeleteAfterCompressing;
 
   bool SetArcMTime;
+  bool AppendMode; // new data is appended to existing archive file without temp file
 
   CObjectVector<CRenamePair> RenamePairs;
 
@@ -131,7 +132,8 @@ struct CUpdateOptions
     PathMode(NWildcard::k_RelatPath),
     
     DeleteAfterCompressing(false),
-    SetArcMTime(false)
+    SetArcMTime(false),
+    AppendMode(false)
 
       {};
 
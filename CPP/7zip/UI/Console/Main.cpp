@@ -39,6 +39,7 @@
 #include "../Common/LoadCodecs.h"
 #endif
 
+#include "../../Common/MethodProps.h"
 #include "../../Common/RegisterCodec.h"
 
 #include "BenchCon.h"
@@ -126,12 +127,14 @@ static const char * const kHelpString =
     "  -m{Parameters} : set compression Method\n"
     "    -mmt[N] : set number of CPU threads\n"
     "    -mx[N] : set compression level: -mx1 (fastest) ... -mx9 (ultra)\n"
+    "    -mdd : 7z: store duplicate files as references (old 7-Zip extracts them as empty files)\n"
     "  -o{Directory} : set Output directory\n"
     #ifndef _NO_CRYPTO
     "  -p{Password} : set Password\n"
     #endif
     "  -r[-|0] : Recurse subdirectories\n"
     "  -sa{a|e|s} : set Archive name mode\n"
+    "  -sap : update 7z archive in place: append new data to archive file\n"
     "  -scc{UTF-8|WIN|DOS} : set charset for for console input/output\n"
     "  -scs{UTF-8|UTF-16LE|UTF-16BE|WIN|DOS|{id}} : set charset for list files\n"
     "  -scrc[CRC32|CRC64|SHA1|SHA256|*] : set hash function for x, e, h commands\n"
@@ -179,6 +182,31 @@ static void ShowMessageAndThrowException(LPCSTR message, NExitCode::EEnum code)
   throw code;
 }
 
+// returns true, if -mdd switch enables the storing of duplicate files as references
+
+static bool IsDedupEnabled(const CObjectVector<CProperty> &props)
+{
+  bool res = false;
+  FOR_VECTOR (i, props)
+  {
+    const CProperty &prop = props[i];
+    UString name (prop.Name);
+    name.MakeLower_Ascii();
+    bool val = true;
+    if (!name.IsEmpty() && (name.Back() == '+' || name.Back() == '-'))
+    {
+      val = (name.Back() == '+');
+      name.DeleteBack();
+    }
+    if (!name.IsEqualTo("dd"))
+      continue;
+    if (!prop.Value.IsEmpty() && !StringToBool(prop.Value, val))
+      continue;
+    res = val;
+  }
+  return res;
+}
+
 #ifndef _WIN32
 static void GetArguments(int numArgs, const char *args[], UStringVector &parts)
 {
@@ -1115,6 +1143,10 @@ int Main2(
 
     CUpdateErrorInfo errorInfo;
 
+    if (IsDedupEnabled(uo.MethodMode.Properties) && g_ErrStream)
+      *g_ErrStream << endl << "WARNING: -mdd : duplicate files are stored as references to first copy."
+          << endl << "7-Zip versions without support of this feature extract such files as empty files." << endl;
+
     /*
     if (!uo.Init(codecs, types, options.ArchiveName))
       throw kUnsupportedUpdateArcType;
@@ -89,4 +89,13 @@ ssize_t COutFile::Write(const void *data, size_t size)
   return write(_handle, data, size);
 }
 
+bool COutFile::Flush()
+{
+  #ifdef _WIN32
+  return _commit(_handle) == 0;
+  #else
+  return fsync(_handle) == 0;
+  #endif
+}
+
 }}}
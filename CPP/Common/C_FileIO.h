@@ -30,6 +30,7 @@ public:
   bool Close();
   bool GetLength(UInt64 &length) const;
   off_t Seek(off_t distanceToMove, int moveMethod) const;
+  int GetHandle() const { return _handle; }
 };
 
 class CInFile: public CFileBase
@@ -46,6 +47,7 @@ public:
   bool Create(const char *name, bool createAlways);
   bool Open(const char *name, DWORD creationDisposition);
   ssize_t Write(const void *data, size_t size);
+  bool Flush();
 };
 
 }}}
@@ -483,6 +483,9 @@ public:
     _v.AddInReserved(p);
     return *p;
   }
+
+  // (p) must be allocated with (new T), the vector deletes it
+  void AddInReserved_Ptr_of_new(T *p) { _v.AddInReserved(p); }
   
   void Insert(unsigned index, const T& item) { _v.Insert(index, new T(item)); }
   
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: BigArray
+//        Array of trivial items allocated with BigAlloc(), so big match
+//        tables and buffers can use large pages
+//
+// Copyright 2017 Conor McCarthy
+//
+// This file is part of Radyx.
+//
+// Radyx is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Radyx is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with Radyx. If not, see <http://www.gnu.org/licenses/>.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RADYX_BIG_ARRAY_H
+#define RADYX_BIG_ARRAY_H
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include "../../C/Alloc.h"
+
+namespace Radyx {
+
+struct BigFreeDeleter
+{
+	void operator()(void* p) const {
+		BigFree(p);
+	}
+};
+
+template<typename T>
+using BigArray = std::unique_ptr<T[], BigFreeDeleter>;
+
+// Items are not initialized
+template<typename T>
+T* BigArrayAlloc(size_t count)
+{
+	if (count > SIZE_MAX / sizeof(T)) {
+		throw std::bad_alloc();
+	}
+	T* p = static_cast<T*>(BigAlloc(count * sizeof(T)));
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+}
+
+#endif // RADYX_BIG_ARRAY_H
@@ -49,12 +49,19 @@ public:
 		OutputStream& out_stream,
 		ErrorCode& error_code,
 		Progress* progress = nullptr) = 0;
+	// Build the match table of the next block while the current block is encoded, using extra
+	// threads for encoding. The caller must keep the data of the last 2 blocks unchanged.
+	virtual void EnablePipeline(unsigned extra_thread_count) = 0;
+	// Wait until a pipelined block is encoded. Returns its compressed size.
+	virtual size_t Flush(ErrorCode& error_code) = 0;
 	// Anything to do at the end of a unit
 	virtual size_t Finalize(OutputStream& out_stream) = 0;
 	// 7-zip coder info
 	virtual CoderInfo GetCoderInfo() const = 0;
 	// Estimated memory usage
 	virtual size_t GetMemoryUsage(unsigned thread_count) const = 0;
+	// Estimated memory usage of one match table, built with thread_count threads
+	virtual size_t GetTableMemoryUsage(unsigned thread_count) const = 0;
 };
 
 }
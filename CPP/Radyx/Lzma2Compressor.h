@@ -51,24 +51,41 @@ public:
 		OutputStream& out_stream,
 		ErrorCode& error_code,
 		Progress* progress = nullptr);
+	void EnablePipeline(unsigned extra_thread_count);
+	size_t Flush(ErrorCode& error_code);
 	size_t Finalize(OutputStream& out_stream);
 	CoderInfo GetCoderInfo() const NOEXCEPT;
 	size_t GetMemoryUsage(unsigned thread_count) const NOEXCEPT;
+	size_t GetTableMemoryUsage(unsigned thread_count) const NOEXCEPT;
 
 private:
 	struct ThreadArgs
 	{
 		Lzma2Compressor<MatchTableT>& compressor;
+		MatchTable<MatchTableT>& match_table;
 		const DataBlock& data_block;
 		Progress* progress;
 		ThreadArgs(Lzma2Compressor<MatchTableT>& compressor_,
+			MatchTable<MatchTableT>& match_table_,
 			const DataBlock& data_block_,
 			Progress* progress_)
 			: compressor(compressor_),
+			match_table(match_table_),
 			data_block(data_block_),
 			progress(progress_) {}
 	};
 
+	// Arguments of the block being encoded in pipelined mode
+	struct PipelineArgs
+	{
+		OutputStream* out_stream;
+		Progress* progress;
+		DataBlock data_block;  // Must not be a reference
+		size_t encoded_size;
+		ErrorCode error_code;
+		PipelineArgs() : out_stream(nullptr), progress(nullptr), encoded_size(0) {}
+	};
+
 	struct EncoderArgs
 	{
 		size_t start;
@@ -81,13 +98,30 @@ private:
 	static const uint8_t kChunkEof = 0;
 
 	static void ThreadFn(void* pwork, int encoder_num);
+	static void PipelineThreadFn(void* pwork, int table_index);
+	size_t Encode(MatchTable<MatchTableT>& table,
+		const DataBlock& data_block,
+		ThreadPool& threads,
+		OutputStream& out_stream,
+		ErrorCode& error_code,
+		Progress* progress);
+	MatchTable<MatchTableT>& GetTable(unsigned index) NOEXCEPT {
+		return index ? *pipeline_table : match_table;
+	}
 
 	MatchTable<MatchTableT> match_table;
+	// Second match table, used only in pipelined mode
+	std::unique_ptr<MatchTable<MatchTableT>> pipeline_table;
+	std::unique_ptr<ThreadPool> encode_threads;
 	staticvec<EncoderArgs> encoders;
 	const Lzma2Options options;
 	ThreadPool::Thread writer_thread;
+	PipelineArgs pipeline_args;
+	unsigned table_index;
 	size_t dictionary_max;
 	bool needed_random_check;
+	// Declared last so it is destroyed (joined) first
+	ThreadPool::Thread encode_thread;
 #ifdef RADYX_STATS
 	volatile LONGLONG total_time;
 #endif
@@ -104,6 +138,7 @@ Lzma2Compressor<MatchTableT>::Lzma2Compressor(const Lzma2Options& options_)
 		static_cast<uint8_t>(std::min<unsigned>(options_.fast_length, 0xFF)),
 		options_.random_filter),
 	options(options_),
+	table_index(0),
 	dictionary_max(0),
 	needed_random_check(false)
 #ifdef RADYX_STATS
@@ -115,6 +150,7 @@ Lzma2Compressor<MatchTableT>::Lzma2Compressor(const Lzma2Options& options_)
 template<class MatchTableT>
 Lzma2Compressor<MatchTableT>::~Lzma2Compressor()
 {
+	encode_thread.Join();
 #ifdef RADYX_STATS
 	LARGE_INTEGER freq;
 	QueryPerformanceFrequency(&freq);
@@ -153,7 +189,7 @@ void Lzma2Compressor<MatchTableT>::ThreadFn(void* pwork, int encoder_num)
 	AsyncSubPerformanceCounter(args->compressor.total_time);
 #endif
 	EncoderArgs& encoder = args->compressor.encoders[encoder_num];
-	encoder.encoded_size = encoder.encoder.Encode(args->compressor.match_table,
+	encoder.encoded_size = encoder.encoder.Encode(args->match_table,
 		args->data_block,
 		encoder.start,
 		encoder.end,
@@ -179,12 +215,90 @@ size_t Lzma2Compressor<MatchTableT>::Compress(const DataBlock& data_block,
 	if (data_block.end <= data_block.start) {
 		return 0;
 	}
-	out_stream.DisableExceptions();
 	dictionary_max = std::max(dictionary_max, data_block.end);
-	match_table.BuildTable(data_block, threads, progress);
-	if (g_break) {
+	if (!pipeline_table) {
+		match_table.BuildTable(data_block, threads, progress);
+		if (g_break) {
+			return 0;
+		}
+		return Encode(match_table, data_block, threads, out_stream, error_code, progress);
+	}
+	// Build the table for this block while the previous block is encoded
+	GetTable(table_index).BuildTable(data_block, threads, progress);
+	size_t total = Flush(error_code);
+	if (g_break || error_code.type != ErrorCode::kGood) {
+		return total;
+	}
+	pipeline_args.out_stream = &out_stream;
+	pipeline_args.progress = progress;
+	pipeline_args.data_block = data_block;
+	pipeline_args.encoded_size = 0;
+	pipeline_args.error_code = ErrorCode();
+	encode_thread.SetWork(Lzma2Compressor<MatchTableT>::PipelineThreadFn, this, table_index);
+	table_index ^= 1;
+	return total;
+}
+
+template<class MatchTableT>
+void Lzma2Compressor<MatchTableT>::PipelineThreadFn(void* pwork, int table_index)
+{
+	Lzma2Compressor<MatchTableT>* compressor = reinterpret_cast<Lzma2Compressor<MatchTableT>*>(pwork);
+	PipelineArgs& args = compressor->pipeline_args;
+	try {
+		args.encoded_size = compressor->Encode(compressor->GetTable(table_index),
+			args.data_block,
+			*compressor->encode_threads,
+			*args.out_stream,
+			args.error_code,
+			args.progress);
+	}
+	catch (std::bad_alloc&) {
+		args.error_code.type = ErrorCode::kMemory;
+	}
+	catch (std::exception&) {
+		args.error_code.type = ErrorCode::kUnknown;
+	}
+}
+
+template<class MatchTableT>
+size_t Lzma2Compressor<MatchTableT>::Flush(ErrorCode& error_code)
+{
+	if (!pipeline_table) {
 		return 0;
 	}
+	encode_thread.Join();
+	if (pipeline_args.error_code.type != ErrorCode::kGood && error_code.type == ErrorCode::kGood) {
+		error_code = pipeline_args.error_code;
+	}
+	pipeline_args.error_code = ErrorCode();
+	size_t total = pipeline_args.encoded_size;
+	pipeline_args.encoded_size = 0;
+	return total;
+}
+
+template<class MatchTableT>
+void Lzma2Compressor<MatchTableT>::EnablePipeline(unsigned extra_thread_count)
+{
+	if (pipeline_table) {
+		return;
+	}
+	pipeline_table.reset(new MatchTable<MatchTableT>(match_table.GetDictionarySize(),
+		options.match_buffer_size,
+		static_cast<uint8_t>(std::min<unsigned>(options.fast_length, 0xFF)),
+		options.random_filter));
+	encode_threads.reset(new ThreadPool(extra_thread_count));
+}
+
+// Encode a block using a built table. Throws only bad_alloc and returns I/O errors in error_code
+template<class MatchTableT>
+size_t Lzma2Compressor<MatchTableT>::Encode(MatchTable<MatchTableT>& table,
+	const DataBlock& data_block,
+	ThreadPool& threads,
+	OutputStream& out_stream,
+	ErrorCode& error_code,
+	Progress* progress)
+{
+	out_stream.DisableExceptions();
 #ifdef RADYX_STATS
 	AsyncSubPerformanceCounter(total_time);
 #endif
@@ -203,17 +317,17 @@ size_t Lzma2Compressor<MatchTableT>::Compress(const DataBlock& data_block,
 		encoders[i].end = data_block.start + (i + 1) * block_size / thread_count;
 	}
 	if (encoders.front().end < data_block.end) {
-		match_table.CreateDivision(encoders.front().end);
+		table.CreateDivision(encoders.front().end);
 	}
-	ThreadArgs args(*this, data_block, progress);
+	ThreadArgs args(*this, table, data_block, progress);
 	for (unsigned i = 1; i < thread_count; ++i) {
 		if (encoders[i].end < data_block.end) {
-			match_table.CreateDivision(encoders[i].end);
+			table.CreateDivision(encoders[i].end);
 		}
 		threads[i - 1].SetWork(Lzma2Compressor<MatchTableT>::ThreadFn, &args, i);
 	}
 	AsyncWriter writer(out_stream, writer_thread);
-	size_t total = encoders.front().encoder.Encode(match_table,
+	size_t total = encoders.front().encoder.Encode(table,
 		data_block,
 		encoders.front().start,
 		encoders.front().end,
@@ -231,7 +345,7 @@ size_t Lzma2Compressor<MatchTableT>::Compress(const DataBlock& data_block,
 	for (unsigned i = 1; i < thread_count; ++i) {
 		threads[i - 1].Join();
 		if (!g_break && !out_stream.Fail()) {
-			out_stream.Write(match_table.GetOutputCharBuffer(encoders[i].start),
+			out_stream.Write(table.GetOutputCharBuffer(encoders[i].start),
 				encoders[i].encoded_size);
 			if (!g_break && out_stream.Fail()) {
 				error_code.LoadOsErrorCode();
@@ -263,10 +377,17 @@ CoderInfo Lzma2Compressor<MatchTableT>::GetCoderInfo() const NOEXCEPT
 template<class MatchTableT>
 size_t Lzma2Compressor<MatchTableT>::GetMemoryUsage(unsigned thread_count) const NOEXCEPT
 {
-	return match_table.GetMemoryUsage(thread_count) +
+	size_t table_count = 1 + (pipeline_table != nullptr);
+	return match_table.GetMemoryUsage(thread_count) * table_count +
 		Lzma2Encoder::GetMemoryUsage(options) * thread_count;
 }
 
+template<class MatchTableT>
+size_t Lzma2Compressor<MatchTableT>::GetTableMemoryUsage(unsigned thread_count) const NOEXCEPT
+{
+	return match_table.GetMemoryUsage(thread_count);
+}
+
 
 }
 
@@ -53,6 +53,8 @@ struct Lzma2Options
 	OptionalSetting<size_t> match_buffer_size;
 	unsigned block_overlap;
 	unsigned random_filter;
+	// Memory allowed for pipelining match table building with encoding. 0 disables it.
+	size_t pipeline_memory;
 	Lzma2Options() NOEXCEPT
 		: lc(3),
 		lp(0),
@@ -65,7 +67,8 @@ struct Lzma2Options
 		dictionary_size(UINT32_C(32) << 20),
 		match_buffer_size(0),
 		block_overlap(2),
-		random_filter(0) {}
+		random_filter(0),
+		pipeline_memory(sizeof(size_t) > 4 ? size_t(1) << 31 : 0) {}
 	void LoadCompressLevel() NOEXCEPT;
 };
 
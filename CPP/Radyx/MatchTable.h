@@ -127,6 +127,8 @@ private:
 	OptionalSetting<size_t> match_buffer_size;
 	// One table builder per thread
 	staticvec<MatchTableBuilder> table_builders;
+	// Order in which lists are handed out to threads
+	std::vector<UintFast32> head_order;
 	// Cutoff value for random filtration
 	unsigned random_filter;
 	// Derived cutoff value for the filtration algorithm
@@ -263,8 +265,18 @@ void MatchTable<MatchTableT>::BuildTable(const DataBlock& block, ThreadPool& thr
 	for (unsigned i = 0; i < thread_count; ++i) {
 		table_builders[i].AllocateMatchBuffer(match_buffer_size);
 	}
-	// Create an object for allocating lists to threads
-	MatchTableBuilder::HeadIndexes head_indexes(head_table.get(), table_size, block.end, thread_count);
+	// Create an object for allocating lists to threads. Without memory for
+	// the queue order the lists are handed out in table order.
+	UintFast32* order_buf = nullptr;
+	if (thread_count > 1) {
+		try {
+			head_order.resize(table_size);
+			order_buf = head_order.data();
+		}
+		catch (std::bad_alloc&) {
+		}
+	}
+	MatchTableBuilder::HeadIndexes head_indexes(head_table.get(), table_size, order_buf);
 	ThreadArgs args(*this, block, head_indexes, progress, start_depth);
 	// Start the worker threads
 	for (unsigned i = 0; i < threads.GetCount(); ++i) {
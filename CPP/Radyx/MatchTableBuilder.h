@@ -25,6 +25,7 @@
 #ifndef RADYX_MATCH_TABLE_BUILDER_H
 #define RADYX_MATCH_TABLE_BUILDER_H
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <atomic>
@@ -49,17 +50,18 @@ public:
 		ListHead() NOEXCEPT {}
 	};
 
+	// Queue of lists shared by all threads. Long lists are handed out first so the
+	// threads finish around the same time even if a few lists hold most of the data.
 	class HeadIndexes
 	{
 	public:
-		inline HeadIndexes(ListHead* head_table, size_t table_size, size_t block_size, unsigned thread_count) NOEXCEPT;
+		// order_buf must hold table_size entries, or be null to hand out the lists in table order
+		inline HeadIndexes(const ListHead* head_table, size_t table_size, UintFast32* order_buf) NOEXCEPT;
 		inline ptrdiff_t GetNextIndex() NOEXCEPT;
 	private:
-		inline size_t GetEndHeadIndex(ListHead* head_table, size_t end, size_t block_size, unsigned thread_count) NOEXCEPT;
-
-		std::atomic_ptrdiff_t front_index;
-		std::atomic_ptrdiff_t back_index;
-		ptrdiff_t end_index;
+		const UintFast32* order;
+		size_t end_index;
+		std::atomic_size_t next_index;
 	};
 
 public:
@@ -185,66 +187,40 @@ private:
 	MatchTableBuilder& operator=(MatchTableBuilder&&) = delete;
 };
 
-MatchTableBuilder::HeadIndexes::HeadIndexes(ListHead* head_table, size_t table_size, size_t block_size, unsigned thread_count) NOEXCEPT
-{
-	front_index = 0;
-	if (thread_count > 1) {
-		// Try to prevent long lists being done last so all threads can finish around the same time
-		size_t end = table_size;
-		// Find the first list with > 1 string
-		for (; end > 1 && head_table[end - 1].count <= 1; --end) {
-		}
-		back_index = end;
-		// Find a reasonable end point
-		end_index = GetEndHeadIndex(head_table, end, block_size, thread_count);
-	}
-	else  {
-		back_index = table_size;
-		end_index = table_size;
-	}
-}
-
-// Find an end point preceeded by a bunch of short lists
-size_t MatchTableBuilder::HeadIndexes::GetEndHeadIndex(ListHead* head_table, size_t end, size_t block_size, unsigned thread_count) NOEXCEPT
+MatchTableBuilder::HeadIndexes::HeadIndexes(const ListHead* head_table, size_t table_size, UintFast32* order_buf) NOEXCEPT
+	: order(order_buf),
+	end_index(table_size),
+	next_index(0)
 {
-	UintFast32 max_count;
-	if (end <= MatchTableBuilder::kRadixTableSizeSmall) {
-		max_count = static_cast<UintFast32>((block_size << 4) / end);
-	}
-	else {
-		max_count = static_cast<UintFast32>((block_size << 7) / end);
-	}
-	UintFast32 target_sum = (max_count * (thread_count - 1)) >> 3;
-	do {
-		UintFast32 sum = 0;
-		size_t i = end;
-		for (; i > 1 && head_table[i - 1].count <= max_count; --i) {
-			sum += head_table[i - 1].count;
-			if (sum >= target_sum) {
-				return end;
+	if (order_buf != nullptr) {
+		// Queue the lists long enough to matter first, then the short ones in table order
+		size_t count = 0;
+		for (size_t i = 0; i < table_size; ++i) {
+			if (head_table[i].count >= kMinBufferedListSize) {
+				order_buf[count++] = static_cast<UintFast32>(i);
+			}
+		}
+		size_t long_count = count;
+		for (size_t i = 0; i < table_size; ++i) {
+			if (head_table[i].count != 0 && head_table[i].count < kMinBufferedListSize) {
+				order_buf[count++] = static_cast<UintFast32>(i);
 			}
 		}
-		end = i - 1;
-	} while (end > 0);
-	return 0;
+		// Longest first
+		std::sort(order_buf, order_buf + long_count,
+			[head_table](UintFast32 i, UintFast32 j) { return head_table[i].count > head_table[j].count; });
+		end_index = count;
+	}
 }
 
-// Atomically take a list from the head table
+// Atomically take a list from the queue
 ptrdiff_t MatchTableBuilder::HeadIndexes::GetNextIndex() NOEXCEPT
 {
-	if (back_index > end_index) {
-		ptrdiff_t index = --back_index;
-		if (index >= end_index) {
-			return index;
-		}
-	}
-	if (front_index < end_index) {
-		ptrdiff_t index = front_index++;
-		if (index < end_index) {
-			return index;
-		}
+	size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+	if (index >= end_index) {
+		return -1;
 	}
-	return -1;
+	return (order != nullptr) ? order[index] : index;
 }
 
 // Iterate the head table concurrently with other threads, and recurse each list until max_depth is reached
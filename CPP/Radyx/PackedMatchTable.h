@@ -27,6 +27,7 @@
 
 #include <cinttypes>
 #include <memory>
+#include "BigArray.h"
 
 namespace Radyx {
 
@@ -70,7 +71,7 @@ public:
 	}
 
 private:
-	std::unique_ptr<UintFast32[]> match_table;
+	BigArray<UintFast32> match_table;
 
 	PackedMatchTable(const PackedMatchTable&) = delete;
 	PackedMatchTable& operator=(const PackedMatchTable&) = delete;
@@ -78,7 +79,7 @@ private:
 	PackedMatchTable& operator=(PackedMatchTable&&) = delete;
 };
 
-PackedMatchTable::PackedMatchTable(size_t dictionary_size) : match_table(new UintFast32[dictionary_size])
+PackedMatchTable::PackedMatchTable(size_t dictionary_size) : match_table(BigArrayAlloc<UintFast32>(dictionary_size))
 {
 	if (dictionary_size > kMaxDictionary) {
 		throw std::runtime_error("Internal error: incorrect match table type.");
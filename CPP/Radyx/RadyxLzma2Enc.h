@@ -45,6 +45,10 @@ public:
 		return compressor.operator bool();
 	}
 private:
+	// Minimum thread count for building a match table while the previous block is encoded.
+	// The threads are divided between table building and encoding.
+	static const unsigned kPipelineThreadsMin = 4;
+
     std::unique_ptr<CompressorInterface> compressor;
     std::unique_ptr<UnitCompressor> unit_comp;
 	std::unique_ptr<ThreadPool> threads;
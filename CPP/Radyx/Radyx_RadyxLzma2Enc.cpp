@@ -39,8 +39,6 @@ HRESULT RadyxLzma2Enc::Create(Lzma2Options& params, unsigned numThreads)
 	g_break = false;
 
 	try {
-		threads.reset(new ThreadPool(numThreads - 1));
-
 		if (params.dictionary_size > PackedMatchTable::kMaxDictionary
 			|| (params.fast_length > PackedMatchTable::kMaxLength)) {
 			compressor.reset(new Lzma2Compressor<StructuredMatchTable>(params));
@@ -48,11 +46,27 @@ HRESULT RadyxLzma2Enc::Create(Lzma2Options& params, unsigned numThreads)
 		else {
 			compressor.reset(new Lzma2Compressor<PackedMatchTable>(params));
 		}
-		unit_comp.reset(new UnitCompressor(compressor->GetDictionarySize(),
+		// Pipelining needs a second match table and two more data buffers.
+		// Half of the threads build the table of the next block, the others encode the current block.
+		size_t dictionary_size = compressor->GetDictionarySize();
+		unsigned encode_thread_count = numThreads / 2;
+		unsigned build_thread_count = numThreads - encode_thread_count;
+		bool pipelined = numThreads >= kPipelineThreadsMin
+			&& compressor->GetTableMemoryUsage(build_thread_count) + dictionary_size * 2 <= params.pipeline_memory;
+		if (pipelined) {
+			threads.reset(new ThreadPool(build_thread_count - 1));
+			// The encode thread is one of the encoding threads
+			compressor->EnablePipeline(encode_thread_count - 1);
+		}
+		else {
+			threads.reset(new ThreadPool(numThreads - 1));
+		}
+		unit_comp.reset(new UnitCompressor(dictionary_size,
 			compressor->GetMaxBufferOverrun(),
 			(params.dictionary_size * params.block_overlap) >> Lzma2Options::kOverlapShift,
 			false,
-			false));
+			pipelined,
+			pipelined));
 	}
 	catch (std::bad_alloc&) {
 		return SZ_ERROR_MEM;
@@ -110,12 +124,16 @@ STDMETHODIMP RadyxLzma2Enc::Code(ISequentialInStream *inStream, ISequentialOutSt
 {
 	in_processed = 0;
 	HRESULT err = S_OK;
+	// Outside the try block because a pipelined block may still be writing to it
+	OutStream7z out_stream(outStream);
 	try {
-		OutStream7z out_stream(outStream);
 		do
 		{
 			size_t inSize = unit_comp->GetAvailableSpace();
 			err = ReadStream(inStream, unit_comp->GetAvailableBuffer(), &inSize);
+			// Don't finalize the stream after a read error
+			if (err != S_OK)
+				break;
 			unit_comp->AddByteCount(inSize);
 			in_processed += inSize;
 
@@ -127,13 +145,14 @@ STDMETHODIMP RadyxLzma2Enc::Code(ISequentialInStream *inStream, ISequentialOutSt
 					if (err != S_OK)
 						break;
 				}
-				if (unit_comp->GetAvailableSpace() == 0) {
-					unit_comp->Shift();
-				}
-				else {
-					compressor->Finalize(out_stream);
-					break;
-				}
+			}
+			if (inSize && unit_comp->GetAvailableSpace() == 0) {
+				unit_comp->Shift();
+			}
+			else {
+				unit_comp->Flush(*compressor);
+				compressor->Finalize(out_stream);
+				break;
 			}
 
 		} while (err == S_OK);
@@ -148,7 +167,12 @@ STDMETHODIMP RadyxLzma2Enc::Code(ISequentialInStream *inStream, ISequentialOutSt
 		err = S_FALSE;
 	}
 	g_break = err != S_OK;
-	unit_comp->Reset(false, false);
+	if (err != S_OK) {
+		ErrorCode error_code;
+		unit_comp->WaitCompletion();
+		compressor->Flush(error_code);
+	}
+	unit_comp->Reset(false);
 	return err;
 }
 
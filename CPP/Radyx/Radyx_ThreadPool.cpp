@@ -31,6 +31,7 @@ namespace Radyx {
 ThreadPool::Thread::Thread()
 	: work_available(false),
 	exit(false),
+	work_fn(nullptr),
 	argp(nullptr),
 	argi(0)
 {
@@ -42,7 +43,10 @@ ThreadPool::Thread::Thread()
 
 ThreadPool::Thread::~Thread()
 {
-	exit = true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		exit = true;
+	}
 	cv.notify_all();
 	thread.join();
 }
@@ -52,36 +56,42 @@ void ThreadPool::Thread::ThreadFn()
 	std::unique_lock<std::mutex> lock(mutex);
 	for (;;)
 	{
-		work_available = false;
+		if (work_available) {
+			work_available = false;
+			done_cv.notify_all();
+		}
 		while (!work_available && !exit) {
 			cv.wait(lock);
 		}
 		if (exit) {
 			break;
 		}
+		lock.unlock();
 		work_fn(argp, argi);
+		lock.lock();
 	}
 }
 
-void ThreadPool::Thread::SetWork(std::function<void(void*, int)> fn, void *argp_, int argi_)
+void ThreadPool::Thread::SetWork(WorkFn fn, void *argp_, int argi_)
 {
 	std::unique_lock<std::mutex> lock(mutex);
+	// Wait for any previous work
+	while (work_available) {
+		done_cv.wait(lock);
+	}
 	work_fn = fn;
 	argp = argp_;
 	argi = argi_;
 	work_available = true;
-	cv.notify_all();
+	cv.notify_one();
 }
 
 void ThreadPool::Thread::Join()
 {
-	do {
-		std::unique_lock<std::mutex> lock(mutex);
-		if (work_available) {
-			std::this_thread::yield();
-		}
+	std::unique_lock<std::mutex> lock(mutex);
+	while (work_available) {
+		done_cv.wait(lock);
 	}
-	while (work_available);
 }
 
 }
\ No newline at end of file
@@ -54,7 +54,8 @@ UnitCompressor::UnitCompressor(size_t dictionary_size_,
 	size_t max_buffer_overrun,
 	size_t overlap_,
 	bool do_bcj,
-	bool async_read_)
+	bool async_read_,
+	bool pipelined)
 	: dictionary_size(dictionary_size_),
 #ifdef RADYX_BCJ
 	overlap((overlap_ > BcjTransform::kMaxUnprocessed) ? overlap_ : BcjTransform::kMaxUnprocessed),
@@ -63,15 +64,16 @@ UnitCompressor::UnitCompressor(size_t dictionary_size_,
 #endif
 	unprocessed(0),
 	buffer_index(0),
+	buffer_count(async_read_ ? 2 + pipelined : 1),
 	async_read(async_read_),
 	working(false)
 {
 #ifndef RADYX_BCJ
 	assert(!do_bcj);
 #endif
-	data_buffer[0].reset(new uint8_t[dictionary_size_ + max_buffer_overrun]);
-	if (async_read_) {
-		data_buffer[1].reset(new uint8_t[dictionary_size_ + max_buffer_overrun]);
+	data_buffer[0].reset(BigArrayAlloc<uint8_t>(dictionary_size_ + max_buffer_overrun));
+	for (size_t i = 1; i < buffer_count; ++i) {
+		data_buffer[i].reset(BigArrayAlloc<uint8_t>(dictionary_size_ + max_buffer_overrun));
 	}
 	Reset(do_bcj, async_read_);
 }
@@ -133,6 +135,14 @@ void UnitCompressor::ThreadFn(void* pwork, int /*unused*/)
 	unit_comp->working = false;
 }
 
+// Wait for the last block to be written by a pipelined compressor
+void UnitCompressor::Flush(CompressorInterface& compressor)
+{
+	WaitCompletion();
+	pack_size += compressor.Flush(error_code);
+	CheckError();
+}
+
 void UnitCompressor::CheckError() const
 {
 	if (error_code.type == ErrorCode::kGood) {
@@ -179,7 +189,7 @@ void UnitCompressor::Compress(CompressorInterface& compressor,
 				DataBlock(data_buffer[buffer_index].get(), mut_block.start, processed_end));
 			working = true;
 			compress_thread.SetWork(ThreadFn, this, 0);
-			buffer_index ^= 1;
+			buffer_index = (buffer_index + 1) % buffer_count;
 		}
 		else {
 			DataBlock data_block(data_buffer[0].get(), mut_block.start, processed_end);
@@ -195,7 +205,7 @@ void UnitCompressor::Shift()
 	CheckError();
 	if (block_end > overlap) {
 		if (async_read) {
-			const uint8_t* data = data_buffer[buffer_index ^ 1].get();
+			const uint8_t* data = data_buffer[(buffer_index + buffer_count - 1) % buffer_count].get();
 			memcpy(data_buffer[buffer_index].get(), data + block_end - overlap, overlap);
 		}
 		else {
@@ -29,6 +29,7 @@
 #include <cinttypes>
 #include <memory>
 #include <algorithm>
+#include "BigArray.h"
 
 namespace Radyx {
 
@@ -67,7 +68,7 @@ public:
 	static inline size_t GetMemoryUsage(size_t dictionary_size) NOEXCEPT;
 
 private:
-	std::unique_ptr<MatchUnit[]> match_table;
+	BigArray<MatchUnit> match_table;
 
 	StructuredMatchTable(const StructuredMatchTable&) = delete;
 	StructuredMatchTable& operator=(const StructuredMatchTable&) = delete;
@@ -76,7 +77,7 @@ private:
 };
 
 StructuredMatchTable::StructuredMatchTable(size_t dictionary_size)
-	: match_table(new MatchUnit[(dictionary_size >> kUnitBits) + 1])
+	: match_table(BigArrayAlloc<MatchUnit>((dictionary_size >> kUnitBits) + 1))
 {
 }
 
@@ -35,12 +35,16 @@ namespace Radyx {
 class ThreadPool
 {
 public:
+	// A Thread runs one task at a time. Work that must be balanced between
+	// threads is shared by the task itself, e.g. MatchTableBuilder::HeadIndexes
+	typedef void (*WorkFn)(void* argp, int argi);
+
 	class Thread
 	{
 	public:
 		Thread();
 		~Thread();
-		void SetWork(std::function<void(void*, int)> fn, void *argp, int argi);
+		void SetWork(WorkFn fn, void *argp, int argi);
 		void Join();
 
 	private:
@@ -49,9 +53,10 @@ public:
 		std::thread thread;
 		std::mutex mutex;
 		std::condition_variable cv;
-		volatile bool work_available;
-		volatile bool exit;
-		std::function<void(void*, int)> work_fn;
+		std::condition_variable done_cv;
+		bool work_available;
+		bool exit;
+		WorkFn work_fn;
 		void* argp;
 		int argi;
 
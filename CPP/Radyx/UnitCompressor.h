@@ -34,13 +34,14 @@
 #endif
 #include "Progress.h"
 #include "ErrorCode.h"
+#include "BigArray.h"
 
 namespace Radyx {
 
 class UnitCompressor
 {
 public:
-	UnitCompressor(size_t dictionary_size_, size_t max_buffer_overrun, size_t overlap_, bool do_bcj, bool async_read_);
+	UnitCompressor(size_t dictionary_size_, size_t max_buffer_overrun, size_t overlap_, bool do_bcj, bool async_read_, bool pipelined = false);
 	void Reset(bool do_bcj);
 	void Reset(bool do_bcj, bool async_read_);
 	size_t GetAvailableSpace() const;
@@ -60,6 +61,7 @@ public:
 		Progress* progress);
 	void Shift();
 	void Write(OutputStream& out_stream);
+	void Flush(CompressorInterface& compressor);
 	void CheckError() const;
 	inline void WaitCompletion();
 
@@ -81,7 +83,7 @@ public:
 	}
 #endif
 	size_t GetMemoryUsage() const NOEXCEPT {
-		return dictionary_size * (1 + async_read);
+		return dictionary_size * (async_read ? buffer_count : 1);
 	}
 
 private:
@@ -103,7 +105,8 @@ private:
 
 	static void ThreadFn(void* pwork, int unused);
 
-	std::unique_ptr<uint8_t[]> data_buffer[2];
+	// A pipelined compressor still reads the previous block, so it needs a third buffer
+	BigArray<uint8_t> data_buffer[3];
 #ifdef RADYX_BCJ
 	std::unique_ptr<BcjTransform> bcj;
 #endif
@@ -117,6 +120,7 @@ private:
 	ThreadPool::Thread compress_thread;
 	ThreadArgs args;
 	size_t buffer_index;
+	size_t buffer_count;
 	ErrorCode error_code;
 	bool async_read;
 	volatile bool working;
@@ -429,4 +429,6 @@ bool COutFile::SetLength(UInt64 length) throw()
   return SetEndOfFile();
 }
 
+bool COutFile::Flush() throw() { return BOOLToBool(::FlushFileBuffers(_handle)); }
+
 }}}
@@ -196,6 +196,7 @@ public:
   bool Write(const void *data, UInt32 size, UInt32 &processedSize) throw();
   bool SetEndOfFile() throw();
   bool SetLength(UInt64 length) throw();
+  bool Flush() throw();
 };
 
 }}}